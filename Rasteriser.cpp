@@ -1,9 +1,16 @@
 #include "Rasteriser.h"
+#include "binarymesh.h"
+#include "meshsimplify.h"
+#include "meshoptimize.h"
 #include <iostream>
 #include <assert.h>
 #include <filesystem>
 #include <cmath>
 #include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <chrono>
+#include <cstring>
 # include <vector> 
 
 void Rasteriser::AddCollisionFromOBJ(const std::string& obj_path, const glm::vec3& position) {
@@ -61,6 +68,47 @@ void Rasteriser::AddCollisionFromOBJ(const std::string& obj_path, const glm::vec
 Rasteriser::Rasteriser() {
     InitOpenGLContext();
     _mesh_loader = std::make_unique<MeshLoader>();
+    texture_registry_ = std::make_unique<TextureRegistry>();
+    thread_pool_ = std::make_unique<ThreadPool>();
+    geometry_pool_ = std::make_unique<GeometryPool>(size_t(1) << 18, size_t(1) << 20);
+    transform_system_ = std::make_unique<TransformSystem>(registry_);
+    registry_.on_destroy<component::Bounds>().connect<&Rasteriser::OnBoundsDestroyed>(*this);
+    registry_.on_destroy<component::Instances>().connect<&Rasteriser::OnInstancesDestroyed>(*this);
+    registry_.on_construct<component::Bounds>().connect<&Rasteriser::InvalidateStaticShadows>(*this);
+    registry_.on_construct<component::Dynamic>().connect<&Rasteriser::InvalidateStaticShadows>(*this);
+    registry_.on_destroy<component::Dynamic>().connect<&Rasteriser::InvalidateStaticShadows>(*this);
+    registry_.on_construct<component::ParticleEmitter>().connect<&GPUParticleSystem::OnEmitterConstructed>(particles_);
+    registry_.on_destroy<component::ParticleEmitter>().connect<&GPUParticleSystem::OnEmitterDestroyed>(particles_);
+    mesh_cache_ = std::make_unique<MeshCache>([this](const std::string& file_name, const std::shared_ptr<MeshAsset>& asset) {
+        asset->texture_registry = texture_registry_.get();
+        asset->geometry_pool = geometry_pool_.get();
+
+        // The job keeps the asset alive until it is committed, even if every entity using it is gone by then
+        auto mesh = std::make_shared<DecodedMesh>();
+        asset_streamer_->Enqueue([this, mesh, file_name]() { DecodeMesh(file_name, *mesh); },
+            [this, mesh, asset, file_name]() {
+                if (!CommitMesh(*mesh, asset->gl_meshes)) {
+                    return false;
+                }
+                if (mesh->result != S_OK) {
+                    std::cout << "ERROR: '" << file_name << "' is resident without the sub-meshes that failed to load" << std::endl;
+                }
+                // Asset holds a reference to every texture its materials use, and their slots
+                asset->textures = mesh->texture_handles;
+                asset->material_ranges = &material_ranges_;
+                asset->first_material = size_t(std::max(mesh->first_material, 0));
+                asset->material_count = mesh->sub_meshes.size();
+                asset->resident = true;
+                OnMeshResident(*asset);
+                return true;
+            }, true);
+        if (!streaming_) {
+            asset_streamer_->Flush();
+        }
+        return S_OK;
+    });
+    asset_streamer_ = std::make_unique<AssetStreamer>(thread_pool_.get());
+    asset_streamer_->Init(STREAMING_UPLOAD_BYTES);
 
     // Get viewport FIRST
     GLint viewport[4];
@@ -97,6 +145,9 @@ Rasteriser::Rasteriser() {
 
 // In Rasteriser.cpp
 Rasteriser::~Rasteriser() {
+    // Instance buffers go while the context is still current
+    registry_.clear<component::Instances>();
+
     // Destroy player first (releases controller)
     player_.reset();
 
@@ -153,6 +204,15 @@ int Rasteriser::InitOpenGLContext() {
     glEnable(GL_FRAMEBUFFER_SRGB);
     // GL_LOWER_LEFT (OpenGL) or GL_UPPER_LEFT (DirectX, Windows) and GL_NEGATIVE_ONE_TO_ONE or GL_ZERO_TO_ONE
     glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+
+    if (frame_constants_.Init() != S_OK) {
+        return EXIT_FAILURE;
+    }
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &draw_ssbo_alignment_);
+    if (draw_stream_.Init(GLsizeiptr(1) << 20, "draws") != S_OK) {
+        return EXIT_FAILURE;
+    }
+    return 0;
 }
 
 
@@ -166,9 +226,13 @@ entt::entity Rasteriser::CreateEntity(const std::string& mesh_file, const std::s
     // Add Name component
     registry_.emplace<component::Name>(entity, name);
 
-    // Add Mesh component and load meshes
+    // Add Mesh component - GPU meshes are shared between all entities using the same file
     auto& mesh_component = registry_.emplace<component::Mesh>(entity);
-    LoadMesh(mesh_file, mesh_component.gl_meshes);
+    mesh_component.asset = mesh_cache_->Acquire(mesh_file);
+    mesh_component.gl_meshes = mesh_component.asset->resident ? mesh_component.asset->gl_meshes : PlaceholderMeshes();
+
+    // Add Bounds component - world box is inserted into the BVH on the first frame
+    registry_.emplace<component::Bounds>(entity).update_local(mesh_component);
 
     // Set up parent-child relationship if parent is provided
     if (parent != entt::null && registry_.valid(parent)) {
@@ -187,78 +251,659 @@ entt::entity Rasteriser::CreateEntity(const std::string& mesh_file, const std::s
     return entity;
 }
 
-int Rasteriser::LoadMesh(const std::string& file_mame, std::vector<GLMesh> & gl_meshes) {
+entt::entity Rasteriser::CreateInstancedEntity(const std::string& mesh_file, const std::string& name, const std::vector<glm::mat4>& transforms) {
+    // Mesh is loaded once, every instance shares its GPU buffers
+    auto entity = CreateEntity(mesh_file, name);
+
+    auto& instances = registry_.emplace<component::Instances>(entity);
+    instances.transforms = transforms;
+    UploadInstances(instances);
+    registry_.get<component::Bounds>(entity).update_local(registry_.get<component::Mesh>(entity), &instances);
+
+    std::cout << "Created instanced entity '" << name << "' with " << instances.count() << " instances" << std::endl;
+    return entity;
+}
+
+void Rasteriser::UploadInstances(component::Instances& instances) {
+    // Grouped by level of detail, each level is one instanced draw starting at lod_first[level]
+    instances.lods.resize(instances.transforms.size(), 0);
+    std::fill(std::begin(instances.lod_first), std::end(instances.lod_first), 0);
+    for (uint8_t lod : instances.lods) {
+        ++instances.lod_first[lod + 1];
+    }
+    for (int lod = 0; lod < GLMesh::MAX_LODS; ++lod) {
+        instances.lod_first[lod + 1] += instances.lod_first[lod];
+    }
+    GLsizei next[GLMesh::MAX_LODS];
+    std::copy(instances.lod_first, instances.lod_first + GLMesh::MAX_LODS, next);
+
+    // Pack model and normal matrices so the vertex shader doesn't invert per vertex
+    std::vector<GLInstance> gpu_instances(instances.transforms.size());
+    for (size_t i = 0; i < instances.transforms.size(); ++i) {
+        const glm::mat4& M = instances.transforms[i];
+        GLInstance& gpu_instance = gpu_instances[next[instances.lods[i]]++];
+        gpu_instance.M = M;
+        gpu_instance.Mn = glm::mat4(glm::transpose(glm::inverse(glm::mat3(M))));
+    }
+
+    if (instances.ssbo == 0) {
+        glCreateBuffers(1, &instances.ssbo);
+    }
+    glNamedBufferData(instances.ssbo, gpu_instances.size() * sizeof(GLInstance), gpu_instances.data(), GL_STATIC_DRAW);
+
+    instances.dirty = false;
+    instances.lods_dirty = false;
+}
+
+void Rasteriser::OnInstancesDestroyed(entt::registry& registry, entt::entity entity)
+{
+    GLuint& ssbo = registry.get<component::Instances>(entity).ssbo;
+    if (ssbo != 0) {
+        glDeleteBuffers(1, &ssbo);
+        ssbo = 0;
+    }
+}
+
+// Level ranges of a sub-mesh whose coarser levels were uploaded right after level 0
+static void SetLodRanges(GLMesh& glmesh, const uint32_t lod_count, const uint32_t* index_counts, const float* errors)
+{
+    glmesh.lod_count = std::clamp(int(lod_count), 1, GLMesh::MAX_LODS);
+    GLuint first = glmesh.first_index;
+    for (int lod = 0; lod < glmesh.lod_count; ++lod) {
+        glmesh.lod_first_index[lod] = first;
+        glmesh.lod_index_count[lod] = GLsizei(index_counts[lod]);
+        glmesh.lod_error[lod] = errors[lod];
+        first += index_counts[lod];
+    }
+    glmesh.index_count = glmesh.lod_index_count[0];
+}
+
+int Rasteriser::UploadMesh(const void* vertices, const size_t vertex_buffer_size, const GLsizei vertex_stride,
+    const void* indices, const size_t index_buffer_size, const glm::vec3& quantization_min, const glm::vec3& quantization_max,
+    GLMesh& glmesh)
+{
+    assert(vertex_stride == sizeof(Vertex));
+
+    // Suballocate from the shared buffers, indices of all levels of detail in one range
+    return geometry_pool_->Allocate(vertices, vertex_buffer_size / vertex_stride,
+        indices, index_buffer_size / sizeof(GLuint), glmesh, quantization_min, quantization_max);
+}
+
+const std::vector<GLMesh>& Rasteriser::PlaceholderMeshes()
+{
+    if (!placeholder_meshes_.empty()) {
+        return placeholder_meshes_;
+    }
+
+    // Unit box standing on the entity's origin, material index -1 selects PLACEHOLDER_MATERIAL (materials.glsl)
+    // Written field by field, MeshLoader's Vertex has no constructor for this
+    const glm::vec3 bounds_min(-0.5f, -0.5f, 0.0f);
+    const glm::vec3 bounds_max(0.5f, 0.5f, 1.0f);
+    std::vector<uint8_t> vertices(24 * sizeof(Vertex), 0);
+    std::vector<GLuint> indices;
+    for (int face = 0; face < 6; ++face) {
+        const int axis = face / 2;
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        const bool positive = face % 2 == 1;
+        glm::vec3 normal(0.0f);
+        glm::vec3 tangent(0.0f);
+        normal[axis] = positive ? 1.0f : -1.0f;
+        tangent[u] = 1.0f;
+
+        const GLuint first = GLuint(face * 4);
+        const int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };  // Counter-clockwise seen from +axis
+        for (int c = 0; c < 4; ++c) {
+            glm::vec3 position;
+            position[axis] = positive ? bounds_max[axis] : bounds_min[axis];
+            position[u] = corners[c][0] ? bounds_max[u] : bounds_min[u];
+            position[v] = corners[c][1] ? bounds_max[v] : bounds_min[v];
+            const glm::vec2 tex_coord(float(corners[c][0]), float(corners[c][1]));
+            const int material = -1;
+
+            uint8_t* vertex = &vertices[(first + c) * sizeof(Vertex)];
+            std::memcpy(vertex + offsetof(Vertex, position), &position[0], sizeof(glm::vec3));
+            std::memcpy(vertex + offsetof(Vertex, normal), &normal[0], sizeof(glm::vec3));
+            std::memcpy(vertex + offsetof(Vertex, tangent), &tangent[0], sizeof(glm::vec3));
+            std::memcpy(vertex + offsetof(Vertex, tex_coord), &tex_coord[0], sizeof(glm::vec2));
+            std::memcpy(vertex + offsetof(Vertex, mat_idx), &material, sizeof(int));
+        }
+        // Negative faces are seen from the other side, their winding flips
+        const GLuint front[6] = { 0, 1, 2, 0, 2, 3 };
+        const GLuint back[6] = { 0, 2, 1, 0, 3, 2 };
+        for (int k = 0; k < 6; ++k) {
+            indices.push_back(first + (positive ? front[k] : back[k]));
+        }
+    }
+
+    GLMesh glmesh;
+    if (UploadMesh(vertices.data(), vertices.size(), GLsizei(sizeof(Vertex)),
+        indices.data(), indices.size() * sizeof(GLuint), bounds_min, bounds_max, glmesh) != S_OK) {
+        return placeholder_meshes_;  // Retried by the next entity
+    }
+    const uint32_t index_count = uint32_t(indices.size());
+    const float error = 0.0f;
+    SetLodRanges(glmesh, 1, &index_count, &error);
+    glmesh.bounds_min = bounds_min;
+    glmesh.bounds_max = bounds_max;
+    placeholder_meshes_.push_back(glmesh);
+    return placeholder_meshes_;
+}
+
+void Rasteriser::OnMeshResident(const MeshAsset& asset)
+{
+    // Entities created while the asset streamed in swap their placeholder for the real sub-meshes
+    auto view = registry_.view<component::Mesh, component::Bounds>();
+    for (auto [entity, mesh_component, bounds] : view.each()) {
+        if (mesh_component.asset.get() != &asset) {
+            continue;
+        }
+        mesh_component.gl_meshes = asset.gl_meshes;
+        mesh_component.lod = 0;
+        bounds.update_local(mesh_component, registry_.try_get<component::Instances>(entity));
+
+        // Reinserted with the new box by the next UpdateBounds()
+        if (bounds.proxy != DynamicBVH::NULL_NODE) {
+            bvh_.DestroyProxy(bounds.proxy);
+            bounds.proxy = DynamicBVH::NULL_NODE;
+        }
+        if (!registry_.all_of<component::Dynamic>(entity)) {
+            static_shadow_dirty_ = true;
+        }
+    }
+}
+
+void Rasteriser::UpdateBounds()
+{
+    auto view = registry_.view<component::Transform, component::Mesh, component::Bounds>();
+    for (auto [entity, transform, mesh_component, bounds] : view.each()) {
+        bool local_bounds_changed = false;
+        if (auto* instances = registry_.try_get<component::Instances>(entity); instances && instances->dirty) {
+            bounds.update_local(mesh_component, instances);
+            local_bounds_changed = true;
+        }
+
+        // Nothing to refit unless TransformSystem moved the entity
+        if (!transform.world_changed && !local_bounds_changed && bounds.proxy != DynamicBVH::NULL_NODE) {
+            continue;
+        }
+
+        // A moving static caster invalidates the cached shadow map
+        if (!registry_.all_of<component::Dynamic>(entity)) {
+            static_shadow_dirty_ = true;
+        }
+        bounds.world = bounds.local.Transform(transform.world_model_matrix);
+        if (!bounds.world.valid()) {
+            continue;
+        }
+
+        // The tree only changes when the box leaves its fattened leaf
+        if (bounds.proxy == DynamicBVH::NULL_NODE) {
+            bounds.proxy = bvh_.CreateProxy(bounds.world, entt::to_integral(entity));
+        }
+        else {
+            bvh_.MoveProxy(bounds.proxy, bounds.world);
+        }
+    }
+}
+
+void Rasteriser::OnBoundsDestroyed(entt::registry& registry, entt::entity entity)
+{
+    const auto& bounds = registry.get<component::Bounds>(entity);
+    if (bounds.proxy != DynamicBVH::NULL_NODE) {
+        bvh_.DestroyProxy(bounds.proxy);
+    }
+    if (!registry.all_of<component::Dynamic>(entity)) {
+        static_shadow_dirty_ = true;
+    }
+}
+
+float Rasteriser::LodPixelsPerUnit(const glm::mat4& M, const AABB& local) const
+{
+    const glm::vec3 center = glm::vec3(M * glm::vec4(local.center(), 1.0f));
+    const float scale = std::max({ glm::length(glm::vec3(M[0])), glm::length(glm::vec3(M[1])), glm::length(glm::vec3(M[2])) });
+    const float radius = 0.5f * glm::length(local.max - local.min) * scale;
+
+    // Nearest point of the bounding sphere, but not closer than the near plane
+    const float distance = std::max(glm::length(center - frame_.camera_pos) - radius, camera_->GetNear());
+    return frame_.lod_scale * scale / distance;
+}
+
+void Rasteriser::SelectLods()
+{
+    auto view = registry_.view<component::Transform, component::Mesh, component::Bounds>();
+    for (auto [entity, transform, mesh_component, bounds] : view.each()) {
+        // Grass fields pick a level per instance
+        auto* instances = registry_.try_get<component::Instances>(entity);
+        if (instances && registry_.all_of<component::Grass>(entity)) {
+            AABB mesh_box;
+            for (const auto& glmesh : mesh_component.gl_meshes) {
+                mesh_box.extend(glmesh.bounds_min);
+                mesh_box.extend(glmesh.bounds_max);
+            }
+            instances->lods.resize(instances->transforms.size(), 0);
+            for (size_t i = 0; i < instances->transforms.size(); ++i) {
+                const int lod = lod_enabled_ ? component::Mesh::choose_lod(mesh_component.gl_meshes, instances->lods[i],
+                    LodPixelsPerUnit(transform.world_model_matrix * instances->transforms[i], mesh_box), lod_pixel_error_) : 0;
+                if (lod != instances->lods[i]) {
+                    instances->lods[i] = uint8_t(lod);
+                    instances->lods_dirty = true;
+                }
+            }
+            continue;
+        }
+
+        const int lod = lod_enabled_ && bounds.local.valid()
+            ? component::Mesh::choose_lod(mesh_component.gl_meshes, mesh_component.lod,
+                LodPixelsPerUnit(transform.world_model_matrix, bounds.local), lod_pixel_error_)
+            : 0;
+        if (lod == mesh_component.lod) {
+            continue;
+        }
+        mesh_component.lod = lod;
+
+        // The cached shadow map holds the silhouette of the old level
+        if (!registry_.all_of<component::Dynamic>(entity)) {
+            static_shadow_dirty_ = true;
+        }
+    }
+}
+
+Rasteriser::DrawRange Rasteriser::AppendDraws(const Frustum& frustum, const DrawFilter filter)
+{
+    DrawRange range;
+    range.first = GLsizei(draw_commands_.size());
+
+    bvh_.Query(frustum, [&](uint32_t id) {
+        const entt::entity entity = entt::entity(id);
+        if (registry_.all_of<component::Grass>(entity)) {
+            return;  // Grass has its own instanced pass
+        }
+        if (filter != DrawFilter::ALL && registry_.all_of<component::Dynamic>(entity) != (filter == DrawFilter::DYNAMIC_ONLY)) {
+            return;
+        }
+
+        // Each visible entity gets one GLDrawData, shared by its sub-meshes and both passes
+        const size_t slot = entt::to_entity(entity);
+        if (slot >= entity_draw_index_.size()) {
+            entity_draw_index_.resize(slot + 1, UINT32_MAX);
+        }
+        GLuint& draw_index = entity_draw_index_[slot];
+        const auto& transform = registry_.get<component::Transform>(entity);
+        const auto& mesh_component = registry_.get<component::Mesh>(entity);
+        if (draw_index == UINT32_MAX) {
+            draw_index = GLuint(draw_data_.size());
+            const GLMesh* first_mesh = mesh_component.gl_meshes.empty() ? nullptr : &mesh_component.gl_meshes[0];
+            draw_data_.push_back({ transform.world_model_matrix, glm::mat4(transform.normal_matrix),
+                glm::vec4(first_mesh ? first_mesh->position_offset : glm::vec3(0.0f), 0.0f),
+                glm::vec4(first_mesh ? first_mesh->position_scale : glm::vec3(1.0f), 0.0f),
+                glm::ivec4(first_mesh ? first_mesh->material_offset : 0, 0, 0, 0) });
+            drawn_entities_.push_back(slot);
+        }
+
+        for (const auto& glmesh : mesh_component.gl_meshes) {
+            const int lod = std::min(mesh_component.lod, glmesh.lod_count - 1);
+            DrawElementsIndirectCommand command;
+            command.count = GLuint(glmesh.lod_index_count[lod]);
+            command.instance_count = 1;
+            command.first_index = glmesh.lod_first_index[lod];
+            command.base_vertex = glmesh.base_vertex;
+            command.base_instance = draw_index;  // gl_BaseInstance selects the draw data
+
+            AABB box;
+            box.min = glmesh.bounds_min;
+            box.max = glmesh.bounds_max;
+            box = box.Transform(transform.world_model_matrix);
+            const bool short_indices = glmesh.index_type == GL_UNSIGNED_SHORT;
+            (short_indices ? short_draw_commands_ : draw_commands_).push_back(command);
+            (short_indices ? short_draw_bounds_ : draw_bounds_).push_back({ glm::vec4(box.min, 1.0f), glm::vec4(box.max, 1.0f) });
+
+            if (filter == DrawFilter::ALL) {
+                lod_stats_.triangles += command.count / 3;
+                lod_stats_.full_detail_triangles += size_t(glmesh.index_count) / 3;
+            }
+        }
+    });
+
+    // 16-bit index commands go last, the range is drawn with one multi-draw per index type
+    range.short_count = GLsizei(short_draw_commands_.size());
+    draw_commands_.insert(draw_commands_.end(), short_draw_commands_.begin(), short_draw_commands_.end());
+    draw_bounds_.insert(draw_bounds_.end(), short_draw_bounds_.begin(), short_draw_bounds_.end());
+    short_draw_commands_.clear();
+    short_draw_bounds_.clear();
+
+    range.count = GLsizei(draw_commands_.size()) - range.first;
+    return range;
+}
+
+void Rasteriser::BuildOpaqueDraws(const Frustum& camera_frustum, const Frustum* cascade_frusta, const unsigned static_cascades)
+{
+    draw_commands_.clear();
+    draw_data_.clear();
+    draw_bounds_.clear();
+    lod_stats_ = LodStats();
+
+    // Casters are culled against each cascade, static ones only for cascades that refresh their cached layer
+    for (int c = 0; c < CascadedShadows::MAX_CASCADES; ++c) {
+        const bool active = c < cascades_.count() && shadow_program_.valid();
+        static_shadow_draws_[c] = active && (static_cascades & (1u << c)) ? AppendDraws(cascade_frusta[c], DrawFilter::STATIC_ONLY) : DrawRange();
+        dynamic_shadow_draws_[c] = active ? AppendDraws(cascade_frusta[c], DrawFilter::DYNAMIC_ONLY) : DrawRange();
+    }
+    main_draws_ = AppendDraws(camera_frustum, DrawFilter::ALL);
+
+    // Reset only the slots touched this frame
+    for (size_t slot : drawn_entities_) {
+        entity_draw_index_[slot] = UINT32_MAX;
+    }
+    drawn_entities_.clear();
+
+    // Written into the ring region of this frame, the regions of the frames still in flight stay untouched
+    const GLsizeiptr alignment = draw_ssbo_alignment_;
+    auto aligned = [alignment](const size_t size) { return (GLsizeiptr(size) + alignment - 1) / alignment * alignment; };
+    const size_t commands_size = draw_commands_.size() * sizeof(DrawElementsIndirectCommand);
+    const size_t data_size = draw_data_.size() * sizeof(GLDrawData);
+    const size_t bounds_size = occlusion_culling_ ? draw_bounds_.size() * sizeof(OcclusionCuller::DrawBounds) : 0;
+    draw_stream_.Reserve(aligned(commands_size) + aligned(data_size) + aligned(bounds_size));
+    draw_stream_.BeginFrame();
+    draw_buffers_ = DrawBuffers();
+    draw_buffers_.buffer = draw_stream_.buffer();
+    if (draw_commands_.empty()) {
+        return;
+    }
+
+    const StreamBuffer::Allocation commands = draw_stream_.Allocate(GLsizeiptr(commands_size), alignment);
+    const StreamBuffer::Allocation data = draw_stream_.Allocate(GLsizeiptr(data_size), alignment);
+    const StreamBuffer::Allocation bounds = draw_stream_.Allocate(GLsizeiptr(bounds_size), alignment);
+    if (!commands.data || !data.data || !bounds.data) {
+        main_draws_ = DrawRange();
+        for (int c = 0; c < CascadedShadows::MAX_CASCADES; ++c) {
+            static_shadow_draws_[c] = dynamic_shadow_draws_[c] = DrawRange();
+        }
+        return;
+    }
+    std::memcpy(commands.data, draw_commands_.data(), commands_size);
+    std::memcpy(data.data, draw_data_.data(), data_size);
+    if (bounds_size > 0) {
+        std::memcpy(bounds.data, draw_bounds_.data(), bounds_size);
+    }
+    draw_buffers_.commands_offset = commands.offset;
+    draw_buffers_.data_offset = data.offset;
+    draw_buffers_.data_size = GLsizeiptr(data_size);
+    draw_buffers_.bounds_offset = bounds.offset;
+}
+
+void Rasteriser::DrawOpaque(const DrawRange& range)
+{
+    if (range.count == 0) {
+        return;
+    }
+
+    glBindVertexArray(geometry_pool_->vao());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, draw_buffers_.buffer);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, draw_buffers_.buffer, draw_buffers_.data_offset, draw_buffers_.data_size);
+    const GLsizei long_count = range.count - range.short_count;
+    if (long_count > 0) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+            (void*)(draw_buffers_.commands_offset + range.first * sizeof(DrawElementsIndirectCommand)), long_count, 0);
+    }
+    if (range.short_count > 0) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+            (void*)(draw_buffers_.commands_offset + (range.first + long_count) * sizeof(DrawElementsIndirectCommand)), range.short_count, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void Rasteriser::UploadMaterials()
+{
+    if (materials_ssbo == 0) {
+        glGenBuffers(1, &materials_ssbo);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materials_ssbo);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+        materials_.size() * sizeof(GLMaterial),
+        materials_.data(),
+        GL_DYNAMIC_DRAW);  // Consider using DYNAMIC_DRAW if you update materials
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, materials_ssbo);
+
+    std::cout << "Created materials SSBO with " << materials_.size() << " materials, handle: " << materials_ssbo << std::endl;
+}
+
+// Registry key of a material map, the same image encoded for another usage is a different texture
+static std::string MaterialTextureKey(const std::string& file_name, const texturecompress::Usage usage, const bool compressed)
+{
+    std::string key = TextureRegistry::MakeFileKey(file_name);
+    if (compressed) {
+        key += usage == texturecompress::Usage::NORMAL ? "|bc5" : usage == texturecompress::Usage::DATA ? "|bc1" : "|bc1_srgb";
+    }
+    return key;
+}
+
+std::shared_ptr<Rasteriser::DecodedTexture> Rasteriser::DecodeMaterialTexture(DecodedMesh& mesh, const std::string& file_name,
+    const texturecompress::Usage usage, int width, int height, const GLvoid* data) const
+{
+    // Without a file the image can't be cached, it goes up uncompressed and is shared by content as before
+    const bool compress = texture_compression_ && !file_name.empty();
+    std::string key;
+    if (compress || !data) {
+        if (file_name.empty()) {
+            return nullptr;
+        }
+        key = MaterialTextureKey(file_name, usage, compress);
+    }
+    else {
+        if (width <= 0 || height <= 0) {
+            std::cout << "ERROR: Invalid texture dimensions: " << width << "x" << height << std::endl;
+            return nullptr;
+        }
+        key = TextureRegistry::MakeKey(width, height, data, 0);
+    }
+
+    // A map several materials use is decoded once per mesh file
+    std::shared_ptr<DecodedTexture>& texture = mesh.textures[key];
+    if (texture) {
+        return texture;
+    }
+    texture = std::make_shared<DecodedTexture>();
+    texture->key = key;
+
+    // Fast path - blocks and mips encoded by a previous run, invalidated when the image changes
+    const std::string cache_file_name = texturecompress::CachePath(file_name);
+    if (compress && texture->cache.Open(cache_file_name, file_name, usage)) {
+        texture->upload.image = texture->cache.image();
+        return texture;
+    }
+
+    if (!data) {
+        texture->decoded = std::make_unique<Texture>(Texture3u(file_name));
+        width = texture->decoded->width();
+        height = texture->decoded->height();
+        data = texture->decoded->data();
+    }
+    if (!data || width <= 0 || height <= 0) {
+        std::cout << "ERROR: Failed to load texture from: " << file_name << std::endl;
+        return texture;  // Nothing to upload, the commit hands out handle 0
+    }
+    if (!compress) {
+        texture->upload.rgb = static_cast<const uint8_t*>(data);
+        texture->upload.width = width;
+        texture->upload.height = height;
+        return texture;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!texturecompress::Compress(static_cast<const uint8_t*>(data), width, height, usage, thread_pool_.get(),
+        texture->storage, texture->upload.image)) {
+        return texture;
+    }
+    const texturecompress::Image& image = texture->upload.image;
+    const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Encoded " << file_name << ": " << width << "x" << height << ", " << image.levels.size() << " levels, "
+        << texturecompress::CompressedSize(image) / 1024 << " KiB (" << texturecompress::UncompressedSize(image) / 1024
+        << " KiB as RGBA8) in " << milliseconds << " ms" << std::endl;
+
+    texturecompress::Write(cache_file_name, file_name, image);
+    return texture;
+}
+
+bool Rasteriser::CommitMaterialTexture(DecodedTexture& texture, GLuint64& handle)
+{
+    // Already in the registry (an earlier sub-mesh or asset) - just another reference
+    if (!texture_registry_->contains(texture.key) && !asset_streamer_->Upload(texture.upload)) {
+        return false;
+    }
+    handle = texture_registry_->Acquire(texture.key, [&]() { return texture.upload.texture; });
+    texture.upload = AssetStreamer::TextureUpload();  // The registry owns the texture now
+    return true;
+}
+
+int Rasteriser::DecodeMeshCache(const std::string& file_name, DecodedMesh& mesh)
+{
+    if (!mesh.cache.Open(binarymesh::CachePath(file_name))) {
+        return S_FALSE;
+    }
+
+    const binarymesh::FileHeader& header = mesh.cache.header();
+    mesh.quantization_min = glm::make_vec3(header.bounds_min);
+    mesh.quantization_max = glm::make_vec3(header.bounds_max);
+    for (uint32_t i = 0; i < header.sub_mesh_count; ++i) {
+        const binarymesh::SubMeshRecord& record = mesh.cache.sub_mesh(i);
+        DecodedMesh::SubMesh& sub_mesh = mesh.sub_meshes.emplace_back();
+
+        // Mapped file pages go straight to the driver, no parsing or intermediate copy (a compact pool packs them on the way)
+        sub_mesh.vertices = mesh.cache.vertices(i);
+        sub_mesh.vertex_size = record.vertex_size;
+        sub_mesh.indices = mesh.cache.indices(i);
+        sub_mesh.index_size = record.index_size;
+        sub_mesh.lod_count = record.lod_count;
+        std::copy(record.lod_index_count, record.lod_index_count + GLMesh::MAX_LODS, sub_mesh.lod_index_count);
+        std::copy(record.lod_error, record.lod_error + GLMesh::MAX_LODS, sub_mesh.lod_error);
+        sub_mesh.bounds_min = glm::make_vec3(record.bounds_min);
+        sub_mesh.bounds_max = glm::make_vec3(record.bounds_max);
+        std::cout << "Sub-mesh " << i << ": " << record.vertex_count << " vertices, " << record.lod_index_count[0] / 3
+            << " triangles, " << record.lod_count << " levels of detail, ACMR " << record.acmr << ", ATVR " << record.atvr << std::endl;
+
+        const binarymesh::MaterialRecord& material = mesh.cache.material(i);
+        GLMaterial& gl_mat = sub_mesh.material;
+        gl_mat.diffuse = Color3f({ material.diffuse[0], material.diffuse[1], material.diffuse[2] });
+        gl_mat.rma = Color3f({ material.rma[0], material.rma[1], material.rma[2] });
+        gl_mat.normal = Color3f({ material.normal[0], material.normal[1], material.normal[2] });
+        sub_mesh.maps[0] = DecodeMaterialTexture(mesh, material.diffuse_map, texturecompress::Usage::COLOR, 0, 0, nullptr);
+        sub_mesh.maps[1] = DecodeMaterialTexture(mesh, material.normal_map, texturecompress::Usage::NORMAL, 0, 0, nullptr);
+        sub_mesh.maps[2] = DecodeMaterialTexture(mesh, material.rma_map, texturecompress::Usage::DATA, 0, 0, nullptr);
+    }
+
+    std::cout << "Loaded '" << file_name << "' from mesh cache (" << header.sub_mesh_count << " sub-meshes)" << std::endl;
+    return S_OK;
+}
+
+void Rasteriser::DecodeMesh(const std::string& file_mame, DecodedMesh& mesh) {
 
     //https://mrl.cs.vsb.cz/people/fabian/pg1/6887.zip
 
-    meshes_.clear();
+    // Fast path - binary cache written by a previous run, invalidated when the OBJ or MTL changes
+    if (DecodeMeshCache(file_mame, mesh) == S_OK) {
+        return;
+    }
+
+    _mesh_loader->LoadTriangularMesh(file_mame, mesh.meshes);
+    if (mesh.meshes.empty()) {
+        mesh.result = S_FALSE;
+    }
 
-    _mesh_loader->LoadTriangularMesh(file_mame, meshes_);
+    // Texture file names aren't exposed by MeshLoader, the cache takes them from the .mtl files
+    const std::vector<std::string> material_libraries = binarymesh::FindMaterialLibraries(file_mame);
+    const auto material_textures = binarymesh::ReadMaterialTextures(material_libraries);
+    std::vector<binarymesh::SubMeshData> cache_sub_meshes;
+    bool cacheable = !mesh.meshes.empty();
+
+    // All sub-meshes share the entity's draw data, so compact positions are quantised against the whole file
+    // MeshLoader numbers materials across every file it parsed, so indices are kept relative to this file's first
+    mesh.quantization_min = glm::vec3(FLT_MAX);
+    mesh.quantization_max = glm::vec3(-FLT_MAX);
+    int first_material = INT_MAX;
+    for (const auto& triangular_mesh : mesh.meshes) {
+        const Vertex* vertex_array = static_cast<const Vertex*>(triangular_mesh->vertex_buffer());
+        for (size_t i = 0; i < triangular_mesh->vertex_buffer_count(); ++i) {
+            const glm::vec3 position = vertex_array[i].position;
+            mesh.quantization_min = glm::min(mesh.quantization_min, position);
+            mesh.quantization_max = glm::max(mesh.quantization_max, position);
+            first_material = std::min(first_material, int(vertex_array[i].mat_idx.x));
+        }
+    }
+    mesh.vertex_buffers.reserve(mesh.meshes.size());
+    mesh.index_buffers.reserve(mesh.meshes.size());
+    mesh.sub_meshes.reserve(mesh.meshes.size());
    
-    for (const auto& mesh : meshes_) {
-        auto vertices = mesh->vertex_buffer();
-        const size_t vertex_buffer_size = mesh->vertex_buffer_size();
-        const size_t vertex_buffer_count = mesh->vertex_buffer_count();
+    for (const auto& triangular_mesh : mesh.meshes) {
+        auto vertices = triangular_mesh->vertex_buffer();
+        const size_t vertex_buffer_size = triangular_mesh->vertex_buffer_size();
+        const size_t vertex_buffer_count = triangular_mesh->vertex_buffer_count();
         const GLsizei vertex_stride = vertices[0].size();
         assert(vertex_stride == vertex_buffer_size / vertex_buffer_count);
 
-        auto indices = mesh->index_buffer();
-        const size_t index_buffer_size = mesh->index_buffer_size();
-        const size_t index_buffer_count = mesh->index_buffer_count();
-
-        // ===== CORRECTED DIAGNOSTIC CODE =====
-        std::cout << "\n=== Vertex Material Index Debug ===" << std::endl;
-        std::cout << "Mesh has " << vertex_buffer_count << " vertices" << std::endl;
-        std::cout << "Material indices in vertices: ";
+        auto indices = triangular_mesh->index_buffer();
+        const size_t index_buffer_size = triangular_mesh->index_buffer_size();
+        const size_t index_buffer_count = triangular_mesh->index_buffer_count();
 
-        // Cast the void* to Vertex* so we can access the data
         const Vertex* vertex_array = static_cast<const Vertex*>(vertices);
-        for (size_t i = 0; i < std::min(vertex_buffer_count, size_t(20)); ++i) {
-            std::cout << vertex_array[i].mat_idx.x << " ";
+
+        // Triangles reordered for the post-transform vertex cache, then clustered against overdraw
+        const GLuint* source_indices = static_cast<const GLuint*>(indices);
+        const size_t source_index_count = index_buffer_size / sizeof(GLuint);
+        std::vector<Vertex>& optimized_vertices = mesh.vertex_buffers.emplace_back(vertex_array, vertex_array + vertex_buffer_count);
+        for (Vertex& vertex : optimized_vertices) {
+            vertex.mat_idx.x -= first_material;
         }
-        if (vertex_buffer_count > 20) {
-            std::cout << "...";
+        std::vector<GLuint>& lod_indices = mesh.index_buffers.emplace_back(source_indices, source_indices + source_index_count);
+        const meshoptimize::CacheStats source_stats = meshoptimize::AnalyzeVertexCache(source_indices, source_index_count, vertex_buffer_count);
+        meshoptimize::OptimizeVertexCache(lod_indices.data(), source_index_count, vertex_buffer_count);
+        meshoptimize::OptimizeOverdraw(lod_indices.data(), source_index_count, optimized_vertices.data(), vertex_buffer_count);
+        const meshoptimize::CacheStats optimized_stats = meshoptimize::AnalyzeVertexCache(lod_indices.data(), source_index_count, vertex_buffer_count);
+
+        // Coarser levels of detail are appended to the source indices and share its vertices
+        std::vector<meshsimplify::Lod> lods = meshsimplify::BuildLods(optimized_vertices.data(), vertex_buffer_count,
+            lod_indices.data(), source_index_count, GLMesh::MAX_LODS - 1);
+        DecodedMesh::SubMesh& sub_mesh = mesh.sub_meshes.emplace_back();
+        sub_mesh.lod_count = uint32_t(lods.size() + 1);
+        sub_mesh.lod_index_count[0] = uint32_t(source_index_count);
+        for (size_t lod = 0; lod < lods.size(); ++lod) {
+            meshoptimize::OptimizeVertexCache(lods[lod].indices.data(), lods[lod].indices.size(), vertex_buffer_count);
+            lod_indices.insert(lod_indices.end(), lods[lod].indices.begin(), lods[lod].indices.end());
+            sub_mesh.lod_index_count[lod + 1] = uint32_t(lods[lod].indices.size());
+            sub_mesh.lod_error[lod + 1] = lods[lod].error;
         }
-        std::cout << std::endl;
-        std::cout << "Current materials array size: " << materials_.size() << std::endl;
-        std::cout << "====================================\n" << std::endl;
-        // ===== END OF DIAGNOSTIC CODE =====
-
-        GLuint vao = 0;
-        glGenVertexArrays(1, &vao);
-        glBindVertexArray(vao);
-        GLuint vbo = 0;
-        glGenBuffers(1, &vbo); // generate vertex buffer object (one of OpenGL objects) and get the unique ID corresponding to that buffer
-        glBindBuffer(GL_ARRAY_BUFFER, vbo); // bind the newly created buffer to the GL_ARRAY_BUFFER target
-        glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, vertices, GL_STATIC_DRAW); // copies the previously defined vertex data into the buffer's memory
-        // vertex position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, GLsizei(vertex_stride), 0);
-        glEnableVertexAttribArray(0);
-        // vertex normal
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, GLsizei(vertex_stride), (void*)offsetof(Vertex, normal));
-        glEnableVertexAttribArray(1);
-        //vector tangent
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, GLsizei(vertex_stride), (void*)offsetof(Vertex, tangent));
-        glEnableVertexAttribArray(2);
-
-        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, GLsizei(vertex_stride), (void*)offsetof(Vertex, tex_coord));
-        glEnableVertexAttribArray(3);
-
-        glVertexAttribIPointer(4, 1, GL_INT, GLsizei(vertex_stride), (void*)offsetof(Vertex, mat_idx));
-        glEnableVertexAttribArray(4);
-        auto material = mesh->material();
-        std::cout << "=== Material Debug: " << material->name() << " ===" << std::endl;
-        std::cout << "Has diffuse_map: " << (material->diffuse_map != nullptr) << std::endl;
-        if (material->diffuse_map) {
-            std::cout << "Diffuse map dimensions: " << material->diffuse_map->width()
-                << "x" << material->diffuse_map->height() << std::endl;
-            std::cout << "Diffuse map data pointer: " << material->diffuse_map->data() << std::endl;
+        std::cout << "Levels of detail: " << source_index_count / 3;
+        for (const auto& lod : lods) {
+            std::cout << " -> " << lod.indices.size() / 3;
+        }
+        std::cout << " triangles" << std::endl;
+
+        // Vertices in the order the levels first use them, level 0 first
+        const size_t optimized_vertex_count = meshoptimize::OptimizeVertexFetch(optimized_vertices.data(), vertex_buffer_count,
+            lod_indices.data(), lod_indices.size());
+        optimized_vertices.resize(optimized_vertex_count);
+        std::cout << "Vertex cache: ACMR " << source_stats.acmr << " -> " << optimized_stats.acmr
+            << ", ATVR " << source_stats.atvr << " -> " << optimized_stats.atvr
+            << " (" << optimized_vertex_count << " of " << vertex_buffer_count << " vertices referenced)" << std::endl;
+
+        sub_mesh.vertices = optimized_vertices.data();
+        sub_mesh.vertex_size = optimized_vertex_count * sizeof(Vertex);
+        sub_mesh.indices = lod_indices.data();
+        sub_mesh.index_size = lod_indices.size() * sizeof(GLuint);
+
+        // Local bounds for culling
+        sub_mesh.bounds_min = glm::vec3(FLT_MAX);
+        sub_mesh.bounds_max = glm::vec3(-FLT_MAX);
+        for (size_t i = 0; i < optimized_vertex_count; ++i) {
+            const glm::vec3 position = optimized_vertices[i].position;
+            sub_mesh.bounds_min = glm::min(sub_mesh.bounds_min, position);
+            sub_mesh.bounds_max = glm::max(sub_mesh.bounds_max, position);
         }
-        std::cout << "Has normal_map: " << (material->normal_map != nullptr) << std::endl;
-        std::cout << "Has specular_map: " << (material->specular_map != nullptr) << std::endl;
-        std::cout << "=========================" << std::endl;
 
-        GLMaterial gl_mat{};
+        auto material = triangular_mesh->material();
+
+        GLMaterial& gl_mat = sub_mesh.material;
 
         // Set diffuse color - use diffuse_color from material
         Color3f diffuse_color_val = material->diffuse_color.value_or(Color3f::gray50);
@@ -276,120 +921,164 @@ int Rasteriser::LoadMesh(const std::string& file_mame, std::vector<GLMesh> & gl_
         gl_mat.normal = Color3f({ 0.5f, 0.5f, 1.0f });
 
 
-        // Create bindless textures
+        // Decode (and encode) the maps here, the commit only uploads them. Compressed ones are cached next to the
+        // map files the .mtl names
+        const auto map_files = material_textures.find(material->name());
+        const binarymesh::MaterialTextures no_map_files;
+        const binarymesh::MaterialTextures& maps = map_files != material_textures.end() ? map_files->second : no_map_files;
 
         // Diffuse texture
         if (material->diffuse_map) {
-            GLuint tex_id;
-            CreateBindlessTexture(tex_id, gl_mat.tex_diffuse_handle,
-                material->diffuse_map->width(), material->diffuse_map->height(),
-                material->diffuse_map->data(), 0);
-            std::cout << "Created diffuse texture handle: " << gl_mat.tex_diffuse_handle << std::endl;
-        }
-        else {
-            gl_mat.tex_diffuse_handle = 0;
-            std::cout << "No diffuse texture, using color: ("
-                << diffuse_color_val.data[0] << ", "
-                << diffuse_color_val.data[1] << ", "
-                << diffuse_color_val.data[2] << ")" << std::endl;
+            sub_mesh.maps[0] = DecodeMaterialTexture(mesh, maps.diffuse_map, texturecompress::Usage::COLOR,
+                material->diffuse_map->width(), material->diffuse_map->height(), material->diffuse_map->data());
         }
 
         // Normal map
         if (material->normal_map) {
-            GLuint tex_id;
-            CreateBindlessTexture(tex_id, gl_mat.tex_normal_handle,
-                material->normal_map->width(), material->normal_map->height(),
-                material->normal_map->data(), 0);
-            std::cout << "Created normal texture handle: " << gl_mat.tex_normal_handle << std::endl;
-        }
-        else {
-            gl_mat.tex_normal_handle = 0;
+            sub_mesh.maps[1] = DecodeMaterialTexture(mesh, maps.normal_map, texturecompress::Usage::NORMAL,
+                material->normal_map->width(), material->normal_map->height(), material->normal_map->data());
         }
 
         // RMA texture - use specular map if available, or roughness/metallic maps
         if (material->specular_map) {
-            GLuint tex_id;
-            CreateBindlessTexture(tex_id, gl_mat.tex_rma_handle,
-                material->specular_map->width(), material->specular_map->height(),
-                material->specular_map->data(), 0);
-            std::cout << "Created RMA texture handle from specular map: " << gl_mat.tex_rma_handle << std::endl;
+            sub_mesh.maps[2] = DecodeMaterialTexture(mesh, maps.specular_map, texturecompress::Usage::DATA,
+                material->specular_map->width(), material->specular_map->height(), material->specular_map->data());
         }
         else if (material->roughness_map) {
-            GLuint tex_id;
-            CreateBindlessTexture(tex_id, gl_mat.tex_rma_handle,
-                material->roughness_map->width(), material->roughness_map->height(),
-                material->roughness_map->data(), 0);
-            std::cout << "Created RMA texture handle from roughness map: " << gl_mat.tex_rma_handle << std::endl;
+            sub_mesh.maps[2] = DecodeMaterialTexture(mesh, maps.roughness_map, texturecompress::Usage::DATA,
+                material->roughness_map->width(), material->roughness_map->height(), material->roughness_map->data());
         }
         else if (material->metallic_map) {
-            GLuint tex_id;
-            CreateBindlessTexture(tex_id, gl_mat.tex_rma_handle,
-                material->metallic_map->width(), material->metallic_map->height(),
-                material->metallic_map->data(), 0);
-            std::cout << "Created RMA texture handle from metallic map: " << gl_mat.tex_rma_handle << std::endl;
-        }
-        else {
-            gl_mat.tex_rma_handle = 0;
+            sub_mesh.maps[2] = DecodeMaterialTexture(mesh, maps.metallic_map, texturecompress::Usage::DATA,
+                material->metallic_map->width(), material->metallic_map->height(), material->metallic_map->data());
         }
 
-        // Debug output for material properties
-        std::cout << "Material properties - Roughness: " << roughness
-            << ", Metalness: " << metalness
-            << ", Specular: " << specular_intensity << std::endl;
+        // Record everything needed to rebuild this sub-mesh without the OBJ parser
+        binarymesh::SubMeshData cache_sub_mesh;
+        cache_sub_mesh.vertices = optimized_vertices.data();
+        cache_sub_mesh.vertex_size = optimized_vertex_count * sizeof(Vertex);
+        cache_sub_mesh.vertex_count = optimized_vertex_count;
+        cache_sub_mesh.acmr = optimized_stats.acmr;
+        cache_sub_mesh.atvr = optimized_stats.atvr;
+        cache_sub_mesh.indices = lod_indices.data();
+        cache_sub_mesh.index_size = lod_indices.size() * sizeof(GLuint);
+        cache_sub_mesh.index_count = index_buffer_count;
+        cache_sub_mesh.lod_count = std::min(sub_mesh.lod_count, uint32_t(GLMesh::MAX_LODS));
+        std::copy(sub_mesh.lod_index_count, sub_mesh.lod_index_count + GLMesh::MAX_LODS, cache_sub_mesh.lod_index_count);
+        std::copy(sub_mesh.lod_error, sub_mesh.lod_error + GLMesh::MAX_LODS, cache_sub_mesh.lod_error);
+        cache_sub_mesh.bounds_min = sub_mesh.bounds_min;
+        cache_sub_mesh.bounds_max = sub_mesh.bounds_max;
+
+        binarymesh::MaterialRecord& record = cache_sub_mesh.material;
+        const std::string material_name = material->name();
+        binarymesh::CopyString(record.name, binarymesh::kMaxName, material_name);
+        for (int k = 0; k < 3; ++k) {
+            record.diffuse[k] = gl_mat.diffuse.data[k];
+            record.rma[k] = gl_mat.rma.data[k];
+            record.normal[k] = gl_mat.normal.data[k];
+        }
+        // Same map priority as above
+        const bool has_rma_map = material->specular_map || material->roughness_map || material->metallic_map;
+        {
+            const std::string rma_map = material->specular_map ? maps.specular_map
+                : material->roughness_map ? maps.roughness_map
+                : material->metallic_map ? maps.metallic_map : std::string();
+            binarymesh::CopyString(record.diffuse_map, binarymesh::kMaxPath, material->diffuse_map ? maps.diffuse_map : std::string());
+            binarymesh::CopyString(record.normal_map, binarymesh::kMaxPath, material->normal_map ? maps.normal_map : std::string());
+            binarymesh::CopyString(record.rma_map, binarymesh::kMaxPath, rma_map);
+        }
 
-        materials_.push_back(gl_mat);
+        // A map MeshLoader found but the .mtl scan didn't would be lost on the next run
+        if ((material->diffuse_map && record.diffuse_map[0] == '\0') || (material->normal_map && record.normal_map[0] == '\0')
+            || (has_rma_map && record.rma_map[0] == '\0')) {
+            cacheable = false;
+        }
+        cache_sub_meshes.push_back(cache_sub_mesh);
+    }
 
-        GLuint ebo = 0;
-        glGenBuffers(1, &ebo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size, indices, GL_STATIC_DRAW);
-        gl_meshes.push_back(GLMesh{ vao, vbo, ebo, mesh });
+    std::vector<std::string> dependencies{ file_mame };
+    dependencies.insert(dependencies.end(), material_libraries.begin(), material_libraries.end());
+    if (cacheable) {
+        binarymesh::Write(binarymesh::CachePath(file_mame), dependencies, cache_sub_meshes);
     }
+}
 
-    if (materials_ssbo == 0) {
-        glGenBuffers(1, &materials_ssbo);
+bool Rasteriser::CommitMesh(DecodedMesh& mesh, std::vector<GLMesh>& gl_meshes)
+{
+    // Vertex material indices count from the file's first material, the asset's materials get one range of slots.
+    // The draws add its start, so the vertices go to the pool as read from the cache
+    if (mesh.first_material < 0 && !mesh.sub_meshes.empty()) {
+        size_t first = material_ranges_.Allocate(mesh.sub_meshes.size());
+        if (first == RangeAllocator::INVALID) {
+            material_ranges_.Grow(material_ranges_.capacity() + mesh.sub_meshes.size());
+            first = material_ranges_.Allocate(mesh.sub_meshes.size());
+            materials_.resize(material_ranges_.capacity());
+        }
+        mesh.first_material = int(first);
     }
+    while (mesh.committed < mesh.sub_meshes.size()) {
+        DecodedMesh::SubMesh& sub_mesh = mesh.sub_meshes[mesh.committed];
+
+        // Maps first, they may take more than one frame's staging budget
+        GLuint64* handles[3] = { &sub_mesh.material.tex_diffuse_handle, &sub_mesh.material.tex_normal_handle, &sub_mesh.material.tex_rma_handle };
+        for (; sub_mesh.maps_committed < 3; ++sub_mesh.maps_committed) {
+            const auto& map = sub_mesh.maps[sub_mesh.maps_committed];
+            GLuint64& handle = *handles[sub_mesh.maps_committed];
+            if (!map) {
+                continue;
+            }
+            if (!CommitMaterialTexture(*map, handle)) {
+                return false;
+            }
+            if (handle != 0) {
+                mesh.texture_handles.push_back(handle);
+            }
+        }
 
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materials_ssbo);
-    glBufferData(GL_SHADER_STORAGE_BUFFER,
-        materials_.size() * sizeof(GLMaterial),
-        materials_.data(),
-        GL_DYNAMIC_DRAW);  // Consider using DYNAMIC_DRAW if you update materials
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, materials_ssbo);
+        // A sub-mesh the pool can't hold is left out, its material still takes its slot so the indices stay aligned
+        GLMesh glmesh;
+        if (UploadMesh(sub_mesh.vertices, sub_mesh.vertex_size, GLsizei(sizeof(Vertex)), sub_mesh.indices, sub_mesh.index_size,
+            mesh.quantization_min, mesh.quantization_max, glmesh) == S_OK) {
+            SetLodRanges(glmesh, sub_mesh.lod_count, sub_mesh.lod_index_count, sub_mesh.lod_error);
+            glmesh.material_offset = mesh.first_material;
+            glmesh.bounds_min = sub_mesh.bounds_min;
+            glmesh.bounds_max = sub_mesh.bounds_max;
+            std::cout << "Sub-mesh " << mesh.committed << " resident, texture handles: " << sub_mesh.material.tex_diffuse_handle << ", "
+                << sub_mesh.material.tex_normal_handle << ", " << sub_mesh.material.tex_rma_handle << std::endl;
+            gl_meshes.push_back(glmesh);
+        }
+        else {
+            std::cout << "ERROR: Sub-mesh " << mesh.committed << " didn't fit into the geometry pool" << std::endl;
+            mesh.result = S_FALSE;
+        }
 
+        materials_[mesh.first_material + mesh.committed] = sub_mesh.material;
+        ++mesh.committed;
 
-    std::cout << "Created materials SSBO with " << materials_.size() << " materials, handle: " << materials_ssbo << std::endl;
-    return 0;
+        if (mesh.committed < mesh.sub_meshes.size() && !asset_streamer_->HasTimeLeft()) {
+            return false;
+        }
+    }
+
+    geometry_pool_->PrintStats();
+    UploadMaterials();
+    return true;
 }
 
 int Rasteriser::LoadProgram(const std::string& vs_file_name, const std::string& fs_file_name)
 {
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    std::vector<char> shader_source;
-    if (LoadShader(vs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(vertex_shader, 1, &tmp, nullptr);
-        glCompileShader(vertex_shader);
-    }
-    CheckShader(vertex_shader);
-
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    if (LoadShader(fs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(fragment_shader, 1, &tmp, nullptr);
-        glCompileShader(fragment_shader);
+    if (phong_program_.Load(vs_file_name, fs_file_name) != S_OK) {
+        return EXIT_FAILURE;
     }
-    CheckShader(fragment_shader);
+    glUseProgram(phong_program_.id());
 
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    // TODO check linking
-    glUseProgram(shader_program);
-    default_shader_program_ = shader_program;
+    // Shadow map always lives on texture unit 3, the cached static map on unit 5
+    phong_program_.uniform<GLint>("shadow_map").Set(3);
+    phong_program_.uniform<GLint>("static_shadow_map").Set(5);
+    phong_uniforms_.shadow_filter = phong_program_.uniform<GLint>("shadow_filter");
+    phong_uniforms_.shadow_taps = phong_program_.uniform<GLint>("shadow_taps");
+    phong_uniforms_.shadow_dynamic_cascades = phong_program_.uniform<GLint>("shadow_dynamic_cascades");
+    SetShadowQuality(shadow_quality_, shadow_taps_);
 
     return 0;
 
@@ -397,92 +1086,86 @@ int Rasteriser::LoadProgram(const std::string& vs_file_name, const std::string&
 
 int Rasteriser::LoadGrassProgram(const std::string& vs_file_name, const std::string& fs_file_name)
 {
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    std::vector<char> shader_source;
-    if (LoadShader(vs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(vertex_shader, 1, &tmp, nullptr);
-        glCompileShader(vertex_shader);
+    if (grass_program_.Load(vs_file_name, fs_file_name) != S_OK) {
+        return EXIT_FAILURE;
     }
-    CheckShader(vertex_shader);
 
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    if (LoadShader(fs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(fragment_shader, 1, &tmp, nullptr);
-        glCompileShader(fragment_shader);
-    }
-    CheckShader(fragment_shader);
+    grass_uniforms_.M = grass_program_.uniform<glm::mat4>("M");
+    grass_uniforms_.Mn = grass_program_.uniform<glm::mat3>("Mn");
+    grass_uniforms_.position_offset = grass_program_.uniform<glm::vec3>("position_offset");
+    grass_uniforms_.position_scale = grass_program_.uniform<glm::vec3>("position_scale");
+    grass_uniforms_.material_offset = grass_program_.uniform<GLint>("material_offset");
 
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    grass_shader_program_ = shader_program;
+    // Grass entities without Instances component draw through a single identity instance
+    const GLInstance identity{ glm::mat4(1.0f), glm::mat4(1.0f) };
+    glGenBuffers(1, &identity_instance_ssbo_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, identity_instance_ssbo_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLInstance), &identity, GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
-    std::cout << "Grass shader program loaded: " << grass_shader_program_ << std::endl;
+    std::cout << "Grass shader program loaded: " << grass_program_.id() << std::endl;
     return 0;
 }
 
 int Rasteriser::LoadShadowProgram(const std::string& vs_file_name, const std::string& fs_file_name)
 {
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    std::vector<char> shader_source;
-    if (LoadShader(vs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(vertex_shader, 1, &tmp, nullptr);
-        glCompileShader(vertex_shader);
+    if (shadow_program_.Load(vs_file_name, fs_file_name) != S_OK) {
+        return EXIT_FAILURE;
     }
-    CheckShader(vertex_shader);
 
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    if (LoadShader(fs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(fragment_shader, 1, &tmp, nullptr);
-        glCompileShader(fragment_shader);
-    }
-    CheckShader(fragment_shader);
+    shadow_cascade_uniform_ = shadow_program_.uniform<GLint>("cascade");
+
+    std::cout << "Shadow shader program loaded: " << shadow_program_.id() << std::endl;
+    return 0;
+}
 
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    shadow_program_ = shader_program;
+int Rasteriser::LoadDepthPrepassProgram(const std::string& vs_file_name, const std::string& fs_file_name)
+{
+    if (depth_prepass_program_.Load(vs_file_name, fs_file_name) != S_OK) {
+        return EXIT_FAILURE;
+    }
 
-    std::cout << "Shadow shader program loaded: " << shadow_program_ << std::endl;
+    std::cout << "Depth pre-pass program loaded: " << depth_prepass_program_.id() << std::endl;
     return 0;
 }
 
-void Rasteriser::InitShadowDepthbuffer()
+void Rasteriser::SetDepthPrepass(const bool enabled)
 {
-    // Create texture to hold depth values from light's perspective
-    glGenTextures(1, &tex_shadow_map_);
-    glBindTexture(GL_TEXTURE_2D, tex_shadow_map_);
+    if (enabled && !depth_prepass_program_.valid()) {
+        std::cout << "WARNING: Depth pre-pass program not loaded, pre-pass stays off" << std::endl;
+        depth_prepass_ = false;
+        return;
+    }
+    depth_prepass_ = enabled;
+    std::cout << "Depth pre-pass: " << (depth_prepass_ ? "on" : "off") << std::endl;
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, shadow_width_, shadow_height_,
+void Rasteriser::CreateShadowTarget(GLuint& texture, GLuint& fbo) const
+{
+    // Depth values from the light's perspective, one layer per cascade
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, shadow_width_, shadow_height_, cascades_.count(),
                  0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 
     // Areas outside the light's frustum will be lit (white border)
     const float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border_color);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border_color);
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     // Create framebuffer for shadow pass
-    glGenFramebuffers(1, &fbo_shadow_map_);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_shadow_map_);
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-    // Attach texture as depth attachment
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, tex_shadow_map_, 0);
+    // Layer 0 for the completeness check, DrawShadowCasters() attaches the layer it renders
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
 
     // We don't need color buffer for depth pass
     glDrawBuffer(GL_NONE);
@@ -491,188 +1174,522 @@ void Rasteriser::InitShadowDepthbuffer()
     // Check framebuffer completeness
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
         std::cout << "ERROR: Shadow framebuffer is not complete!" << std::endl;
-    } else {
-        std::cout << "Shadow framebuffer initialized: " << shadow_width_ << "x" << shadow_height_ << std::endl;
     }
 
     // Bind default framebuffer back
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-int Rasteriser::LoadSkyboxProgram(const std::string& vs_file_name, const std::string& fs_file_name)
+void Rasteriser::InitShadowDepthbuffer(const int resolution, const int cascades)
 {
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    std::vector<char> shader_source;
-    if (LoadShader(vs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(vertex_shader, 1, &tmp, nullptr);
-        glCompileShader(vertex_shader);
+    cascades_.set_count(cascades);
+
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    shadow_width_ = std::clamp(resolution, 256, std::max(int(max_size), 256));
+    shadow_height_ = shadow_width_;
+
+    if (fbo_static_shadow_map_ != 0) {
+        glDeleteFramebuffers(1, &fbo_static_shadow_map_);
+        glDeleteTextures(1, &tex_static_shadow_map_);
     }
-    CheckShader(vertex_shader);
 
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    if (LoadShader(fs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(fragment_shader, 1, &tmp, nullptr);
-        glCompileShader(fragment_shader);
+    // Static casters are rendered into their own map only when they or the light change,
+    // dynamic casters are drawn every frame on top of a copy of it (transient target of the frame graph)
+    CreateShadowTarget(tex_static_shadow_map_, fbo_static_shadow_map_);
+    static_shadow_dirty_ = true;
+
+    // Comparison and filtering live in a sampler object, so the graph's transient map needs no compare mode
+    if (shadow_sampler_ == 0) {
+        glGenSamplers(1, &shadow_sampler_);
+        glSamplerParameteri(shadow_sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(shadow_sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(shadow_sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glSamplerParameteri(shadow_sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        const float border_color[] = { 1.0f, 1.0f, 1.0f, 1.0f };  // Outside the light's frustum is lit
+        glSamplerParameterfv(shadow_sampler_, GL_TEXTURE_BORDER_COLOR, border_color);
+        glSamplerParameteri(shadow_sampler_, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glSamplerParameteri(shadow_sampler_, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    }
+
+    std::cout << "Shadow framebuffer initialized: " << cascades_.count() << " cascades of " << shadow_width_ << "x" << shadow_height_ << std::endl;
+}
+
+void Rasteriser::SetShadowResolution(const int resolution)
+{
+    pending_shadow_resolution_ = resolution;
+}
+
+void Rasteriser::SetShadowQuality(const ShadowQuality quality, const int poisson_taps)
+{
+    static const char* names[] = { "low (hardware 2x2 PCF)", "medium (3x3 hardware PCF)", "high (rotated Poisson disk)" };
+    shadow_quality_ = quality;
+    shadow_taps_ = std::clamp(poisson_taps, 4, 32);  // SHADOW_MAX_TAPS
+    phong_uniforms_.shadow_filter.Set(GLint(quality));
+    phong_uniforms_.shadow_taps.Set(shadow_taps_);
+
+    std::cout << "Shadow quality: " << names[int(quality)];
+    if (quality == ShadowQuality::HIGH) {
+        std::cout << ", " << shadow_taps_ << " taps";
+    }
+    std::cout << std::endl;
+}
+
+void Rasteriser::InvalidateStaticShadows(entt::registry& registry, entt::entity entity)
+{
+    static_shadow_dirty_ = true;
+}
+
+int Rasteriser::LoadSkyboxProgram(const std::string& vs_file_name, const std::string& fs_file_name)
+{
+    if (skybox_program_.Load(vs_file_name, fs_file_name) != S_OK) {
+        return EXIT_FAILURE;
     }
-    CheckShader(fragment_shader);
 
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    skybox_shader_program_ = shader_program;
+    skybox_uniforms_.skybox_texture = skybox_program_.uniform<GLuint64>("skybox_texture");
 
     // Create VAO for fullscreen triangle (uses gl_VertexID, no actual vertex data needed)
     glGenVertexArrays(1, &skybox_vao_);
 
-    std::cout << "Skybox shader program loaded: " << skybox_shader_program_ << std::endl;
+    std::cout << "Skybox shader program loaded: " << skybox_program_.id() << std::endl;
     return 0;
 }
 
 void Rasteriser::LoadSkyboxTexture(const std::string& texture_path)
 {
-    // Load the texture using FreeImage through the Texture class
-    Texture texture = Texture3u(texture_path);
+    // Load the texture using FreeImage through the Texture class, on a worker
+    auto texture = std::make_shared<DecodedTexture>();
+    asset_streamer_->Enqueue([texture, texture_path]() {
+        texture->decoded = std::make_unique<Texture>(Texture3u(texture_path));
+        if (texture->decoded->width() == 0 || texture->decoded->height() == 0) {
+            std::cout << "ERROR: Failed to load skybox texture from: " << texture_path << std::endl;
+            return;
+        }
 
-    if (texture.width() == 0 || texture.height() == 0) {
-        std::cout << "ERROR: Failed to load skybox texture from: " << texture_path << std::endl;
-        return;
+        std::cout << "Loading skybox texture: " << texture_path << std::endl;
+        std::cout << "  Dimensions: " << texture->decoded->width() << "x" << texture->decoded->height() << std::endl;
+
+        // FreeImage loads as BGR, OpenGL expects RGB - use GL_BGR
+        AssetStreamer::TextureUpload& upload = texture->upload;
+        upload.rgb = static_cast<const uint8_t*>(texture->decoded->data());
+        upload.width = texture->decoded->width();
+        upload.height = texture->decoded->height();
+        upload.source_format = GL_BGR;
+        upload.wrap = GL_CLAMP_TO_EDGE;
+    },
+    [this, texture]() {
+        if (!asset_streamer_->Upload(texture->upload)) {
+            return false;
+        }
+        if (texture->upload.texture == 0) {
+            return true;  // Decoding failed, the shader has a fallback
+        }
+        skybox_texture_ = texture->upload.texture;
+
+        // Create bindless handle
+        skybox_texture_handle_ = glGetTextureHandleARB(skybox_texture_);
+        if (skybox_texture_handle_ != 0) {
+            glMakeTextureHandleResidentARB(skybox_texture_handle_);
+            std::cout << "Skybox texture loaded successfully, handle: " << skybox_texture_handle_ << std::endl;
+        } else {
+            std::cout << "ERROR: Failed to create skybox texture handle!" << std::endl;
+        }
+        return true;
+    });
+    if (!streaming_) {
+        asset_streamer_->Flush();
     }
+}
 
-    std::cout << "Loading skybox texture: " << texture_path << std::endl;
-    std::cout << "  Dimensions: " << texture.width() << "x" << texture.height() << std::endl;
-
-    // Create OpenGL texture directly for skybox (with BGR->RGB swap)
-    glGenTextures(1, &skybox_texture_);
-    glBindTexture(GL_TEXTURE_2D, skybox_texture_);
+int Rasteriser::LoadParticleProgram(const std::string& vs_file_name, const std::string& fs_file_name)
+{
+    if (particle_program_.Load(vs_file_name, fs_file_name) != S_OK) {
+        return EXIT_FAILURE;
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    std::cout << "Particle shader program loaded: " << particle_program_.id() << std::endl;
+    return 0;
+}
 
-    // FreeImage loads as BGR, OpenGL expects RGB - use GL_BGR
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, texture.width(), texture.height(),
-                 0, GL_BGR, GL_UNSIGNED_BYTE, texture.data());
-    glGenerateMipmap(GL_TEXTURE_2D);
+void Rasteriser::InitParticles(const size_t capacity)
+{
+    if (particles_.Init(capacity) != S_OK) {
+        std::cout << "WARNING: GPU particles unavailable, emitters are ignored" << std::endl;
+    }
+}
 
-    // Create bindless handle
-    skybox_texture_handle_ = glGetTextureHandleARB(skybox_texture_);
-    if (skybox_texture_handle_ != 0) {
-        glMakeTextureHandleResidentARB(skybox_texture_handle_);
-        std::cout << "Skybox texture loaded successfully, handle: " << skybox_texture_handle_ << std::endl;
-    } else {
-        std::cout << "ERROR: Failed to create skybox texture handle!" << std::endl;
+void Rasteriser::InitOcclusionCulling()
+{
+    if (occlusion_.Init() != S_OK) {
+        std::cout << "WARNING: Occlusion culling unavailable" << std::endl;
+        return;
     }
+    SetOcclusionCulling(true);
+}
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+void Rasteriser::SetOcclusionCulling(const bool enabled)
+{
+    occlusion_culling_ = enabled && occlusion_.valid();
+    occlusion_.InvalidatePyramid();  // Depth of a frame drawn without the pyramid may be stale
+    std::cout << "Occlusion culling: " << (occlusion_culling_ ? "on" : "off") << std::endl;
 }
 
-int Rasteriser::LoadRainProgram(const std::string& vs_file_name, const std::string& fs_file_name)
+void Rasteriser::SetLevelOfDetail(const bool enabled, const float max_pixel_error)
 {
-    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    std::vector<char> shader_source;
-    if (LoadShader(vs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(vertex_shader, 1, &tmp, nullptr);
-        glCompileShader(vertex_shader);
+    lod_enabled_ = enabled;
+    lod_pixel_error_ = std::max(max_pixel_error, 0.0f);
+    std::cout << "Levels of detail: " << (lod_enabled_ ? "on" : "off") << ", max error " << lod_pixel_error_ << " px" << std::endl;
+}
+
+void Rasteriser::SetTextureCompression(const bool enabled)
+{
+    texture_compression_ = enabled;
+    std::cout << "Texture compression: " << (enabled ? "on" : "off") << std::endl;
+}
+
+void Rasteriser::SetStreaming(const bool enabled)
+{
+    streaming_ = enabled;
+    if (!streaming_) {
+        asset_streamer_->Flush();
     }
-    CheckShader(vertex_shader);
+    std::cout << "Asset streaming: " << (enabled ? "on" : "off") << std::endl;
+}
 
-    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    if (LoadShader(fs_file_name, shader_source) == S_OK)
-    {
-        const char* tmp = static_cast<const char*>(&shader_source[0]);
-        glShaderSource(fragment_shader, 1, &tmp, nullptr);
-        glCompileShader(fragment_shader);
+void Rasteriser::SetCompactVertices(const bool enabled)
+{
+    const auto format = enabled ? GeometryPool::VertexFormat::COMPACT : GeometryPool::VertexFormat::FLOAT;
+    if (format == geometry_pool_->format()) {
+        return;
+    }
+    // The vertex layout is fixed per pool, meshes already in it would have to be reloaded
+    if (geometry_pool_->vertex_count() > 0) {
+        std::cout << "WARNING: Vertex format can't change after meshes were loaded" << std::endl;
+        return;
     }
-    CheckShader(fragment_shader);
+    geometry_pool_ = std::make_unique<GeometryPool>(size_t(1) << 18, size_t(1) << 20, format);
+    std::cout << "Vertex format: " << (enabled ? "compact (" : "float (") << geometry_pool_->vertex_size() << " B per vertex)" << std::endl;
+}
 
-    GLuint shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-    rain_shader_program_ = shader_program;
+int Rasteriser::BuildFrameGraph()
+{
+    // Resources - the static shadow map persists across frames, the dynamic one is rebuilt every frame
+    const FrameGraph::Resource backbuffer = frame_graph_.Backbuffer();
+    const FrameGraph::Resource particle_state = frame_graph_.ImportBuffer("Particle state");
+    const FrameGraph::Resource visible_draws = frame_graph_.ImportBuffer("Visible draws");
+    const FrameGraph::Resource static_shadow_map = frame_graph_.ImportTexture("Static shadow map",
+        tex_static_shadow_map_, fbo_static_shadow_map_, shadow_width_, shadow_height_);
+    FrameGraph::Resource shadow_map = -1;
+
+    frame_graph_.AddPass("Particle simulation",
+        [&](FrameGraph::PassBuilder& builder) { builder.Write(particle_state); },
+        [this](const FrameGraph&) { particles_.Update(registry_, frame_.camera_pos, frame_.delta_time); },
+        [this]() { return particles_.valid(); });
+
+    if (shadow_program_.valid() && tex_static_shadow_map_ != 0) {
+        FrameGraph::TextureDesc shadow_desc;
+        shadow_desc.width = shadow_width_;
+        shadow_desc.height = shadow_height_;
+        shadow_desc.layers = cascades_.count();
+        shadow_desc.internal_format = GL_DEPTH_COMPONENT32F;
+        shadow_desc.wrap = GL_CLAMP_TO_BORDER;
+        shadow_desc.border_color = glm::vec4(1.0f);  // Areas outside the light's frustum will be lit
+        shadow_map = frame_graph_.CreateTexture("Shadow map", shadow_desc);
+
+        // Only cascades whose light matrix was refitted are redrawn, skipped while no static caster changed and
+        // the camera stays within every cascade's margin - the cached layers stay valid
+        frame_graph_.AddPass("Static shadows",
+            [&](FrameGraph::PassBuilder& builder) { builder.Write(static_shadow_map); },
+            [this](const FrameGraph&) {
+                DrawShadowCasters(static_shadow_draws_, fbo_static_shadow_map_, tex_static_shadow_map_, frame_.refresh_static_cascades, true);
+                for (int c = 0; c < cascades_.count(); ++c) {
+                    cached_light_space_matrices_[c] = cascades_.cascade(c).light_space_matrix;
+                }
+                static_shadow_dirty_ = false;
+            },
+            [this]() { return frame_.refresh_static_cascades != 0; });
+
+        // Dynamic casters on top of a copy of the static layer, only in cascades that have any - the main pass
+        // samples the others from the static map
+        frame_graph_.AddPass("Dynamic shadows",
+            [&](FrameGraph::PassBuilder& builder) {
+                builder.Read(static_shadow_map);
+                builder.Write(shadow_map);
+            },
+            [this, shadow_map](const FrameGraph& graph) {
+                unsigned dynamic_cascades = 0;
+                for (int c = 0; c < cascades_.count(); ++c) {
+                    if (dynamic_shadow_draws_[c].count == 0) {
+                        continue;
+                    }
+                    glCopyImageSubData(tex_static_shadow_map_, GL_TEXTURE_2D_ARRAY, 0, 0, 0, c,
+                        graph.texture(shadow_map), GL_TEXTURE_2D_ARRAY, 0, 0, 0, c, shadow_width_, shadow_height_, 1);
+                    dynamic_cascades |= 1u << c;
+                }
+                DrawShadowCasters(dynamic_shadow_draws_, graph.framebuffer(shadow_map), graph.texture(shadow_map), dynamic_cascades, false);
+                frame_.shadow_texture = graph.texture(shadow_map);
+                frame_.dynamic_cascades = dynamic_cascades;
+            },
+            [this]() {
+                for (int c = 0; c < cascades_.count(); ++c) {
+                    if (dynamic_shadow_draws_[c].count > 0) {
+                        return true;
+                    }
+                }
+                return false;
+            });
+    }
 
-    std::cout << "Rain shader program loaded: " << rain_shader_program_ << std::endl;
-    return 0;
+    // Opaque draws hidden behind last frame's depth are zeroed before the pre-pass and main pass read them
+    frame_graph_.AddPass("Occlusion culling",
+        [&](FrameGraph::PassBuilder& builder) { builder.Write(visible_draws); },
+        [this](const FrameGraph&) {
+            occlusion_.Cull(draw_buffers_.buffer, draw_buffers_.commands_offset, draw_buffers_.buffer, draw_buffers_.bounds_offset,
+                GLuint(main_draws_.first), main_draws_.count);
+        },
+        [this]() { return occlusion_culling_ && occlusion_.has_pyramid() && main_draws_.count > 0; });
+
+    // Skybox, opaque, grass and particles - one render queue, sorted by key
+    frame_graph_.AddPass("Main",
+        [&](FrameGraph::PassBuilder& builder) {
+            builder.Read(particle_state);
+            builder.Read(visible_draws);
+            builder.Read(static_shadow_map);
+            if (shadow_map != -1) {
+                builder.Read(shadow_map);
+            }
+            builder.Write(backbuffer);
+        },
+        [this](const FrameGraph&) { DrawMainPass(); });
+
+    // Opaque depth the main pass captured, reduced for the next frame's occlusion culling, nothing in the graph reads it
+    frame_graph_.AddPass("Depth pyramid",
+        [&](FrameGraph::PassBuilder& builder) {
+            builder.Read(backbuffer);
+            builder.SideEffect();
+        },
+        [this](const FrameGraph&) { occlusion_.BuildPyramid(); },
+        [this]() { return occlusion_culling_; });
+
+    return frame_graph_.Compile();
 }
 
-void Rasteriser::InitRainParticles()
+void Rasteriser::DrawShadowCasters(const DrawRange* ranges, const GLuint fbo, const GLuint texture, const unsigned cascades, const bool clear)
 {
-    rain_particles_.resize(RAIN_PARTICLE_COUNT);
-
-    // Initialize particles with random positions around the camera
-    for (int i = 0; i < RAIN_PARTICLE_COUNT; ++i) {
-        rain_particles_[i].position = glm::vec3(
-            (rand() % 1000 - 500) / 10.0f,  // -50 to 50
-            (rand() % 1000 - 500) / 10.0f,  // -50 to 50
-            (rand() % 500) / 10.0f + 1.0f   // 1 to 51 (above ground)
-        );
-        rain_particles_[i].life = (rand() % 100) / 100.0f;
-        rain_particles_[i].velocity = glm::vec3(
-            (rand() % 100 - 50) / 500.0f,   // Slight horizontal drift
-            (rand() % 100 - 50) / 500.0f,
-            -14.0f - (rand() % 80) / 10.0f  // Fall speed -8 to -12
-        );
-        rain_particles_[i].padding = 0.0f;
-    }
-
-    // Create VAO and VBO for rain particles
-    glGenVertexArrays(1, &rain_vao_);
-    glGenBuffers(1, &rain_vbo_);
-
-    glBindVertexArray(rain_vao_);
-    glBindBuffer(GL_ARRAY_BUFFER, rain_vbo_);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(RainParticle) * RAIN_PARTICLE_COUNT, rain_particles_.data(), GL_DYNAMIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(RainParticle), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Life attribute
-    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(RainParticle), (void*)offsetof(RainParticle, life));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(0);
-
-    std::cout << "Rain particle system initialized with " << RAIN_PARTICLE_COUNT << " particles" << std::endl;
+    glUseProgram(shadow_program_.id());
+
+    // Disable culling for shadow pass to render all geometry
+    glDisable(GL_CULL_FACE);
+
+    // Use polygon offset to help with shadow acne
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.0f, 4.0f);
+
+    for (int c = 0; c < cascades_.count(); ++c) {
+        if (!(cascades & (1u << c)) || (!clear && ranges[c].count == 0)) {
+            continue;
+        }
+        glNamedFramebufferTextureLayer(fbo, GL_DEPTH_ATTACHMENT, texture, 0, c);
+        if (clear) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+        shadow_cascade_uniform_.Set(c);
+        DrawOpaque(ranges[c]);
+    }
+
+    // Restore state
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glEnable(GL_CULL_FACE);
 }
 
-void Rasteriser::UpdateRainParticles(float delta_time, const glm::vec3& camera_pos)
+void Rasteriser::DrawMainPass()
 {
-    for (int i = 0; i < RAIN_PARTICLE_COUNT; ++i) {
-        // Update position
-        rain_particles_[i].position += rain_particles_[i].velocity * delta_time;
-
-        // Update life - moderate decay
-        rain_particles_[i].life -= delta_time * 0.5f;
-
-        // Respawn dead or out-of-bounds particles near camera
-        if (rain_particles_[i].life <= 0.0f || rain_particles_[i].position.z < -2.0f) {
-            // Spawn rain in a cylinder around the camera
-            rain_particles_[i].position = camera_pos + glm::vec3(
-                (rand() % 600 - 300) / 10.0f,  // -30 to 30 from camera
-                (rand() % 600 - 300) / 10.0f,
-                20.0f + (rand() % 300) / 10.0f  // 20 to 40 above camera
-            );
-            rain_particles_[i].life = 1.0f;
-            rain_particles_[i].velocity = glm::vec3(
-                (rand() % 100 - 50) / 500.0f,
-                (rand() % 100 - 50) / 500.0f,
-                -14.0f - (rand() % 80) / 10.0f  // Fall speed -14 to -22
-            );
+    glClearColor(0.2f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Bind shadow map with the comparison sampler
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, frame_.shadow_texture);
+    glBindSampler(3, shadow_sampler_);
+    glBindTextureUnit(5, tex_static_shadow_map_);
+    glBindSampler(5, shadow_sampler_);
+    phong_uniforms_.shadow_dynamic_cascades.Set(GLint(frame_.dynamic_cascades));
+
+    // Collect the draws of every section, sort them by key and submit with redundant binds filtered out
+    render_queue_.Clear();
+    const float depth_scale = 1.0f / camera_->GetFar();
+
+    // ===== Opaque objects (non-grass) - one multi-draw per index type =====
+    if (main_draws_.count > 0) {
+        const bool depth_prepass = depth_prepass_ && depth_prepass_program_.valid();
+        const GLsizei long_count = main_draws_.count - main_draws_.short_count;
+        const struct {
+            GLenum index_type;
+            GLuint first;
+            GLsizei count;
+        } ranges[2] = {
+            { GL_UNSIGNED_INT, GLuint(main_draws_.first), long_count },
+            { GL_UNSIGNED_SHORT, GLuint(main_draws_.first + long_count), main_draws_.short_count }
+        };
+
+        for (const auto& range : ranges) {
+            if (range.count == 0) {
+                continue;
+            }
+
+            // Same commands with the minimal vertex path, the phong pass then tests GL_EQUAL against this depth
+            if (depth_prepass) {
+                DrawPacket packet;
+                packet.key = RenderQueue::MakeKey(RenderPass::DEPTH_PREPASS, depth_prepass_program_.id(), draw_buffers_.buffer, geometry_pool_->vao(), 0.0f);
+                packet.kind = DrawPacket::Kind::MULTI_INDIRECT;
+                packet.state = RenderState::DEPTH_ONLY;
+                packet.program = depth_prepass_program_.id();
+                packet.vao = geometry_pool_->vao();
+                packet.first = range.first;
+                packet.count = range.count;
+                packet.index_type = range.index_type;
+                packet.indirect_buffer = draw_buffers_.buffer;
+                packet.indirect_offset = draw_buffers_.commands_offset;
+                packet.ssbo = draw_buffers_.buffer;
+                packet.ssbo_binding = 2;
+                packet.ssbo_offset = draw_buffers_.data_offset;
+                packet.ssbo_size = draw_buffers_.data_size;
+                render_queue_.Push(packet);
+            }
+
+            DrawPacket packet;
+            packet.key = RenderQueue::MakeKey(RenderPass::OPAQUE, phong_program_.id(), draw_buffers_.buffer, geometry_pool_->vao(), 0.0f);
+            packet.kind = DrawPacket::Kind::MULTI_INDIRECT;
+            packet.state = depth_prepass ? RenderState::OPAQUE_EQUAL : RenderState::OPAQUE;
+            packet.program = phong_program_.id();
+            packet.vao = geometry_pool_->vao();
+            packet.first = range.first;
+            packet.count = range.count;
+            packet.index_type = range.index_type;
+            packet.indirect_buffer = draw_buffers_.buffer;
+            packet.indirect_offset = draw_buffers_.commands_offset;
+            packet.ssbo = draw_buffers_.buffer;
+            packet.ssbo_binding = 2;
+            packet.ssbo_offset = draw_buffers_.data_offset;
+            packet.ssbo_size = draw_buffers_.data_size;
+            render_queue_.Push(packet);
+        }
+    }
+
+    // ===== Skybox (environment background) - fullscreen triangle at the far plane =====
+    if (skybox_program_.valid()) {
+        // Set skybox texture handle (0 if no texture - shader has fallback)
+        skybox_uniforms_.skybox_texture.Set(skybox_texture_handle_);
+
+        DrawPacket packet;
+        packet.key = RenderQueue::MakeKey(RenderPass::SKY, skybox_program_.id(), 0, skybox_vao_, 1.0f);
+        packet.kind = DrawPacket::Kind::ARRAYS;
+        packet.state = RenderState::SKY;
+        packet.program = skybox_program_.id();
+        packet.vao = skybox_vao_;
+        packet.count = 3;  // Uses gl_VertexID in shader
+        render_queue_.Push(packet);
+    }
+
+    // ===== Opaque depth for next frame's occlusion culling - first in the sky section, before blended grass writes depth =====
+    if (occlusion_culling_) {
+        DrawPacket packet;
+        packet.key = RenderQueue::MakeKey(RenderPass::SKY, 0, 0, 0, 0.0f);
+        packet.kind = DrawPacket::Kind::CALLBACK;
+        packet.state = RenderState::SKY;
+        packet.execute = [](const void* object) {
+            Rasteriser* rasteriser = static_cast<Rasteriser*>(const_cast<void*>(object));
+            rasteriser->occlusion_.CaptureDepth(rasteriser->frame_.framebuffer_width, rasteriser->frame_.framebuffer_height,
+                rasteriser->frame_.VP);
+        };
+        packet.object = this;
+        render_queue_.Push(packet);
+    }
+
+    // ===== Transparent objects (grass) with blending, visible from both sides =====
+    if (grass_program_.valid()) {
+        // One instanced draw per sub-mesh, instance data from SSBO binding 1
+        auto grass_view = registry_.view<component::Transform, component::Mesh, component::Grass>();
+
+        for (auto [entity, transform, mesh_component] : grass_view.each()) {
+            // A placeholder box per tuft would be worse than no grass until the mesh is resident
+            if (!mesh_component.asset || !mesh_component.asset->resident) {
+                continue;
+            }
+            float depth = glm::length(glm::vec3(transform.world_model_matrix[3]) - frame_.camera_pos) * depth_scale;
+            if (auto* bounds = registry_.try_get<component::Bounds>(entity)) {
+                if (!frame_.camera_frustum.Intersects(bounds->world)) {
+                    continue;
+                }
+                depth = glm::length(bounds->world.center() - frame_.camera_pos) * depth_scale;
+            }
+
+            // Instances are sorted by level of detail, each level is one instanced range
+            GLsizei lod_first[GLMesh::MAX_LODS + 1]{};
+            std::fill(lod_first + mesh_component.lod + 1, lod_first + GLMesh::MAX_LODS + 1, 1);
+            GLuint instance_ssbo = identity_instance_ssbo_;
+            if (auto* instances = registry_.try_get<component::Instances>(entity)) {
+                if (instances->dirty || instances->lods_dirty) {
+                    UploadInstances(*instances);
+                }
+                std::copy(instances->lod_first, instances->lod_first + GLMesh::MAX_LODS + 1, lod_first);
+                instance_ssbo = instances->ssbo;
+            }
+
+            for (const auto& glmesh : mesh_component.gl_meshes) {
+                for (int level = 0; level < GLMesh::MAX_LODS; ++level) {
+                    const GLsizei instance_count = lod_first[level + 1] - lod_first[level];
+                    if (instance_count == 0) {
+                        continue;
+                    }
+                    const int lod = std::min(level, glmesh.lod_count - 1);
+                    DrawPacket packet;
+                    packet.key = RenderQueue::MakeKey(RenderPass::TRANSPARENT, grass_program_.id(), instance_ssbo, glmesh.vao, depth);
+                    packet.kind = DrawPacket::Kind::ELEMENTS_INSTANCED;
+                    packet.state = RenderState::ALPHA_TWO_SIDED;
+                    packet.program = grass_program_.id();
+                    packet.vao = glmesh.vao;
+                    packet.first = glmesh.lod_first_index[lod];
+                    packet.count = glmesh.lod_index_count[lod];
+                    packet.base_vertex = glmesh.base_vertex;
+                    packet.index_type = glmesh.index_type;
+                    packet.instance_count = instance_count;
+                    packet.base_instance = GLuint(lod_first[level]);
+                    packet.ssbo = instance_ssbo;
+                    packet.ssbo_binding = 1;
+                    packet.model_uniform = grass_uniforms_.M;
+                    packet.normal_uniform = grass_uniforms_.Mn;
+                    packet.model = &transform.world_model_matrix;
+                    packet.normal = &transform.normal_matrix;
+                    packet.position_offset_uniform = grass_uniforms_.position_offset;
+                    packet.position_scale_uniform = grass_uniforms_.position_scale;
+                    packet.position_offset = &glmesh.position_offset;
+                    packet.position_scale = &glmesh.position_scale;
+                    packet.material_offset_uniform = grass_uniforms_.material_offset;
+                    packet.material_offset = &glmesh.material_offset;
+                    render_queue_.Push(packet);
+
+                    lod_stats_.triangles += size_t(packet.count / 3) * instance_count;
+                    lod_stats_.full_detail_triangles += size_t(glmesh.index_count / 3) * instance_count;
+                }
+            }
         }
     }
 
-    // Update VBO
-    glBindBuffer(GL_ARRAY_BUFFER, rain_vbo_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(RainParticle) * RAIN_PARTICLE_COUNT, rain_particles_.data());
+    // ===== Particles - drawn straight from the simulation buffers =====
+    if (particle_program_.valid() && particles_.valid()) {
+        DrawPacket packet;
+        packet.key = RenderQueue::MakeKey(RenderPass::EFFECTS, particle_program_.id(), 0, 0, 0.0f);
+        packet.kind = DrawPacket::Kind::CALLBACK;
+        packet.state = RenderState::ALPHA_POINTS;
+        packet.program = particle_program_.id();
+        packet.execute = [](const void* particles) { static_cast<const GPUParticleSystem*>(particles)->Draw(); };
+        packet.object = &particles_;
+        render_queue_.Push(packet);
+    }
+
+    render_queue_.Sort();
+    render_queue_.Submit();
 }
 
 //int Rasteriser::Show() {
@@ -790,43 +1807,6 @@ void Rasteriser::UpdateRainParticles(float delta_time, const glm::vec3& camera_p
 //    return EXIT_SUCCESS;
 //}
 
-void Rasteriser::CreateBindlessTexture(GLuint& texture, GLuint64& handle, const int width, const int height, const GLvoid* data, int linear)
-{
-    if (!data) {
-        std::cout << "ERROR: Texture data is null!" << std::endl;
-        handle = 0;
-        return;
-    }
-
-    if (width <= 0 || height <= 0) {
-        std::cout << "ERROR: Invalid texture dimensions: " << width << "x" << height << std::endl;
-        handle = 0;
-        return;
-    }
-
-    
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture); // bind empty texture object to the target
-    // set the texture wrapping/filtering options
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // copy data from the host buffer
-    glTexImage2D(GL_TEXTURE_2D, 0,(linear) ? GL_RGB8 : GL_SRGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0); // unbind the newly created texture from the target
-    handle = glGetTextureHandleARB(texture);
-    if (handle == 0) {
-        std::cout << "ERROR: Failed to create texture handle!" << std::endl;
-    }
-    else {
-        glMakeTextureHandleResidentARB(handle);
-        std::cout << "Successfully created texture handle: " << handle << std::endl;
-    }// produces a handle representing the texture in a shader function
-    glMakeTextureHandleResidentARB(handle);
-}
-
 int Rasteriser::Show() {
     glEnable(GL_DEPTH_TEST);
     auto entity_view = registry_.view<component::Transform, component::Mesh>();
@@ -876,32 +1856,50 @@ int Rasteriser::Show() {
         std::cout << "=========================\n" << std::endl;
         printed = true;
     }
-    // Light position and shadow mapping setup
+    // Light position and shadow mapping setup - sun-like directional light from above
     glm::vec3 light_ws(30.0f, -30.0f, 60.0f);  // High above and to the side
+    glm::vec3 light_color(1.8f, 1.8f, 1.7f);  // Bright warm sunlight
+    glm::vec3 ambient(0.25f, 0.25f, 0.3f);  // Reduced ambient for visible shadows
     glm::vec3 light_target(0.0f, 0.0f, 0.0f);  // Light looks at scene center
-    glm::vec3 light_up(0.0f, 0.0f, 1.0f);
 
-    // Light's view matrix (looking from light toward scene)
-    glm::mat4 V_light = glm::lookAt(light_ws, light_target, light_up);
+    // Shadows of the directional light come from cascades fitted to the camera each frame
+    const glm::vec3 light_direction = glm::normalize(light_target - light_ws);
 
-    // Orthographic projection for directional light shadow
-    float shadow_size = 40.0f;  // Size of the shadow frustum
-    glm::mat4 P_light = glm::ortho(-shadow_size, shadow_size, -shadow_size, shadow_size, 1.0f, 150.0f);
-
-    // Combined light-space projection matrix (P_light * V_light)
-    glm::mat4 light_space_matrix = P_light * V_light;
-
-    // Bind shadow map texture to texture unit 3 before entering the loop
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, tex_shadow_map_);
-    SetSampler(default_shader_program_, 3, "shadow_map");
+    if (BuildFrameGraph() != S_OK) {
+        return EXIT_FAILURE;
+    }
 
     while (!glfwWindowShouldClose(_window))
     {
+        // New shadow resolution - both maps change size, so the graph is rebuilt around the new static target
+        if (pending_shadow_resolution_ != 0 && tex_static_shadow_map_ != 0) {
+            glFinish();  // Passes of the previous frames may still use the old textures
+            InitShadowDepthbuffer(pending_shadow_resolution_, cascades_.count());
+            frame_graph_.Reset();
+            if (BuildFrameGraph() != S_OK) {
+                return EXIT_FAILURE;
+            }
+        }
+        pending_shadow_resolution_ = 0;
+
         static int frame = 0;
         if (frame++ % 60 == 0) {  // Print every 60 frames
             glm::vec3 pos = camera_->GetPosition();
             std::cout << "Camera: (" << pos.x << ", " << pos.y << ", " << pos.z << ")" << std::endl;
+            const RenderQueue::Stats& queue_stats = render_queue_.stats();
+            std::cout << "Render queue: " << queue_stats.packets << " packets, " << queue_stats.state_changes
+                << " state changes (" << queue_stats.program_binds << " programs, " << queue_stats.vao_binds << " VAOs), "
+                << queue_stats.state_changes_saved << " saved" << std::endl;
+            if (occlusion_culling_) {
+                const OcclusionCuller::Stats& occlusion_stats = occlusion_.stats();
+                std::cout << "Occlusion culling: " << occlusion_stats.occluded << " of " << occlusion_stats.tested << " draws culled ("
+                    << occlusion_stats.occluded_triangles << " triangles)" << std::endl;
+            }
+            if (lod_enabled_) {
+                std::cout << "Levels of detail: " << lod_stats_.triangles << " of " << lod_stats_.full_detail_triangles
+                    << " triangles drawn" << std::endl;
+            }
+            frame_graph_.PrintTimings();
         }
         // Calculate delta time
         float current_time = glfwGetTime();
@@ -912,6 +1910,9 @@ int Rasteriser::Show() {
         if (delta_time <= 0.0f || delta_time > 0.1f) {
             delta_time = 0.016f;  // Default to ~60 FPS
         }
+        // Uploads of assets decoded in the background, a few milliseconds per frame
+        asset_streamer_->Update(STREAMING_BUDGET_MS);
+
         // Update physics
         PhysicsManager::Instance().Update(delta_time);
 
@@ -920,203 +1921,90 @@ int Rasteriser::Show() {
             player_->Update(delta_time);
         }
 
-        // ===== SHADOW PASS: Render scene from light's perspective =====
-        if (shadow_program_ != 0) {
-            glUseProgram(shadow_program_);
-            glViewport(0, 0, shadow_width_, shadow_height_);
-            glBindFramebuffer(GL_FRAMEBUFFER, fbo_shadow_map_);
-            glClear(GL_DEPTH_BUFFER_BIT);
-
-            // Disable culling for shadow pass to render all geometry
-            glDisable(GL_CULL_FACE);
-
-            // Use polygon offset to help with shadow acne
-            glEnable(GL_POLYGON_OFFSET_FILL);
-            glPolygonOffset(2.0f, 4.0f);
-
-            // Render all opaque objects to shadow map
-            auto shadow_view = registry_.view<component::Transform, component::Mesh>(entt::exclude<component::Grass>);
-            for (auto [entity, transform, mesh_component] : shadow_view.each()) {
-                glm::mat4 M = transform.get_world_matrix(registry_, entity);
-                glm::mat4 mlp = light_space_matrix * M;  // Model-Light-Projection
-
-                SetMatrix4x4(shadow_program_, glm::value_ptr(mlp), "mlp");
-
-                for (const auto& glmesh : mesh_component.gl_meshes) {
-                    glBindVertexArray(glmesh.vao);
-                    glDrawElements(GL_TRIANGLES, glmesh.mesh->index_buffer_count(), GL_UNSIGNED_INT, 0);
-                }
-            }
-
-            // Restore state
-            glDisable(GL_POLYGON_OFFSET_FILL);
-            glEnable(GL_CULL_FACE);
-
-            // Reset to default framebuffer and viewport
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glViewport(0, 0, width_, height_);
-        }
-
-        // ===== MAIN PASS: Render scene with shadows =====
-        glClearColor(0.2f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
         // Get matrices from camera (now controlled by player)
         glm::mat4 V = camera_->GetViewMatrix();
         glm::mat4 P = camera_->GetProjectionMatrix();
         glm::vec3 camera_pos = camera_->GetPosition();
 
-        // ===== PASS 0: Render skybox (environment background) =====
-        if (skybox_shader_program_ != 0) {
-            // Disable depth writing (skybox is always at infinity)
-            glDepthMask(GL_FALSE);
-            glDepthFunc(GL_LEQUAL);  // Render at far plane
-            glDisable(GL_CULL_FACE);
-
-            glUseProgram(skybox_shader_program_);
-
-            // Calculate inverse VP matrix for ray direction computation
-            glm::mat4 VP = P * V;
-            glm::mat4 inv_VP = glm::inverse(VP);
-            SetMatrix4x4(skybox_shader_program_, glm::value_ptr(inv_VP), "inv_VP");
-
-            // Set skybox texture handle (0 if no texture - shader has fallback)
-            GLint loc = glGetUniformLocation(skybox_shader_program_, "skybox_texture");
-            if (loc != -1) {
-                glUniform2ui(loc,
-                    static_cast<GLuint>(skybox_texture_handle_ & 0xFFFFFFFF),
-                    static_cast<GLuint>(skybox_texture_handle_ >> 32));
+        int framebuffer_width = width_;
+        int framebuffer_height = height_;
+        glfwGetFramebufferSize(_window, &framebuffer_width, &framebuffer_height);
+
+        // Camera, light and time for all programs - one upload per frame
+        FrameConstants constants{};
+        constants.V = V;
+        constants.P = P;
+        constants.VP = P * V;
+        constants.inv_VP = glm::inverse(constants.VP);
+        constants.light_ws = glm::vec4(light_ws, 1.0f);
+        constants.light_color = glm::vec4(light_color, 1.0f);
+        constants.ambient_color = glm::vec4(ambient, 1.0f);
+        constants.camera_pos_ws = glm::vec4(camera_pos, 1.0f);
+        constants.time = current_time;
+        constants.delta_time = delta_time;
+
+        // Propagate changed transforms and refit their world bounds
+        transform_system_->Update();
+        UpdateBounds();
+
+        // Levels of detail by projected size, before the static shadow cache is checked
+        frame_.camera_pos = camera_pos;
+        frame_.lod_scale = 0.5f * float(framebuffer_height) * P[1][1];
+        SelectLods();
+
+        // Depth of the cascades reaches the static casters only, moving ones can't force a refit
+        if (static_shadow_dirty_) {
+            static_bounds_ = AABB();
+            auto bounds_view = registry_.view<component::Bounds>(entt::exclude<component::Dynamic>);
+            for (auto [entity, bounds] : bounds_view.each()) {
+                if (bounds.world.valid()) {
+                    static_bounds_.extend(bounds.world);
+                }
             }
-
-            // Draw fullscreen triangle (uses gl_VertexID in shader)
-            glBindVertexArray(skybox_vao_);
-            glDrawArrays(GL_TRIANGLES, 0, 3);
-
-            // Restore state
-            glDepthFunc(GL_LESS);
-            glDepthMask(GL_TRUE);
-            glEnable(GL_CULL_FACE);
         }
 
-        glUseProgram(default_shader_program_);
-
-        // Set lighting uniforms - sun-like directional light from above
-        glm::vec3 light_ws(30.0f, -30.0f, 60.0f);  // High above and to the side
-        SetVector3(default_shader_program_, glm::value_ptr(light_ws), "light_ws");
-
-        glm::vec3 light_color(1.8f, 1.8f, 1.7f);  // Bright warm sunlight
-        SetVector3(default_shader_program_, glm::value_ptr(light_color), "light_color");
-
-        glm::vec3 ambient(0.25f, 0.25f, 0.3f);  // Reduced ambient for visible shadows
-        SetVector3(default_shader_program_, glm::value_ptr(ambient), "ambient_color");
-
-        // Set camera uniforms
-        SetMatrix4x4(default_shader_program_, glm::value_ptr(V), "V");
-        SetMatrix4x4(default_shader_program_, glm::value_ptr(P), "P");
-        SetVector3(default_shader_program_, glm::value_ptr(camera_pos), "camera_pos_ws");
-
-        // Set light space matrix for shadow mapping
-        SetMatrix4x4(default_shader_program_, glm::value_ptr(light_space_matrix), "light_space_matrix");
-
-        // Bind shadow map
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, tex_shadow_map_);
-
-        // ===== Render opaque objects (non-grass) =====
-        auto opaque_view = registry_.view<component::Transform, component::Mesh>(entt::exclude<component::Grass>);
-        for (auto [entity, transform, mesh_component] : opaque_view.each()) {
-            glm::mat4 M = transform.get_world_matrix(registry_, entity);
-            glm::mat3 Mn = glm::transpose(glm::inverse(glm::mat3(M)));
-
-            SetMatrix4x4(default_shader_program_, glm::value_ptr(M), "M");
-            SetMatrix3x3(default_shader_program_, glm::value_ptr(Mn), "Mn");
-
-            for (const auto& glmesh : mesh_component.gl_meshes) {
-                glBindVertexArray(glmesh.vao);
-                glDrawElements(GL_TRIANGLES, glmesh.mesh->index_buffer_count(), GL_UNSIGNED_INT, 0);
+        // Fit the cascades to the camera, a static layer is redrawn once the camera leaves its margin and its
+        // light matrix moves
+        cascades_.Update(V, P, camera_->GetNear(), camera_->GetFar(), light_direction, static_bounds_, shadow_width_,
+            static_shadow_dirty_);
+        Frustum cascade_frusta[CascadedShadows::MAX_CASCADES];
+        unsigned refresh_static_cascades = 0;
+        for (int c = 0; c < cascades_.count(); ++c) {
+            const CascadedShadows::Cascade& cascade = cascades_.cascade(c);
+            constants.light_space_matrices[c] = cascade.light_space_matrix;
+            constants.cascade_splits[c] = cascade.split_far;
+            constants.cascade_texel_sizes[c] = cascade.texel_size;
+            cascade_frusta[c] = Frustum(cascade.light_space_matrix);
+            if (static_shadow_dirty_ || cascade.light_space_matrix != cached_light_space_matrices_[c]) {
+                refresh_static_cascades |= 1u << c;
             }
         }
-
-        // ===== Render transparent objects (grass) with blending =====
-        if (grass_shader_program_ != 0) {
-            // Enable alpha blending
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-            // Disable face culling for grass (visible from both sides)
-            glDisable(GL_CULL_FACE);
-
-            // Use grass shader
-            glUseProgram(grass_shader_program_);
-
-            // Set uniforms for grass shader
-            SetMatrix4x4(grass_shader_program_, glm::value_ptr(V), "V");
-            SetMatrix4x4(grass_shader_program_, glm::value_ptr(P), "P");
-            SetVector3(grass_shader_program_, glm::value_ptr(light_ws), "light_ws");
-            SetVector3(grass_shader_program_, glm::value_ptr(light_color), "light_color");
-            SetVector3(grass_shader_program_, glm::value_ptr(ambient), "ambient_color");
-            SetVector3(grass_shader_program_, glm::value_ptr(camera_pos), "camera_pos_ws");
-
-            // Set time uniform for wind animation
-            SetFloat(grass_shader_program_, current_time, "time");
-
-            // Set shadow uniforms for grass
-            SetMatrix4x4(grass_shader_program_, glm::value_ptr(light_space_matrix), "light_space_matrix");
-            SetSampler(grass_shader_program_, 3, "shadow_map");
-
-            // Render grass entities
-            auto grass_view = registry_.view<component::Transform, component::Mesh, component::Grass>();
-
-            for (auto [entity, transform, mesh_component] : grass_view.each()) {
-                glm::mat4 M = transform.get_world_matrix(registry_, entity);
-                glm::mat3 Mn = glm::transpose(glm::inverse(glm::mat3(M)));
-
-                SetMatrix4x4(grass_shader_program_, glm::value_ptr(M), "M");
-                SetMatrix3x3(grass_shader_program_, glm::value_ptr(Mn), "Mn");
-
-                for (const auto& glmesh : mesh_component.gl_meshes) {
-                    glBindVertexArray(glmesh.vao);
-                    glDrawElements(GL_TRIANGLES, glmesh.mesh->index_buffer_count(), GL_UNSIGNED_INT, 0);
-                }
-            }
-
-            // Restore state
-            glDisable(GL_BLEND);
-            glEnable(GL_CULL_FACE);
+        constants.cascade_count = cascades_.count();
+        frame_constants_.Update(constants);
+        if (!shadow_program_.valid()) {
+            refresh_static_cascades = 0;
         }
 
-        // ===== Render rain particles =====
-        if (rain_shader_program_ != 0 && rain_vao_ != 0) {
-            // Update rain particles
-            UpdateRainParticles(delta_time, camera_pos);
-
-            // Enable blending for transparent rain
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-            // Disable depth writing but keep depth testing
-            glDepthMask(GL_FALSE);
-
-            // Enable point sprites
-            glEnable(GL_PROGRAM_POINT_SIZE);
-
-            glUseProgram(rain_shader_program_);
-
-            // Set uniforms
-            glm::mat4 VP = P * V;
-            SetMatrix4x4(rain_shader_program_, glm::value_ptr(VP), "VP");
-            SetVector3(rain_shader_program_, glm::value_ptr(camera_pos), "camera_pos");
-            SetFloat(rain_shader_program_, current_time, "time");
-
-            // Draw rain particles as points
-            glBindVertexArray(rain_vao_);
-            glDrawArrays(GL_POINTS, 0, RAIN_PARTICLE_COUNT);
-
-            // Restore state
-            glDisable(GL_PROGRAM_POINT_SIZE);
-            glDepthMask(GL_TRUE);
-            glDisable(GL_BLEND);
-        }
+        // Cull against the cascades and the camera frustum
+        const Frustum camera_frustum(constants.VP);
+        BuildOpaqueDraws(camera_frustum, cascade_frusta, refresh_static_cascades);
+
+        // Inputs of this frame's passes
+        frame_.camera_frustum = camera_frustum;
+        frame_.VP = constants.VP;
+        frame_.camera_pos = camera_pos;
+        frame_.delta_time = delta_time;
+        frame_.refresh_static_cascades = refresh_static_cascades;
+        frame_.shadow_texture = tex_static_shadow_map_;
+        frame_.dynamic_cascades = 0;
+        frame_.framebuffer_width = framebuffer_width;
+        frame_.framebuffer_height = framebuffer_height;
+        frame_graph_.SetBackbufferSize(framebuffer_width, framebuffer_height);
+        frame_graph_.Execute();
+
+        frame_constants_.EndFrame();
+        draw_stream_.EndFrame();
+        particles_.EndFrame();
 
         glfwSwapBuffers(_window);
         glfwPollEvents();
@@ -1139,6 +2027,30 @@ void Rasteriser::key_callback(GLFWwindow* window, int key, int scancode, int act
         rast->ProcessCameraInput(key, action);
     }
 
+    // 1/2/3 select the shadow quality tier, 9/0 halve/double the shadow map resolution
+    if (rast && action == GLFW_PRESS) {
+        switch (key) {
+            case GLFW_KEY_1: rast->SetShadowQuality(ShadowQuality::LOW, rast->shadow_taps_); break;
+            case GLFW_KEY_2: rast->SetShadowQuality(ShadowQuality::MEDIUM, rast->shadow_taps_); break;
+            case GLFW_KEY_3: rast->SetShadowQuality(ShadowQuality::HIGH, rast->shadow_taps_); break;
+            case GLFW_KEY_9: rast->SetShadowResolution(rast->shadow_width_ / 2); break;
+            case GLFW_KEY_0: rast->SetShadowResolution(rast->shadow_width_ * 2); break;
+        }
+    }
+
+    // P toggles the depth pre-pass, compare the "Main" pass timings with it on and off
+    if (rast && key == GLFW_KEY_P && action == GLFW_PRESS) {
+        rast->SetDepthPrepass(!rast->depth_prepass_);
+    }
+    // O toggles occlusion culling
+    if (rast && key == GLFW_KEY_O && action == GLFW_PRESS) {
+        rast->SetOcclusionCulling(!rast->occlusion_culling_);
+    }
+    // L toggles levels of detail
+    if (rast && key == GLFW_KEY_L && action == GLFW_PRESS) {
+        rast->SetLevelOfDetail(!rast->lod_enabled_, rast->lod_pixel_error_);
+    }
+
     // ESC to close window
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
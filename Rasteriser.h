@@ -6,7 +6,21 @@
 #include "Camera.h"
 #include "player.h"
 #include "collider.h"
+#include "texturecache.h"
+#include "shaderprogram.h"
+#include "frameconstants.h"
+#include "bvh.h"
+#include "transformsystem.h"
+#include "gpuparticles.h"
+#include "renderqueue.h"
+#include "framegraph.h"
+#include "cascadedshadows.h"
+#include "occlusionculler.h"
+#include "texturecompress.h"
+#include "threadpool.h"
+#include "assetstreamer.h"
 #include <vector>
+#include <unordered_map>
 
 
 class Rasteriser
@@ -17,59 +31,272 @@ public:
     void AddCollisionFromOBJ(const std::string& obj_path, const glm::vec3& position = glm::vec3(0.0f));
 
     int InitOpenGLContext();
-    int LoadMesh(const std::string& s, std::vector<GLMesh> & gl_meshes);
-    void CreateBindlessTexture(GLuint& texture, GLuint64& handle, const int width, const int height, const GLvoid* data, int linear);
 
     entt::registry& GetRegistry() { return registry_; }  // Add this
     // In Rasteriser.h
     entt::entity CreateEntity(const std::string& mesh_file, const std::string& name, entt::entity parent = entt::null);
+    // One entity drawing the mesh once per transform (e.g. a whole grass field)
+    entt::entity CreateInstancedEntity(const std::string& mesh_file, const std::string& name, const std::vector<glm::mat4>& transforms);
     int Show();
     int LoadProgram(const std::string& vs_file_name, const std::string& fs_file_name);
     int LoadGrassProgram(const std::string& vs_file_name, const std::string& fs_file_name);
     int LoadSkyboxProgram(const std::string& vs_file_name, const std::string& fs_file_name);
-    int LoadRainProgram(const std::string& vs_file_name, const std::string& fs_file_name);
+    int LoadParticleProgram(const std::string& vs_file_name, const std::string& fs_file_name);
     int LoadShadowProgram(const std::string& vs_file_name, const std::string& fs_file_name);
+    int LoadDepthPrepassProgram(const std::string& vs_file_name, const std::string& fs_file_name);
+    // Opaque geometry lays down depth first, the phong pass then shades only the visible fragment per pixel
+    void SetDepthPrepass(const bool enabled);
     void LoadSkyboxTexture(const std::string& texture_path);
-    void InitShadowDepthbuffer();
-    void InitRainParticles();
+    // Filtering tiers of shadow_filter.glsl, trading shadow quality for frame time
+    enum class ShadowQuality { LOW, MEDIUM, HIGH };
+    void SetShadowQuality(const ShadowQuality quality, const int poisson_taps = 16);
+    // (Re)creates the static shadow map array, one resolution x resolution layer per cascade
+    void InitShadowDepthbuffer(const int resolution = 1024, const int cascades = 3);
+    // Applied before the next frame, the shadow maps and the frame graph are rebuilt at the new size
+    void SetShadowResolution(const int resolution);
+    // Shared pool of all ParticleEmitter entities
+    void InitParticles(const size_t capacity = size_t(1) << 20);
+    // Hierarchical-Z culling of the opaque draws against last frame's depth, toggled with O
+    void InitOcclusionCulling();
+    void SetOcclusionCulling(const bool enabled);
+    // Meshes and grass instances draw the coarsest level of detail whose error stays under max_pixel_error, toggled with L
+    void SetLevelOfDetail(const bool enabled, const float max_pixel_error = 1.0f);
+    // Quantised 20 byte vertices and 16-bit indices (GeometryPool::VertexFormat::COMPACT), only before the first mesh loads
+    void SetCompactVertices(const bool enabled);
+    // Material maps as BC1/BC5 with precomputed mips, encoded once into <image>.ktx2 (texturecompress)
+    void SetTextureCompression(const bool enabled);
+    // Meshes and the skybox decode on worker threads and upload over the first frames, entities show a
+    // placeholder box until then. Off loads each asset completely when it is requested.
+    void SetStreaming(const bool enabled);
 private:
-    std::vector<std::shared_ptr<TriangularMesh>> meshes_;
+    std::unique_ptr<TextureRegistry> texture_registry_;  // Deduplicated bindless textures, must outlive registry_
+    std::unique_ptr<ThreadPool> thread_pool_;  // Load-time work, e.g. texture encoding
+    bool texture_compression_{ true };
+    std::unique_ptr<GeometryPool> geometry_pool_;  // Shared vertex/index buffers of all meshes, must outlive registry_
+    RangeAllocator material_ranges_;  // Slots of materials_ owned by mesh assets, must outlive registry_
+    DynamicBVH bvh_;  // World boxes of all entities with Bounds for frustum culling, must outlive registry_
+    GPUParticleSystem particles_;  // Particle pool and emitter slots, must outlive registry_
     entt::registry registry_;
+    std::unique_ptr<TransformSystem> transform_system_;  // World and normal matrices of the hierarchy
     std::unique_ptr<MeshLoader> _mesh_loader;
+    std::unique_ptr<MeshCache> mesh_cache_;  // Shared GPU meshes keyed by file path
+    std::unique_ptr<AssetStreamer> asset_streamer_;  // Decodes on thread_pool_, commits in Show(), must be destroyed before what its jobs use
+    bool streaming_{ true };
+    static constexpr double STREAMING_BUDGET_MS = 4.0;  // Main thread time per frame for uploads
+    static constexpr GLsizeiptr STREAMING_UPLOAD_BYTES = GLsizeiptr(16) << 20;  // Texture bytes staged per frame
     int width_{ 800 };
     int height_{ 800 };
     GLFWwindow* _window;
     std::unique_ptr<Camera> camera_;
-    GLuint default_shader_program_{ 0 };
-    GLuint grass_shader_program_{ 0 };  // Grass shader with wind animation
-    GLuint skybox_shader_program_{ 0 };  // Skybox/environment shader
+    ShaderProgram phong_program_;
+    ShaderProgram grass_program_;  // Grass shader with wind animation
+    ShaderProgram skybox_program_;  // Skybox/environment shader
     GLuint skybox_vao_{ 0 };  // VAO for fullscreen triangle
     GLuint skybox_texture_{ 0 };  // Skybox texture
     GLuint64 skybox_texture_handle_{ 0 };  // Bindless texture handle
     GLuint materials_ssbo{ 0 };
     std::vector<GLMaterial> materials_;
+    // quantization_min/max bound every sub-mesh of the asset, compact positions are stored relative to them
+    // Returns S_FALSE when the geometry pool has no room left
+    int UploadMesh(const void* vertices, const size_t vertex_buffer_size, const GLsizei vertex_stride,
+        const void* indices, const size_t index_buffer_size, const glm::vec3& quantization_min, const glm::vec3& quantization_max,
+        GLMesh& glmesh);
+    void UploadMaterials();
+
+    // Material map prepared on a worker - read from the .ktx2 cache, encoded, or left RGB8 - and the
+    // registry key it is shared under (empty if there is no map)
+    struct DecodedTexture {
+        std::string key;
+        texturecompress::TextureFile cache;
+        std::vector<uint8_t> storage;      // Levels encoded this run
+        std::unique_ptr<Texture> decoded;  // Image read from the file
+        AssetStreamer::TextureUpload upload;
+    };
+    // CPU side of a mesh file, filled by DecodeMesh on a worker and uploaded by CommitMesh on the main thread
+    struct DecodedMesh {
+        struct SubMesh {
+            const void* vertices{ nullptr };  // Into vertex_buffers or the mapped cache
+            size_t vertex_size{ 0 };
+            const void* indices{ nullptr };   // All levels of detail
+            size_t index_size{ 0 };
+            uint32_t lod_count{ 1 };
+            uint32_t lod_index_count[GLMesh::MAX_LODS]{};
+            float lod_error[GLMesh::MAX_LODS]{};
+            glm::vec3 bounds_min{ 0.0f };
+            glm::vec3 bounds_max{ 0.0f };
+            GLMaterial material{};  // Texture handles are filled in by the commit
+            std::shared_ptr<DecodedTexture> maps[3];  // Diffuse, normal, RMA, shared by sub-meshes using the same map
+            int maps_committed{ 0 };
+        };
+        int result{ S_OK };
+        binarymesh::MeshFile cache;
+        std::vector<std::shared_ptr<TriangularMesh>> meshes;  // Parsed OBJ, holds the images uncompressed maps upload from
+        std::vector<std::vector<Vertex>> vertex_buffers;  // Reordered vertices per sub-mesh
+        std::vector<std::vector<GLuint>> index_buffers;   // Indices of all levels per sub-mesh
+        std::unordered_map<std::string, std::shared_ptr<DecodedTexture>> textures;  // By registry key
+        std::vector<SubMesh> sub_meshes;
+        glm::vec3 quantization_min{ 0.0f };  // Bounds of every sub-mesh, see UploadMesh
+        glm::vec3 quantization_max{ 0.0f };
+        size_t committed{ 0 };  // Sub-meshes uploaded so far
+        int first_material{ -1 };  // materials_ slot of the file's first material, allocated by the first commit
+        std::vector<GLuint64> texture_handles;  // One registry reference per material map
+    };
+    // Worker side, touches neither GL nor the registries. Parses with _mesh_loader, so one mesh at a time.
+    void DecodeMesh(const std::string& file_name, DecodedMesh& mesh);
+    int DecodeMeshCache(const std::string& file_name, DecodedMesh& mesh);
+    // From the .ktx2 cache, or encoded from data (decoded from file_name when null) and cached
+    std::shared_ptr<DecodedTexture> DecodeMaterialTexture(DecodedMesh& mesh, const std::string& file_name,
+        const texturecompress::Usage usage, int width, int height, const GLvoid* data) const;
+    // Main thread side, false until everything is uploaded, resumes where it stopped
+    bool CommitMesh(DecodedMesh& mesh, std::vector<GLMesh>& gl_meshes);
+    bool CommitMaterialTexture(DecodedTexture& texture, GLuint64& handle);
+    // Hands the real sub-meshes to every entity that drew the placeholder
+    void OnMeshResident(const MeshAsset& asset);
+    std::vector<GLMesh> placeholder_meshes_;  // Box drawn while a mesh streams in, created with the first entity
+    const std::vector<GLMesh>& PlaceholderMeshes();
     std::unique_ptr<Player> player_;
 
-    // Shadow mapping
-    int shadow_width_{ 2048 };  // shadow map resolution
-    int shadow_height_{ 2048 };
-    GLuint fbo_shadow_map_{ 0 };  // shadow mapping FBO
-    GLuint tex_shadow_map_{ 0 };  // shadow map texture
-    GLuint shadow_program_{ 0 };  // shadow mapping shaders
-
-    // Rain particle system
-    GLuint rain_shader_program_{ 0 };
-    GLuint rain_vao_{ 0 };
-    GLuint rain_vbo_{ 0 };
-    static const int RAIN_PARTICLE_COUNT = 15000;
-    struct RainParticle {
-        glm::vec3 position;
-        float life;
-        glm::vec3 velocity;
-        float padding;
+    // Instanced rendering - per-instance data read by grass.vert from SSBO binding 1
+    struct GLInstance {
+        glm::mat4 M;   // Instance model matrix
+        glm::mat4 Mn;  // Instance normal matrix (mat4 keeps std430 layout simple)
+    };
+    GLuint identity_instance_ssbo_{ 0 };  // Single identity instance for non-instanced grass
+    void UploadInstances(component::Instances& instances);
+    void OnInstancesDestroyed(entt::registry& registry, entt::entity entity);
+
+    // Multi-draw indirect - one command per opaque sub-mesh, all drawn from geometry_pool_
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first_index;
+        GLint base_vertex;
+        GLuint base_instance;
+    };
+    // Per-entity data read by phong.vert/shadow.vert from SSBO binding 2 via gl_BaseInstance
+    struct GLDrawData {
+        glm::mat4 M;
+        glm::mat4 Mn;  // Normal matrix (mat4 keeps std430 layout simple)
+        glm::vec4 position_offset;  // GLMesh dequantisation, shared by all sub-meshes of the entity
+        glm::vec4 position_scale;
+        glm::ivec4 material_offset;  // x - GLMesh::material_offset, shared by the entity's sub-meshes as well
     };
-    std::vector<RainParticle> rain_particles_;
-    void UpdateRainParticles(float delta_time, const glm::vec3& camera_pos);
+    std::vector<DrawElementsIndirectCommand> draw_commands_;
+    std::vector<GLDrawData> draw_data_;
+    std::vector<OcclusionCuller::DrawBounds> draw_bounds_;  // World box per command, for occlusion culling
+    std::vector<DrawElementsIndirectCommand> short_draw_commands_;  // AppendDraws scratch for 16-bit index commands
+    std::vector<OcclusionCuller::DrawBounds> short_draw_bounds_;
+    // This frame's commands, draw data and boxes, one region of draw_stream_ - the occlusion cull zeroes commands
+    // in place, the CPU rewrites the region only after its fence passed
+    StreamBuffer draw_stream_;
+    GLint draw_ssbo_alignment_{ 256 };  // GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+    struct DrawBuffers {
+        GLuint buffer{ 0 };  // draw_stream_.buffer(), changes when it grows
+        GLintptr commands_offset{ 0 };
+        GLintptr data_offset{ 0 };
+        GLsizeiptr data_size{ 0 };
+        GLintptr bounds_offset{ 0 };
+    } draw_buffers_;
+    struct DrawRange {
+        GLsizei first{ 0 };  // First command in draw_buffers_
+        GLsizei count{ 0 };
+        GLsizei short_count{ 0 };  // Trailing commands of count with 16-bit indices, drawn by a second multi-draw
+    };
+    // Casters culled per cascade, static ones are empty unless the cascade's cached layer is refreshed this frame
+    DrawRange static_shadow_draws_[CascadedShadows::MAX_CASCADES];
+    DrawRange dynamic_shadow_draws_[CascadedShadows::MAX_CASCADES];
+    DrawRange main_draws_;
+    std::vector<GLuint> entity_draw_index_;  // Entity slot -> draw data index this frame
+    std::vector<size_t> drawn_entities_;
+    enum class DrawFilter { ALL, STATIC_ONLY, DYNAMIC_ONLY };
+    DrawRange AppendDraws(const Frustum& frustum, const DrawFilter filter);
+    void BuildOpaqueDraws(const Frustum& camera_frustum, const Frustum* cascade_frusta, const unsigned static_cascades);
+    void DrawOpaque(const DrawRange& range);  // glMultiDrawElementsIndirect per index type with the current program
+
+    void UpdateBounds();
+    // Picks this frame's level of detail of every mesh entity and grass instance
+    void SelectLods();
+    // Screen pixels per local unit of a model with the given local bounds, at their nearest to the camera
+    float LodPixelsPerUnit(const glm::mat4& M, const AABB& local) const;
+    bool lod_enabled_{ true };
+    float lod_pixel_error_{ 1.0f };
+    struct LodStats {
+        size_t triangles{ 0 };              // Main pass opaque and grass triangles drawn
+        size_t full_detail_triangles{ 0 };  // The same draws at level 0
+    } lod_stats_;
+    void OnBoundsDestroyed(entt::registry& registry, entt::entity entity);
+
+    // Shadow mapping - cascades fitted to the camera, one layer of a depth array each
+    CascadedShadows cascades_;
+    int shadow_width_{ 1024 };  // shadow map resolution of one cascade
+    int shadow_height_{ 1024 };
+    GLuint fbo_static_shadow_map_{ 0 };
+    GLuint tex_static_shadow_map_{ 0 };  // cached depth of static casters, GL_TEXTURE_2D_ARRAY
+    bool static_shadow_dirty_{ true };  // static caster moved, appeared or disappeared
+    AABB static_bounds_;  // World box of the static casters, rebuilt while static_shadow_dirty_
+    glm::mat4 cached_light_space_matrices_[CascadedShadows::MAX_CASCADES]{};  // light each static layer was rendered with
+    void CreateShadowTarget(GLuint& texture, GLuint& fbo) const;
+    GLuint shadow_sampler_{ 0 };  // Hardware depth comparison with bilinear PCF, bound to unit 3
+    ShadowQuality shadow_quality_{ ShadowQuality::MEDIUM };
+    int shadow_taps_{ 16 };
+    int pending_shadow_resolution_{ 0 };  // Non zero until SetShadowResolution() is applied
+    void InvalidateStaticShadows(entt::registry& registry, entt::entity entity);
+    ShaderProgram shadow_program_;  // shadow mapping shaders
+    Uniform<GLint> shadow_cascade_uniform_;
+
+    // GPU particles of all ParticleEmitter entities
+    ShaderProgram particle_program_;
+
+    // Main draws hidden behind last frame's depth pyramid get an instance count of 0
+    OcclusionCuller occlusion_;
+    bool occlusion_culling_{ false };
+
+    // Depth-only pass over main_draws_ ahead of the phong pass, toggled with P
+    ShaderProgram depth_prepass_program_;
+    bool depth_prepass_{ false };
+
+    // Main pass draws of all sections, sorted by key before submission
+    RenderQueue render_queue_;
+
+    // Passes of a frame and the resources between them, built once in Show()
+    FrameGraph frame_graph_;
+    struct FrameState {  // Per-frame inputs the passes read
+        Frustum camera_frustum;
+        glm::mat4 VP{ 1.0f };
+        glm::vec3 camera_pos{ 0.0f };
+        float lod_scale{ 0.0f };  // Pixels covered by one world unit one unit in front of the camera
+        GLsizei framebuffer_width{ 0 };
+        GLsizei framebuffer_height{ 0 };
+        float delta_time{ 0.0f };
+        unsigned refresh_static_cascades{ 0 };  // Bit per cascade whose static layer is redrawn
+        GLuint shadow_texture{ 0 };  // Static map array, or the dynamic one once that pass ran
+        unsigned dynamic_cascades{ 0 };  // Bit per layer of shadow_texture with dynamic casters, the rest sample the static map
+    } frame_;
+    int BuildFrameGraph();
+    // Draws ranges[c] into layer c of texture for every cascade bit set in cascades
+    void DrawShadowCasters(const DrawRange* ranges, const GLuint fbo, const GLuint texture, const unsigned cascades, const bool clear);
+    void DrawMainPass();
+
+    // Uniform handles, resolved once after each program is linked
+    // Camera, light and time live in frame_constants_, opaque model matrices in draw_stream_
+    struct GrassUniforms {
+        Uniform<glm::mat4> M;
+        Uniform<glm::mat3> Mn;
+        Uniform<glm::vec3> position_offset;
+        Uniform<glm::vec3> position_scale;
+        Uniform<GLint> material_offset;
+    } grass_uniforms_;
+    struct PhongUniforms {
+        Uniform<GLint> shadow_filter;
+        Uniform<GLint> shadow_taps;
+        Uniform<GLint> shadow_dynamic_cascades;
+    } phong_uniforms_;
+    struct SkyboxUniforms {
+        Uniform<GLuint64> skybox_texture;
+    } skybox_uniforms_;
+
+    // Per-frame constants shared by all programs (std140 UBO, binding 0)
+    FrameConstantsBuffer frame_constants_;
 
     // Camera orbit controls
     float orbit_angle_{ 0.0f };      // Horizontal angle around target (radians)
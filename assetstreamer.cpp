@@ -0,0 +1,203 @@
+#include "assetstreamer.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+AssetStreamer::AssetStreamer(ThreadPool* pool) : pool_(pool) {
+}
+
+AssetStreamer::~AssetStreamer() {
+    // Decodes write into state their commits own, which goes away with the queued jobs
+    std::unique_lock<std::mutex> lock(mutex_);
+    decoded_condition_.wait(lock, [this] { return decoding_ == 0; });
+}
+
+int AssetStreamer::Init(const GLsizeiptr upload_budget) {
+    staging_ready_ = staging_.Init(upload_budget, "texture uploads") == S_OK;
+    return staging_ready_ ? S_OK : S_FALSE;
+}
+
+void AssetStreamer::Enqueue(Decode decode, Commit commit, const bool serial) {
+    auto job = std::make_shared<Job>();
+    job->decode = std::move(decode);
+    job->commit = std::move(commit);
+    jobs_.push_back(job);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++decoding_;
+    }
+
+    // Without workers nothing would ever pick the job up
+    if (!pool_ || pool_->worker_count() == 0) {
+        RunDecode(*job);
+        return;
+    }
+
+    if (!serial) {
+        pool_->Submit([this, job]() { RunDecode(*job); });
+        return;
+    }
+
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        serial_queue_.push_back(job);
+        start = !serial_running_;
+        serial_running_ = true;
+    }
+    if (start) {
+        pool_->Submit([this]() { RunSerial(); });
+    }
+}
+
+void AssetStreamer::RunDecode(Job& job) {
+    job.decode();
+    job.decode = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    job.decoded = true;
+    --decoding_;
+    decoded_condition_.notify_all();
+}
+
+void AssetStreamer::RunSerial() {
+    for (;;) {
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (serial_queue_.empty()) {
+                serial_running_ = false;
+                return;
+            }
+            job = std::move(serial_queue_.front());
+            serial_queue_.pop_front();
+        }
+        RunDecode(*job);
+    }
+}
+
+void AssetStreamer::Retire() {
+    jobs_.front()->commit = nullptr;
+    jobs_.pop_front();
+}
+
+size_t AssetStreamer::Update(const double budget_ms) {
+    if (jobs_.empty() || !jobs_.front()->decoded) {
+        return jobs_.size();
+    }
+
+    deadline_ = std::chrono::steady_clock::now()
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(budget_ms));
+    staging_.BeginFrame();
+
+    // The front job holds back later ones until it is decoded and fully committed
+    while (!jobs_.empty() && jobs_.front()->decoded) {
+        if (!jobs_.front()->commit()) {
+            break;
+        }
+        Retire();
+        if (!HasTimeLeft()) {
+            break;
+        }
+    }
+
+    staging_.EndFrame();
+    deadline_ = std::chrono::steady_clock::time_point::max();
+    return jobs_.size();
+}
+
+void AssetStreamer::Flush() {
+    while (!jobs_.empty()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            decoded_condition_.wait(lock, [this] { return jobs_.front()->decoded.load(); });
+        }
+
+        // A commit stopping on a full staging region continues in the next one
+        staging_.BeginFrame();
+        const bool done = jobs_.front()->commit();
+        staging_.EndFrame();
+        if (done) {
+            Retire();
+        }
+    }
+}
+
+bool AssetStreamer::Stage(const uint8_t* data, const size_t size, const void*& pixels) {
+    // More than a whole region is read straight from client memory, with the unpack buffer unbound
+    if (!staging_ready_ || GLsizeiptr(size) + 16 > staging_.region_size()) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pixels = data;
+        return true;
+    }
+    if (GLsizeiptr(size) + 16 > staging_.remaining()) {
+        return false;
+    }
+    // Offsets into the bound unpack buffer take the place of client pointers
+    const StreamBuffer::Allocation allocation = staging_.Allocate(GLsizeiptr(size));
+    std::memcpy(allocation.data, data, size);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_.buffer());
+    pixels = reinterpret_cast<const void*>(allocation.offset);
+    return true;
+}
+
+bool AssetStreamer::Upload(TextureUpload& upload) {
+    const bool compressed = !upload.image.levels.empty();
+    const size_t level_count = compressed ? upload.image.levels.size() : 1;
+    if (!compressed && (!upload.rgb || upload.width <= 0 || upload.height <= 0)) {
+        return true;
+    }
+
+    if (upload.texture == 0) {
+        // Immutable storage for the whole chain, RGB8 mips are filled by glGenerateTextureMipmap at the end
+        const GLsizei width = compressed ? GLsizei(upload.image.width) : upload.width;
+        const GLsizei height = compressed ? GLsizei(upload.image.height) : upload.height;
+        const GLsizei levels = compressed ? GLsizei(level_count) : 1 + GLsizei(std::floor(std::log2(float(std::max(width, height)))));
+        glCreateTextures(GL_TEXTURE_2D, 1, &upload.texture);
+        glTextureStorage2D(upload.texture, levels, compressed ? texturecompress::InternalFormat(upload.image.usage) : GL_SRGB8, width, height);
+        glTextureParameteri(upload.texture, GL_TEXTURE_WRAP_S, upload.wrap);
+        glTextureParameteri(upload.texture, GL_TEXTURE_WRAP_T, upload.wrap);
+        glTextureParameteri(upload.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(upload.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    while (upload.next_level < level_count) {
+        if (compressed) {
+            const texturecompress::Level& level = upload.image.levels[upload.next_level];
+            const void* pixels = nullptr;
+            if (!Stage(upload.image.data + level.offset, level.size, pixels)) {
+                break;  // The rest goes through next frame's region
+            }
+            glCompressedTextureSubImage2D(upload.texture, GLint(upload.next_level), 0, 0, GLsizei(level.width), GLsizei(level.height),
+                texturecompress::InternalFormat(upload.image.usage), GLsizei(level.size), pixels);
+            ++upload.next_level;
+            continue;
+        }
+
+        // RGB8 images can be huge (the skybox), they go up in bands of rows
+        const size_t row_size = size_t(upload.width) * 3;
+        GLsizeiptr rows = upload.height - upload.next_row;
+        if (staging_ready_ && GLsizeiptr(row_size) + 16 <= staging_.region_size()) {
+            rows = std::min(rows, std::max<GLsizeiptr>(staging_.remaining() - 16, 0) / GLsizeiptr(row_size));
+        }
+        const void* pixels = nullptr;
+        if (rows == 0 || !Stage(upload.rgb + upload.next_row * row_size, size_t(rows) * row_size, pixels)) {
+            break;
+        }
+        glTextureSubImage2D(upload.texture, 0, 0, upload.next_row, upload.width, GLsizei(rows), upload.source_format, GL_UNSIGNED_BYTE, pixels);
+        upload.next_row += int(rows);
+        if (upload.next_row == upload.height) {
+            ++upload.next_level;
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (upload.next_level < level_count) {
+        return false;
+    }
+    if (!compressed) {
+        glGenerateTextureMipmap(upload.texture);
+    }
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "glutils.h"
+#include "streambuffer.h"
+#include "texturecompress.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+class ThreadPool;
+
+// Background loading of meshes and textures
+// A job's decode step (file IO, parsing, image decoding and encoding) runs on the thread pool, its commit step
+// (everything touching GL) on the main thread in Update(), once a frame within a time budget. Commits run in
+// the order the jobs were enqueued, so results don't depend on which decode finishes first. A commit returns
+// false to be resumed next frame, which spreads a large asset over several frames instead of one long stall.
+// Texture levels go up through a persistently mapped pixel unpack buffer (a StreamBuffer ring), its region
+// size caps the bytes staged per frame.
+class AssetStreamer {
+public:
+    using Decode = std::function<void()>;
+    using Commit = std::function<bool()>;  // True once done
+
+    // Texture uploaded level by level by Upload(), the source must stay alive until it is complete
+    struct TextureUpload {
+        texturecompress::Image image;     // Block compressed levels, or none for an RGB8 image
+        const uint8_t* rgb{ nullptr };    // sRGB RGB8 level 0, the rest of the chain is generated on the GPU
+        int width{ 0 };
+        int height{ 0 };
+        GLenum source_format{ GL_RGB };   // GL_BGR for FreeImage's channel order
+        GLenum wrap{ GL_REPEAT };
+        GLuint texture{ 0 };              // Created by the first Upload()
+        size_t next_level{ 0 };
+        int next_row{ 0 };                // RGB8 rows of level 0 uploaded so far
+    };
+
+    explicit AssetStreamer(ThreadPool* pool);
+    ~AssetStreamer();  // Waits for decodes still running
+    AssetStreamer(const AssetStreamer&) = delete;
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    // upload_budget is the staging buffer region, i.e. texture bytes per frame, returns S_OK or S_FALSE
+    int Init(const GLsizeiptr upload_budget);
+
+    // Serial jobs decode one at a time in enqueue order, for loaders that aren't thread safe (MeshLoader)
+    void Enqueue(Decode decode, Commit commit, const bool serial = false);
+
+    // Commits decoded jobs until budget_ms is used up, returns the number of jobs not committed yet
+    size_t Update(const double budget_ms);
+    // Decodes and commits everything enqueued so far before returning
+    void Flush();
+
+    // For commits that can stop part way - false once this frame's budget is used up, always true in Flush()
+    bool HasTimeLeft() const { return std::chrono::steady_clock::now() < deadline_; }
+
+    // Main thread, inside a commit. Copies as many levels (RGB8 rows) as fit into this frame's staging region,
+    // true once the texture is complete (or failed, texture is then 0). Levels larger than a region go up directly.
+    bool Upload(TextureUpload& upload);
+
+    size_t pending() const { return jobs_.size(); }
+
+private:
+    struct Job {
+        Decode decode;
+        Commit commit;
+        std::atomic<bool> decoded{ false };
+    };
+
+    void RunDecode(Job& job);
+    void RunSerial();  // Worker loop over serial_queue_
+    void Retire();     // Pops the committed front job, its captures are released on the main thread
+    // Copies data into the staging region and binds it, pixels is then the offset to pass to GL, or data itself
+    // if it is read from client memory. False if the region has no room left this frame.
+    bool Stage(const uint8_t* data, const size_t size, const void*& pixels);
+
+    ThreadPool* pool_{ nullptr };
+    std::deque<std::shared_ptr<Job>> jobs_;  // Enqueue order, main thread only
+
+    std::mutex mutex_;
+    std::condition_variable decoded_condition_;
+    std::deque<std::shared_ptr<Job>> serial_queue_;  // Serial jobs waiting for RunSerial
+    bool serial_running_{ false };
+    size_t decoding_{ 0 };  // Enqueued and not decoded yet
+
+    StreamBuffer staging_;  // GL_PIXEL_UNPACK_BUFFER source of Upload()
+    bool staging_ready_{ false };
+    std::chrono::steady_clock::time_point deadline_{ std::chrono::steady_clock::time_point::max() };
+};
@@ -0,0 +1,381 @@
+#include "binarymesh.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cfloat>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace binarymesh {
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+#ifdef _WIN32
+    bool MappedFile::Open(const std::string& file_name) {
+        Close();
+
+        HANDLE file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER file_size{};
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        file_ = file;
+        mapping_ = mapping;
+        data_ = static_cast<const uint8_t*>(view);
+        size_ = static_cast<size_t>(file_size.QuadPart);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(static_cast<HANDLE>(mapping_));
+        }
+        if (file_) {
+            CloseHandle(static_cast<HANDLE>(file_));
+        }
+        data_ = nullptr;
+        size_ = 0;
+        mapping_ = nullptr;
+        file_ = nullptr;
+    }
+#else
+    bool MappedFile::Open(const std::string& file_name) {
+        Close();
+
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        fd_ = fd;
+        data_ = static_cast<const uint8_t*>(view);
+        size_ = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (data_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        fd_ = -1;
+    }
+#endif
+
+    bool StatFile(const std::string& file_name, int64_t& write_time, uint64_t& size) {
+        std::error_code ec;
+        const auto time = std::filesystem::last_write_time(file_name, ec);
+        if (ec) {
+            return false;
+        }
+        size = std::filesystem::file_size(file_name, ec);
+        if (ec) {
+            return false;
+        }
+        write_time = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    bool MeshFile::Open(const std::string& cache_file_name) {
+        if (!file_.Open(cache_file_name)) {
+            return false;
+        }
+
+        const uint8_t* data = file_.data();
+        const size_t size = file_.size();
+
+        if (size < sizeof(FileHeader)) {
+            return false;
+        }
+        header_ = reinterpret_cast<const FileHeader*>(data);
+
+        if (header_->magic != kMagic || header_->version != kVersion) {
+            std::cout << "Mesh cache '" << cache_file_name << "' has old format, rebuilding" << std::endl;
+            return false;
+        }
+
+        // Raw Vertex/Triangle blobs are only valid for the layout they were written with
+        if (header_->vertex_stride != sizeof(Vertex) || header_->triangle_stride != sizeof(Triangle)) {
+            std::cout << "Mesh cache '" << cache_file_name << "' has different vertex layout, rebuilding" << std::endl;
+            return false;
+        }
+
+        const size_t tables_size = sizeof(FileHeader)
+            + header_->dependency_count * sizeof(DependencyRecord)
+            + header_->sub_mesh_count * (sizeof(SubMeshRecord) + sizeof(MaterialRecord));
+        if (size < tables_size) {
+            return false;
+        }
+
+        const auto* dependencies = reinterpret_cast<const DependencyRecord*>(data + sizeof(FileHeader));
+        sub_meshes_ = reinterpret_cast<const SubMeshRecord*>(dependencies + header_->dependency_count);
+        materials_ = reinterpret_cast<const MaterialRecord*>(sub_meshes_ + header_->sub_mesh_count);
+
+        // Invalidate when the OBJ or any of its material libraries changed
+        for (uint32_t i = 0; i < header_->dependency_count; ++i) {
+            int64_t write_time = 0;
+            uint64_t file_size = 0;
+            if (!StatFile(dependencies[i].path, write_time, file_size)
+                || write_time != dependencies[i].write_time || file_size != dependencies[i].size) {
+                std::cout << "Mesh cache '" << cache_file_name << "' is stale (" << dependencies[i].path << " changed)" << std::endl;
+                return false;
+            }
+        }
+
+        for (uint32_t i = 0; i < header_->sub_mesh_count; ++i) {
+            const SubMeshRecord& sub_mesh = sub_meshes_[i];
+            if (sub_mesh.vertex_offset + sub_mesh.vertex_size > size || sub_mesh.index_offset + sub_mesh.index_size > size) {
+                std::cout << "Mesh cache '" << cache_file_name << "' is truncated" << std::endl;
+                return false;
+            }
+            uint64_t lod_indices = 0;
+            for (uint32_t lod = 0; lod < sub_mesh.lod_count && lod < kMaxLods; ++lod) {
+                lod_indices += sub_mesh.lod_index_count[lod];
+            }
+            if (sub_mesh.lod_count == 0 || sub_mesh.lod_count > kMaxLods || lod_indices * sizeof(GLuint) != sub_mesh.index_size) {
+                std::cout << "Mesh cache '" << cache_file_name << "' has invalid levels of detail" << std::endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::string CachePath(const std::string& obj_file_name) {
+        return obj_file_name + ".bin";
+    }
+
+    void CopyString(char* dst, size_t dst_size, const std::string& src) {
+        const size_t length = std::min(src.size(), dst_size - 1);
+        std::copy_n(src.data(), length, dst);
+        dst[length] = '\0';
+    }
+
+    std::vector<std::string> FindMaterialLibraries(const std::string& obj_file_name) {
+        std::vector<std::string> libraries;
+        std::ifstream file(obj_file_name);
+        if (!file.is_open()) {
+            return libraries;
+        }
+
+        const std::filesystem::path directory = std::filesystem::path(obj_file_name).parent_path();
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.compare(0, 7, "mtllib ") != 0) continue;
+
+            std::istringstream iss(line.substr(7));
+            std::string library;
+            while (iss >> library) {
+                libraries.push_back((directory / library).string());
+            }
+        }
+
+        return libraries;
+    }
+
+    std::unordered_map<std::string, MaterialTextures> ReadMaterialTextures(const std::vector<std::string>& mtl_file_names) {
+        std::unordered_map<std::string, MaterialTextures> textures;
+
+        for (const auto& mtl_file_name : mtl_file_names) {
+            std::ifstream file(mtl_file_name);
+            if (!file.is_open()) {
+                std::cout << "Material library not found: " << mtl_file_name << std::endl;
+                continue;
+            }
+
+            const std::filesystem::path directory = std::filesystem::path(mtl_file_name).parent_path();
+            MaterialTextures* current = nullptr;
+
+            std::string line;
+            while (std::getline(file, line)) {
+                std::istringstream iss(line);
+                std::string prefix;
+                iss >> prefix;
+
+                if (prefix == "newmtl") {
+                    std::string name;
+                    iss >> name;
+                    current = &textures[name];
+                    continue;
+                }
+                if (!current) continue;
+
+                // Texture file name is the last token (options like -bm come first)
+                std::string token, map_file;
+                while (iss >> token) {
+                    map_file = token;
+                }
+                if (map_file.empty()) continue;
+                const std::string map_path = (directory / map_file).string();
+
+                if (prefix == "map_Kd") current->diffuse_map = map_path;
+                else if (prefix == "map_bump" || prefix == "map_Bump" || prefix == "bump" || prefix == "norm") current->normal_map = map_path;
+                else if (prefix == "map_Ks") current->specular_map = map_path;
+                else if (prefix == "map_Pr") current->roughness_map = map_path;
+                else if (prefix == "map_Pm") current->metallic_map = map_path;
+            }
+        }
+
+        return textures;
+    }
+
+    bool Write(const std::string& cache_file_name, const std::vector<std::string>& dependencies, const std::vector<SubMeshData>& sub_meshes) {
+        FileHeader header{};
+        header.magic = kMagic;
+        header.version = kVersion;
+        header.vertex_stride = sizeof(Vertex);
+        header.triangle_stride = sizeof(Triangle);
+        header.dependency_count = static_cast<uint32_t>(dependencies.size());
+        header.sub_mesh_count = static_cast<uint32_t>(sub_meshes.size());
+
+        glm::vec3 bounds_min(FLT_MAX);
+        glm::vec3 bounds_max(-FLT_MAX);
+
+        std::vector<DependencyRecord> dependency_records(dependencies.size());
+        for (size_t i = 0; i < dependencies.size(); ++i) {
+            CopyString(dependency_records[i].path, kMaxPath, dependencies[i]);
+            if (!StatFile(dependencies[i], dependency_records[i].write_time, dependency_records[i].size)) {
+                std::cout << "Mesh cache: cannot stat dependency " << dependencies[i] << std::endl;
+                return false;
+            }
+        }
+
+        // Blobs follow the tables, each aligned to 16 bytes
+        uint64_t offset = sizeof(FileHeader)
+            + dependency_records.size() * sizeof(DependencyRecord)
+            + sub_meshes.size() * (sizeof(SubMeshRecord) + sizeof(MaterialRecord));
+        auto align = [](uint64_t value) { return (value + 15) & ~uint64_t(15); };
+
+        std::vector<SubMeshRecord> sub_mesh_records(sub_meshes.size());
+        std::vector<MaterialRecord> material_records(sub_meshes.size());
+        for (size_t i = 0; i < sub_meshes.size(); ++i) {
+            const SubMeshData& src = sub_meshes[i];
+            SubMeshRecord& record = sub_mesh_records[i];
+
+            offset = align(offset);
+            record.vertex_offset = offset;
+            record.vertex_size = src.vertex_size;
+            record.vertex_count = src.vertex_count;
+            offset += src.vertex_size;
+
+            offset = align(offset);
+            record.index_offset = offset;
+            record.index_size = src.index_size;
+            record.index_count = src.index_count;
+            offset += src.index_size;
+
+            record.lod_count = src.lod_count;
+            for (uint32_t lod = 0; lod < kMaxLods; ++lod) {
+                record.lod_index_count[lod] = src.lod_index_count[lod];
+                record.lod_error[lod] = src.lod_error[lod];
+            }
+            record.acmr = src.acmr;
+            record.atvr = src.atvr;
+
+            for (int k = 0; k < 3; ++k) {
+                record.bounds_min[k] = src.bounds_min[k];
+                record.bounds_max[k] = src.bounds_max[k];
+            }
+            bounds_min = glm::min(bounds_min, src.bounds_min);
+            bounds_max = glm::max(bounds_max, src.bounds_max);
+
+            material_records[i] = src.material;
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            header.bounds_min[k] = bounds_min[k];
+            header.bounds_max[k] = bounds_max[k];
+        }
+
+        // Write to a temporary file first so a crash never leaves a half written cache
+        const std::string temp_file_name = cache_file_name + ".tmp";
+        {
+            std::ofstream file(temp_file_name, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cout << "Mesh cache: cannot write " << temp_file_name << std::endl;
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(dependency_records.data()), dependency_records.size() * sizeof(DependencyRecord));
+            file.write(reinterpret_cast<const char*>(sub_mesh_records.data()), sub_mesh_records.size() * sizeof(SubMeshRecord));
+            file.write(reinterpret_cast<const char*>(material_records.data()), material_records.size() * sizeof(MaterialRecord));
+
+            const char padding[16] = {};
+            for (size_t i = 0; i < sub_meshes.size(); ++i) {
+                file.write(padding, sub_mesh_records[i].vertex_offset - static_cast<uint64_t>(file.tellp()));
+                file.write(static_cast<const char*>(sub_meshes[i].vertices), sub_meshes[i].vertex_size);
+                file.write(padding, sub_mesh_records[i].index_offset - static_cast<uint64_t>(file.tellp()));
+                file.write(static_cast<const char*>(sub_meshes[i].indices), sub_meshes[i].index_size);
+            }
+
+            if (!file.good()) {
+                file.close();
+                std::filesystem::remove(temp_file_name);
+                std::cout << "Mesh cache: write failed for " << cache_file_name << std::endl;
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_file_name, cache_file_name, ec);
+        if (ec) {
+            std::filesystem::remove(temp_file_name, ec);
+            return false;
+        }
+
+        std::cout << "Mesh cache written: " << cache_file_name << " (" << offset << " bytes)" << std::endl;
+        return true;
+    }
+}
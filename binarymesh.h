@@ -0,0 +1,155 @@
+#pragma once
+#include "glutils.h"
+#include <cstdint>
+#include <unordered_map>
+
+// Binary mesh cache (<file>.obj.bin next to the source OBJ)
+//
+// Layout: FileHeader | DependencyRecord[dependency_count] | SubMeshRecord[sub_mesh_count]
+//         | MaterialRecord[sub_mesh_count] | vertex and index blobs
+// Vertex and index blobs are the Vertex/Triangle arrays produced by MeshLoader after the load-time
+// reordering (meshoptimize), so they can go from the memory mapped file straight into glBufferData.
+// Vertex material indices count from the file's first material, the draws add where its materials land.
+// The index blob continues with the indices of the coarser levels of detail (meshsimplify).
+namespace binarymesh {
+
+    constexpr uint32_t kMagic = 0x4D47505A;  // "ZPGM"
+    constexpr uint32_t kVersion = 4;
+    constexpr size_t kMaxPath = 260;
+    constexpr size_t kMaxName = 64;
+    constexpr uint32_t kMaxLods = GLMesh::MAX_LODS;
+
+#pragma pack(push, 1)
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertex_stride;    // sizeof(Vertex) at write time
+        uint32_t triangle_stride;  // sizeof(Triangle) at write time
+        uint32_t dependency_count;
+        uint32_t sub_mesh_count;
+        float bounds_min[3];       // Whole file bounds
+        float bounds_max[3];
+    };
+
+    // Source file the cache was built from - OBJ first, then its material libraries
+    struct DependencyRecord {
+        char path[kMaxPath];
+        int64_t write_time;
+        uint64_t size;
+    };
+
+    struct SubMeshRecord {
+        uint64_t vertex_offset;    // Byte offset from the start of the file
+        uint64_t vertex_size;      // Bytes
+        uint64_t vertex_count;
+        uint64_t index_offset;
+        uint64_t index_size;
+        uint64_t index_count;      // As reported by TriangularMesh::index_buffer_count
+        float bounds_min[3];
+        float bounds_max[3];
+        uint32_t lod_count;        // Levels of detail in the index blob, level 0 (the source) first
+        uint32_t lod_index_count[kMaxLods];
+        float lod_error[kMaxLods]; // Simplification error in object units
+        float acmr;                // Vertex cache statistics of level 0 (meshoptimize::CacheStats)
+        float atvr;
+    };
+
+    struct MaterialRecord {
+        char name[kMaxName];
+        float diffuse[3];
+        float rma[3];              // roughness, metalness, ao
+        float normal[3];
+        char diffuse_map[kMaxPath];  // Empty string if the material has no such map
+        char normal_map[kMaxPath];
+        char rma_map[kMaxPath];
+    };
+#pragma pack(pop)
+
+    // Sub-mesh data handed to Write, pointers must stay valid during the call
+    struct SubMeshData {
+        const void* vertices{ nullptr };
+        size_t vertex_size{ 0 };
+        size_t vertex_count{ 0 };
+        const void* indices{ nullptr };
+        size_t index_size{ 0 };
+        size_t index_count{ 0 };
+        glm::vec3 bounds_min{ 0.0f };
+        glm::vec3 bounds_max{ 0.0f };
+        uint32_t lod_count{ 1 };   // indices hold all levels back to back
+        uint32_t lod_index_count[kMaxLods]{};
+        float lod_error[kMaxLods]{};
+        float acmr{ 0.0f };
+        float atvr{ 0.0f };
+        MaterialRecord material{};
+    };
+
+    // Texture maps of one material as listed in the .mtl files
+    struct MaterialTextures {
+        std::string diffuse_map;
+        std::string normal_map;
+        std::string specular_map;
+        std::string roughness_map;
+        std::string metallic_map;
+    };
+
+    // Read-only memory mapped file
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::string& file_name);
+        void Close();
+
+        const uint8_t* data() const { return data_; }
+        size_t size() const { return size_; }
+
+    private:
+        const uint8_t* data_{ nullptr };
+        size_t size_{ 0 };
+#ifdef _WIN32
+        void* file_{ nullptr };
+        void* mapping_{ nullptr };
+#else
+        int fd_{ -1 };
+#endif
+    };
+
+    // Validated view of a cache file
+    class MeshFile {
+    public:
+        // Fails if the file is missing, malformed, built for another Vertex/Triangle
+        // layout, or any source file changed since it was written
+        bool Open(const std::string& cache_file_name);
+
+        const FileHeader& header() const { return *header_; }
+        const SubMeshRecord& sub_mesh(size_t i) const { return sub_meshes_[i]; }
+        const MaterialRecord& material(size_t i) const { return materials_[i]; }
+        const void* vertices(size_t i) const { return file_.data() + sub_meshes_[i].vertex_offset; }
+        const void* indices(size_t i) const { return file_.data() + sub_meshes_[i].index_offset; }
+
+    private:
+        MappedFile file_;
+        const FileHeader* header_{ nullptr };
+        const SubMeshRecord* sub_meshes_{ nullptr };
+        const MaterialRecord* materials_{ nullptr };
+    };
+
+    std::string CachePath(const std::string& obj_file_name);
+
+    // Timestamp and size of a source file, false if it doesn't exist
+    bool StatFile(const std::string& file_name, int64_t& write_time, uint64_t& size);
+
+    // Material libraries (mtllib) referenced by the OBJ, resolved relative to it
+    std::vector<std::string> FindMaterialLibraries(const std::string& obj_file_name);
+
+    // Texture maps per material name from the given .mtl files
+    std::unordered_map<std::string, MaterialTextures> ReadMaterialTextures(const std::vector<std::string>& mtl_file_names);
+
+    // Writes the cache, returns false (and leaves no partial file) on IO error
+    bool Write(const std::string& cache_file_name, const std::vector<std::string>& dependencies, const std::vector<SubMeshData>& sub_meshes);
+
+    void CopyString(char* dst, size_t dst_size, const std::string& src);
+}
@@ -0,0 +1,221 @@
+#include "bvh.h"
+#include <algorithm>
+
+// Margin added around leaf boxes, in world units
+static const float FAT_MARGIN = 0.25f;
+
+static AABB Fatten(const AABB& box) {
+    AABB fat = box;
+    fat.min -= glm::vec3(FAT_MARGIN);
+    fat.max += glm::vec3(FAT_MARGIN);
+    return fat;
+}
+
+int DynamicBVH::AllocateNode() {
+    if (free_list_ == NULL_NODE) {
+        nodes_.emplace_back();
+        return int(nodes_.size() - 1);
+    }
+    const int node = free_list_;
+    free_list_ = nodes_[node].parent;
+    nodes_[node] = Node();
+    return node;
+}
+
+void DynamicBVH::FreeNode(int node) {
+    nodes_[node].parent = free_list_;
+    nodes_[node].height = -1;
+    free_list_ = node;
+}
+
+int DynamicBVH::CreateProxy(const AABB& box, uint32_t user_data) {
+    const int proxy = AllocateNode();
+    nodes_[proxy].box = Fatten(box);
+    nodes_[proxy].user_data = user_data;
+    nodes_[proxy].height = 0;
+    InsertLeaf(proxy);
+    ++proxy_count_;
+    return proxy;
+}
+
+void DynamicBVH::DestroyProxy(int proxy) {
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --proxy_count_;
+}
+
+bool DynamicBVH::MoveProxy(int proxy, const AABB& box) {
+    if (nodes_[proxy].box.contains(box)) {
+        return false;
+    }
+    RemoveLeaf(proxy);
+    nodes_[proxy].box = Fatten(box);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void DynamicBVH::InsertLeaf(int leaf) {
+    if (root_ == NULL_NODE) {
+        root_ = leaf;
+        nodes_[root_].parent = NULL_NODE;
+        return;
+    }
+
+    // Descend towards the sibling with the lowest surface area cost
+    const AABB leaf_box = nodes_[leaf].box;
+    int index = root_;
+    while (!nodes_[index].leaf()) {
+        const Node& node = nodes_[index];
+        const float area = node.box.surface_area();
+        const float combined_area = AABB::Union(node.box, leaf_box).surface_area();
+
+        // Cost of making a new parent for this node and the leaf
+        const float cost = 2.0f * combined_area;
+        // Minimum cost of pushing the leaf further down
+        const float inheritance_cost = 2.0f * (combined_area - area);
+
+        auto child_cost = [&](int child) {
+            const float new_area = AABB::Union(nodes_[child].box, leaf_box).surface_area();
+            return nodes_[child].leaf() ? new_area + inheritance_cost
+                : new_area - nodes_[child].box.surface_area() + inheritance_cost;
+        };
+        const float cost1 = child_cost(node.child1);
+        const float cost2 = child_cost(node.child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    // Replace the sibling with a new parent of both
+    const int sibling = index;
+    const int old_parent = nodes_[sibling].parent;
+    const int new_parent = AllocateNode();
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].box = AABB::Union(leaf_box, nodes_[sibling].box);
+    nodes_[new_parent].height = nodes_[sibling].height + 1;
+    nodes_[new_parent].child1 = sibling;
+    nodes_[new_parent].child2 = leaf;
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+
+    if (old_parent == NULL_NODE) {
+        root_ = new_parent;
+    }
+    else if (nodes_[old_parent].child1 == sibling) {
+        nodes_[old_parent].child1 = new_parent;
+    }
+    else {
+        nodes_[old_parent].child2 = new_parent;
+    }
+
+    // Refit ancestors and keep the tree balanced
+    index = nodes_[leaf].parent;
+    while (index != NULL_NODE) {
+        index = Balance(index);
+        const int child1 = nodes_[index].child1;
+        const int child2 = nodes_[index].child2;
+        nodes_[index].height = 1 + std::max(nodes_[child1].height, nodes_[child2].height);
+        nodes_[index].box = AABB::Union(nodes_[child1].box, nodes_[child2].box);
+        index = nodes_[index].parent;
+    }
+}
+
+void DynamicBVH::RemoveLeaf(int leaf) {
+    if (leaf == root_) {
+        root_ = NULL_NODE;
+        return;
+    }
+
+    const int parent = nodes_[leaf].parent;
+    const int grand_parent = nodes_[parent].parent;
+    const int sibling = nodes_[parent].child1 == leaf ? nodes_[parent].child2 : nodes_[parent].child1;
+
+    if (grand_parent == NULL_NODE) {
+        root_ = sibling;
+        nodes_[sibling].parent = NULL_NODE;
+        FreeNode(parent);
+        return;
+    }
+
+    // Sibling takes the parent's place
+    if (nodes_[grand_parent].child1 == parent) {
+        nodes_[grand_parent].child1 = sibling;
+    }
+    else {
+        nodes_[grand_parent].child2 = sibling;
+    }
+    nodes_[sibling].parent = grand_parent;
+    FreeNode(parent);
+
+    int index = grand_parent;
+    while (index != NULL_NODE) {
+        index = Balance(index);
+        const int child1 = nodes_[index].child1;
+        const int child2 = nodes_[index].child2;
+        nodes_[index].box = AABB::Union(nodes_[child1].box, nodes_[child2].box);
+        nodes_[index].height = 1 + std::max(nodes_[child1].height, nodes_[child2].height);
+        index = nodes_[index].parent;
+    }
+}
+
+// Rotates the taller grandchild up if the subtree of a is unbalanced, returns the new subtree root
+int DynamicBVH::Balance(int a) {
+    Node& A = nodes_[a];
+    if (A.leaf() || A.height < 2) {
+        return a;
+    }
+
+    const int b = A.child1;
+    const int c = A.child2;
+    const int balance = nodes_[c].height - nodes_[b].height;
+
+    // rotate(up) the child that is deeper by more than one level
+    auto rotate = [&](int up, int other) {
+        Node& U = nodes_[up];
+        const int f = U.child1;
+        const int g = U.child2;
+
+        // Up becomes the parent of a
+        U.child1 = a;
+        U.parent = nodes_[a].parent;
+        nodes_[a].parent = up;
+
+        if (U.parent == NULL_NODE) {
+            root_ = up;
+        }
+        else if (nodes_[U.parent].child1 == a) {
+            nodes_[U.parent].child1 = up;
+        }
+        else {
+            nodes_[U.parent].child2 = up;
+        }
+
+        // The taller grandchild stays under up, the shorter one replaces up under a
+        const int keep = nodes_[f].height > nodes_[g].height ? f : g;
+        const int move = keep == f ? g : f;
+        U.child2 = keep;
+        if (nodes_[a].child1 == up) {
+            nodes_[a].child1 = move;
+        }
+        else {
+            nodes_[a].child2 = move;
+        }
+        nodes_[move].parent = a;
+
+        nodes_[a].box = AABB::Union(nodes_[other].box, nodes_[move].box);
+        nodes_[a].height = 1 + std::max(nodes_[other].height, nodes_[move].height);
+        U.box = AABB::Union(nodes_[a].box, nodes_[keep].box);
+        U.height = 1 + std::max(nodes_[a].height, nodes_[keep].height);
+        return up;
+    };
+
+    if (balance > 1) {
+        return rotate(c, b);
+    }
+    if (balance < -1) {
+        return rotate(b, c);
+    }
+    return a;
+}
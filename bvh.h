@@ -0,0 +1,101 @@
+#pragma once
+#include "frustum.h"
+#include <cstdint>
+
+// Dynamic bounding volume hierarchy (AABB tree) over world space boxes
+// Leaves store a fattened box, so objects moving a little don't touch the tree at all.
+// Leaves leaving their fat box are removed and reinserted (SAH descent + AVL rotations).
+class DynamicBVH {
+public:
+    static const int NULL_NODE = -1;
+
+    // Creates a leaf for the box, returns the proxy id
+    int CreateProxy(const AABB& box, uint32_t user_data);
+    void DestroyProxy(int proxy);
+    // Returns true if the proxy had to be reinserted
+    bool MoveProxy(int proxy, const AABB& box);
+
+    uint32_t user_data(int proxy) const { return nodes_[proxy].user_data; }
+    const AABB& fat_box(int proxy) const { return nodes_[proxy].box; }
+    int height() const { return root_ == NULL_NODE ? 0 : nodes_[root_].height; }
+    size_t proxy_count() const { return proxy_count_; }
+    // Box of the whole tree (fattened leaves), invalid when empty
+    AABB bounds() const { return root_ == NULL_NODE ? AABB() : nodes_[root_].box; }
+
+    // Calls callback(user_data) for every leaf intersecting the frustum
+    // Subtrees fully inside the frustum are accepted without testing their children
+    template <typename Callback>
+    void Query(const Frustum& frustum, Callback&& callback) const;
+
+private:
+    struct Node {
+        AABB box;
+        int parent{ NULL_NODE };  // Next free node while on the free list
+        int child1{ NULL_NODE };
+        int child2{ NULL_NODE };
+        int height{ 0 };          // Leaf = 0, free = -1
+        uint32_t user_data{ 0 };
+
+        bool leaf() const { return child1 == NULL_NODE; }
+    };
+
+    int AllocateNode();
+    void FreeNode(int node);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    int Balance(int node);
+    template <typename Callback>
+    void CollectLeaves(int node, Callback& callback) const;
+
+    std::vector<Node> nodes_;
+    int root_{ NULL_NODE };
+    int free_list_{ NULL_NODE };
+    size_t proxy_count_{ 0 };
+    mutable std::vector<int> stack_;
+};
+
+template <typename Callback>
+void DynamicBVH::CollectLeaves(int node, Callback& callback) const {
+    const size_t base = stack_.size();
+    stack_.push_back(node);
+    while (stack_.size() > base) {
+        const Node& current = nodes_[stack_.back()];
+        stack_.pop_back();
+        if (current.leaf()) {
+            callback(current.user_data);
+        }
+        else {
+            stack_.push_back(current.child1);
+            stack_.push_back(current.child2);
+        }
+    }
+}
+
+template <typename Callback>
+void DynamicBVH::Query(const Frustum& frustum, Callback&& callback) const {
+    if (root_ == NULL_NODE) {
+        return;
+    }
+    stack_.clear();
+    stack_.push_back(root_);
+    while (!stack_.empty()) {
+        const int index = stack_.back();
+        stack_.pop_back();
+        const Node& node = nodes_[index];
+
+        const Frustum::Result result = frustum.Test(node.box);
+        if (result == Frustum::OUTSIDE) {
+            continue;
+        }
+        if (node.leaf()) {
+            callback(node.user_data);
+        }
+        else if (result == Frustum::INSIDE) {
+            CollectLeaves(index, callback);
+        }
+        else {
+            stack_.push_back(node.child1);
+            stack_.push_back(node.child2);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#include "cascadedshadows.h"
+#include <algorithm>
+#include <cmath>
+
+void CascadedShadows::set_count(const int count) {
+    count_ = std::clamp(count, 1, MAX_CASCADES);
+    for (Fit& fit : fits_) {
+        fit.valid = false;
+    }
+}
+
+void CascadedShadows::Update(const glm::mat4& V, const glm::mat4& P, const float near_plane, const float far_plane,
+    const glm::vec3& light_direction, const AABB& static_bounds, const int resolution, const bool refit) {
+    const float shadow_far = std::min(far_plane, distance_);
+
+    // Corner rays of the camera frustum, view depth is linear along each of them
+    const glm::mat4 inv_VP = glm::inverse(P * V);
+    glm::vec3 near_corners[4];
+    glm::vec3 far_corners[4];
+    for (int i = 0; i < 4; ++i) {
+        const glm::vec2 ndc((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f);
+        const glm::vec4 n = inv_VP * glm::vec4(ndc, -1.0f, 1.0f);
+        const glm::vec4 f = inv_VP * glm::vec4(ndc, 1.0f, 1.0f);
+        near_corners[i] = glm::vec3(n) / n.w;
+        far_corners[i] = glm::vec3(f) / f.w;
+    }
+
+    // Light rotation only, the cascades translate within it
+    const glm::vec3 direction = glm::normalize(light_direction);
+    const glm::vec3 up = std::abs(direction.z) > 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+    const glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), direction, up);
+    const AABB static_ls = static_bounds.Transform(light_view);
+    const bool refit_all = refit || direction != light_direction_ || resolution != resolution_;
+    light_direction_ = direction;
+    resolution_ = resolution;
+
+    float split_near = near_plane;
+    for (int c = 0; c < count_; ++c) {
+        // Practical split scheme - a blend of logarithmic and uniform splits
+        const float t = float(c + 1) / float(count_);
+        const float log_split = near_plane * std::pow(shadow_far / near_plane, t);
+        const float uniform_split = near_plane + (shadow_far - near_plane) * t;
+        const float split_far = uniform_split + (log_split - uniform_split) * split_lambda_;
+
+        // Bounding sphere of the slice
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int i = 0; i < 4; ++i) {
+            corners[i] = glm::mix(near_corners[i], far_corners[i], (split_near - near_plane) / (far_plane - near_plane));
+            corners[i + 4] = glm::mix(near_corners[i], far_corners[i], (split_far - near_plane) / (far_plane - near_plane));
+            center += corners[i] + corners[i + 4];
+        }
+        center /= 8.0f;
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;  // Float noise must not change the texel size
+
+        // Kept while the slice's sphere stays inside the covered square and depth range
+        Fit& fit = fits_[c];
+        const glm::vec3 center_ls = glm::vec3(light_view * glm::vec4(center, 1.0f));
+        const glm::vec2 offset = glm::abs(glm::vec2(center_ls) - glm::vec2(fit.center_ls));
+        const bool inside = fit.valid && fit.slice_radius == radius && std::max(offset.x, offset.y) + radius <= fit.radius
+            && center_ls.z + radius <= fit.max_z && center_ls.z - radius >= fit.min_z;
+        if (inside && !refit_all) {
+            cascades_[c].split_far = split_far;
+            split_near = split_far;
+            continue;
+        }
+
+        // Snap the center to whole texels in light space
+        fit.slice_radius = radius;
+        fit.radius = std::ceil(radius * (1.0f + margin_) * 16.0f) / 16.0f;
+        const float texel_size = 2.0f * fit.radius / float(resolution);
+        fit.center_ls = center_ls;
+        fit.center_ls.x = std::floor(center_ls.x / texel_size) * texel_size;
+        fit.center_ls.y = std::floor(center_ls.y / texel_size) * texel_size;
+
+        // Light looks down -z, near and far cover the margin and every static caster between it and the light
+        float max_z = center_ls.z + fit.radius;
+        float min_z = center_ls.z - fit.radius;
+        if (static_ls.valid()) {
+            max_z = std::max(max_z, static_ls.max.z);
+            min_z = std::min(min_z, static_ls.min.z);
+        }
+        fit.max_z = std::ceil(max_z + 1.0f);
+        fit.min_z = std::floor(min_z - 1.0f);
+        fit.valid = true;
+
+        const glm::mat4 light_projection = glm::ortho(fit.center_ls.x - fit.radius, fit.center_ls.x + fit.radius,
+            fit.center_ls.y - fit.radius, fit.center_ls.y + fit.radius, -fit.max_z, -fit.min_z);
+
+        Cascade& cascade = cascades_[c];
+        cascade.light_space_matrix = light_projection * light_view;
+        cascade.split_far = split_far;
+        cascade.texel_size = texel_size;
+        split_near = split_far;
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "glutils.h"
+#include "frustum.h"
+#include <algorithm>
+
+// Shadow cascades of a directional light fitted to slices of the camera frustum
+// Each slice [split_near, split_far] of view depth is enclosed in a bounding sphere, so the cascade's size
+// does not change as the camera turns, and its light-space origin is snapped to whole shadow map texels,
+// so static shadows don't shimmer while the camera moves. Depth extends to the scene bounds towards the
+// light, which keeps casters outside the slice in the map.
+//
+// The fit is sticky: a cascade covers its slice's sphere plus a margin and keeps its light matrix until the
+// sphere leaves that margin, the light turns or refit is requested. Cached static layers therefore stay valid
+// while the camera moves within the margin, and the same matrix serves the dynamic casters and the lookups.
+class CascadedShadows {
+public:
+    static const int MAX_CASCADES = 4;  // SHADOW_MAX_CASCADES in frame_constants.glsl
+
+    struct Cascade {
+        glm::mat4 light_space_matrix{ 1.0f };  // Light's projection * view
+        float split_far{ 0.0f };               // View depth the cascade ends at
+        float texel_size{ 0.0f };              // World size of one shadow map texel
+    };
+
+    // Refits the cascades whose slice left the covered area for this frame's camera, all of them when refit is set
+    // P is a perspective projection with the given near and far planes, resolution the size of one cascade.
+    // Depth extends to static_bounds (static casters), which must not change without a refit.
+    void Update(const glm::mat4& V, const glm::mat4& P, const float near_plane, const float far_plane,
+        const glm::vec3& light_direction, const AABB& static_bounds, const int resolution, const bool refit);
+
+    const Cascade& cascade(const int index) const { return cascades_[index]; }
+    int count() const { return count_; }
+    float distance() const { return distance_; }
+
+    void set_count(const int count);
+    // Shadows end this far from the camera (or at the far plane)
+    void set_distance(const float distance) { distance_ = distance; }
+    // 0 - uniform splits, 1 - logarithmic splits
+    void set_split_lambda(const float lambda) { split_lambda_ = lambda; }
+    // Covered radius relative to the slice's, the slack the camera has before a cascade is refitted
+    void set_margin(const float margin) { margin_ = std::max(margin, 0.0f); }
+
+private:
+    // Light space fit of one cascade
+    struct Fit {
+        glm::vec3 center_ls{ 0.0f };  // Snapped to texels
+        float radius{ 0.0f };         // Covered, slice radius plus margin
+        float slice_radius{ 0.0f };
+        float min_z{ 0.0f };
+        float max_z{ 0.0f };
+        bool valid{ false };
+    };
+
+    Cascade cascades_[MAX_CASCADES];
+    Fit fits_[MAX_CASCADES];
+    glm::vec3 light_direction_{ 0.0f };
+    int resolution_{ 0 };
+    float margin_{ 0.25f };
+    int count_{ 3 };
+    float distance_{ 120.0f };
+    float split_lambda_{ 0.75f };
+};
@@ -36,4 +36,43 @@ namespace component {
         world_model_matrix = local_model_matrix;
         return world_model_matrix;
     }
+
+    int Mesh::choose_lod(const std::vector<GLMesh>& gl_meshes, const int current, const float pixels_per_unit, const float max_pixel_error) {
+        int lod_count = 1;
+        for (const auto& glmesh : gl_meshes) {
+            lod_count = std::max(lod_count, glmesh.lod_count);
+        }
+
+        int lod = 0;
+        for (int level = 1; level < lod_count; ++level) {
+            // Largest error of the sub-meshes at this level, levels grow coarser so the first miss ends the search
+            float error = 0.0f;
+            for (const auto& glmesh : gl_meshes) {
+                error = std::max(error, glmesh.lod_error[std::min(level, glmesh.lod_count - 1)]);
+            }
+            const float limit = level > current ? max_pixel_error * (1.0f - LOD_HYSTERESIS) : max_pixel_error;
+            if (error * pixels_per_unit > limit) {
+                break;
+            }
+            lod = level;
+        }
+        return lod;
+    }
+
+    void Bounds::update_local(const Mesh& mesh, const Instances* instances) {
+        AABB mesh_box;
+        for (const auto& glmesh : mesh.gl_meshes) {
+            mesh_box.extend(glmesh.bounds_min);
+            mesh_box.extend(glmesh.bounds_max);
+        }
+
+        if (!instances || instances->transforms.empty()) {
+            local = mesh_box;
+            return;
+        }
+        local = AABB();
+        for (const auto& M : instances->transforms) {
+            local.extend(mesh_box.Transform(M));
+        }
+    }
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "glutils.h"
+#include "meshcache.h"
+#include "frustum.h"
 #include <glm/gtx/euler_angles.hpp>
 // In components.h
 namespace component {
@@ -9,6 +11,14 @@ namespace component {
         glm::vec3 scale{ 1.0f };
         glm::mat4 local_model_matrix{ 1.0f };
         glm::mat4 world_model_matrix{ 1.0f };
+        glm::mat3 normal_matrix{ 1.0f };  // Inverse transpose of the world 3x3
+
+        // Maintained by TransformSystem
+        bool world_changed{ true };        // World matrix changed in the last update
+        bool local_valid{ false };         // local_model_matrix matches the cached values below
+        glm::vec3 cached_translation{ 0.0f };
+        glm::vec3 cached_rotation{ 0.0f };
+        glm::vec3 cached_scale{ 1.0f };
 
         // Update local transformation matrix from translation, rotation, scale
         void update_model_matrix();
@@ -17,11 +27,22 @@ namespace component {
         void update_world_matrix(const glm::mat4& parent_world_matrix);
 
         // Recursively calculate world matrix by going up the parent chain
+        // Rendering uses the matrices kept by TransformSystem instead
         glm::mat4 get_world_matrix(entt::registry& registry, entt::entity entity);
     };
 
     struct Mesh {
         std::vector<GLMesh> gl_meshes;  // List of sub-meshes
+        std::shared_ptr<MeshAsset> asset;  // Shared GPU data, keeps gl_meshes alive
+        int lod{ 0 };  // Level of detail drawn, sub-meshes with fewer levels draw their coarsest
+
+        // Switching to a coarser level needs the error this much below the limit, so an object
+        // sitting at a switch distance doesn't alternate between two levels every frame
+        static constexpr float LOD_HYSTERESIS = 0.25f;
+
+        // Coarsest level whose simplification error projects to at most max_pixel_error pixels,
+        // pixels_per_unit is the projected size of one local unit, current the level drawn so far
+        static int choose_lod(const std::vector<GLMesh>& gl_meshes, const int current, const float pixels_per_unit, const float max_pixel_error);
     };
 
     struct Name {
@@ -59,4 +80,53 @@ namespace component {
 
     // Tag component for grass entities (use grass shader with wind animation)
     struct Grass {};
+
+    // Tag component for entities expected to move - their shadows are redrawn every frame
+    // instead of invalidating the cached static shadow map
+    struct Dynamic {};
+
+    // Instanced entity - one mesh drawn many times with a single instanced call per sub-mesh
+    struct Instances {
+        std::vector<glm::mat4> transforms;  // Per-instance model matrices (relative to the entity)
+        GLuint ssbo{ 0 };                   // GPU copy of the per-instance data, sorted by level of detail
+        bool dirty{ true };                 // Re-upload before the next draw
+        std::vector<uint8_t> lods;          // Level of detail per instance, Mesh::choose_lod
+        bool lods_dirty{ false };           // Re-sort the GPU copy before the next draw
+        GLsizei lod_first[GLMesh::MAX_LODS + 1]{};  // Level l is drawn from instances [lod_first[l], lod_first[l + 1])
+
+        GLsizei count() const {
+            return static_cast<GLsizei>(transforms.size());
+        }
+    };
+
+    // Culling volume - local box of all sub-meshes (and instances), world box refit every frame
+    struct Bounds {
+        AABB local;
+        AABB world;
+        int proxy{ -1 };  // Leaf in Rasteriser's DynamicBVH
+
+        // Union of the sub-mesh boxes, transformed by every instance if there are any
+        void update_local(const Mesh& mesh, const Instances* instances = nullptr);
+    };
+
+    // Spawns GPU particles from the shared pool in GPUParticleSystem (rain, dust, smoke, splashes...)
+    // Spawn origin is the entity's world position, or the camera with follow_camera.
+    struct ParticleEmitter {
+        glm::vec3 spawn_min{ 0.0f };      // Spawn box relative to the origin
+        glm::vec3 spawn_max{ 0.0f };
+        glm::vec3 velocity_min{ 0.0f };   // Initial velocity, uniform per component
+        glm::vec3 velocity_max{ 0.0f };
+        glm::vec3 acceleration{ 0.0f };   // Gravity, buoyancy, wind
+        glm::vec4 color{ 1.0f };          // rgb and peak opacity
+        glm::vec2 sprite_falloff{ 1.0f }; // Gaussian falloff of the point sprite per axis, (3, 0.3) is a vertical streak
+        float point_size{ 32.0f };        // Sprite size in pixels at 1 m, clamped to [size/40, size/10]
+        float emit_rate{ 0.0f };          // Particles per second
+        float life_decay{ 1.0f };         // Life lost per second, particles spawn with life 1
+        float kill_z{ -1e30f };           // Particles below this height die
+        float cull_distance{ 100.0f };    // Stops spawning farther than this from the camera
+        bool follow_camera{ false };
+
+        float emit_carry{ 0.0f };  // Fraction of a particle owed from previous frames
+        int slot{ -1 };            // Row in GPUParticleSystem's emitter table
+    };
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 460 core
+#extension GL_ARB_bindless_texture : require
+
+in vec2 tex_coord;
+flat in int material_index;
+
+#include "materials.glsl"
+
+void main(void)
+{
+    // Same alpha cutoff as phong.frag, otherwise cut-out texels would occlude what is behind them
+    // Untextured materials are opaque and skip the fetch
+    Material mat = get_material(material_index);
+    if (mat.tex_diffuse != uvec2(0) && texture(sampler2D(mat.tex_diffuse), tex_coord).a < 0.1) {
+        discard;
+    }
+}
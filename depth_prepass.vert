@@ -0,0 +1,24 @@
+#version 460 core
+
+// Vertex attributes - position for depth, texture coordinates and material for the alpha cutoff
+layout (location = 0) in vec4 in_position_ms;
+layout (location = 3) in vec2 in_tex_coord;
+layout (location = 4) in int in_mat_idx;
+
+#include "frame_constants.glsl"
+#include "draw_data.glsl"
+
+out vec2 tex_coord;
+flat out int material_index;
+
+// Must match phong.vert exactly, the main pass tests against this depth with GL_EQUAL
+invariant gl_Position;
+
+void main(void)
+{
+    vec4 pos_ws = draws[gl_BaseInstance].M * decode_position(in_position_ms, gl_BaseInstance);
+    gl_Position = frame.VP * pos_ws;
+
+    tex_coord = vec2(in_tex_coord.x, 1.0f - in_tex_coord.y);
+    material_index = in_mat_idx + draws[gl_BaseInstance].material_offset.x;
+}
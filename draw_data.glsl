@@ -0,0 +1,19 @@
+// Per-entity data of the multi-draw indirect opaque pass
+// Indexed by gl_BaseInstance - every command of an entity carries the entity's slot as base instance
+// Layout must match Rasteriser::GLDrawData (std430)
+struct DrawData {
+    mat4 M;   // Model matrix
+    mat4 Mn;  // Normal matrix
+    vec4 position_offset;  // Dequantisation of compact vertex positions, zero and one for float vertices
+    vec4 position_scale;
+    ivec4 material_offset;  // x - index of the asset's first material, the vertices' indices are relative to it
+};
+
+layout(std430, binding = 2) readonly buffer Draws {
+    DrawData draws[];
+};
+
+// Object space position of the fetched in_position_ms, the same expression in every pass keeps gl_Position invariant
+vec4 decode_position(const vec4 position_ms, const int draw) {
+    return vec4(draws[draw].position_offset.xyz + position_ms.xyz * draws[draw].position_scale.xyz, 1.0);
+}
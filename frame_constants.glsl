@@ -0,0 +1,20 @@
+// Per-frame constants shared by all programs, written once per frame by FrameConstantsBuffer
+// Layout must match struct FrameConstants in frameconstants.h (std140)
+#define SHADOW_MAX_CASCADES 4
+
+layout(std140, binding = 0) uniform FrameConstants {
+    mat4 V;                   // View matrix
+    mat4 P;                   // Projection matrix
+    mat4 VP;                  // P * V
+    mat4 inv_VP;              // Inverse of View-Projection matrix
+    mat4 light_space_matrices[SHADOW_MAX_CASCADES];  // Light's projection * view matrix per shadow cascade
+    vec4 cascade_splits;      // View depth each cascade ends at
+    vec4 cascade_texel_sizes;  // World size of one shadow map texel per cascade
+    vec4 light_ws;            // xyz - light position
+    vec4 light_color;         // rgb
+    vec4 ambient_color;       // rgb
+    vec4 camera_pos_ws;       // xyz - camera position
+    float time;               // Seconds since start
+    float delta_time;
+    int cascade_count;        // Shadow cascades in use, 1 to SHADOW_MAX_CASCADES
+} frame;
@@ -0,0 +1,21 @@
+#include "frameconstants.h"
+#include <cstring>
+
+int FrameConstantsBuffer::Init() {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment_);
+    return stream_.Init(sizeof(FrameConstants), "frame constants");
+}
+
+void FrameConstantsBuffer::Update(const FrameConstants& constants) {
+    stream_.BeginFrame();
+    const StreamBuffer::Allocation allocation = stream_.Allocate(sizeof(FrameConstants), alignment_);
+    if (!allocation.data) {
+        return;
+    }
+    memcpy(allocation.data, &constants, sizeof(FrameConstants));
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, stream_.buffer(), allocation.offset, sizeof(FrameConstants));
+}
+
+void FrameConstantsBuffer::EndFrame() {
+    stream_.EndFrame();
+}
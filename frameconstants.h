@@ -0,0 +1,43 @@
+#pragma once
+#include "glutils.h"
+#include "streambuffer.h"
+
+// CPU mirror of the FrameConstants block in frame_constants.glsl (std140)
+struct FrameConstants {
+    glm::mat4 V;
+    glm::mat4 P;
+    glm::mat4 VP;
+    glm::mat4 inv_VP;
+    glm::mat4 light_space_matrices[4];  // One per shadow cascade (CascadedShadows::MAX_CASCADES)
+    glm::vec4 cascade_splits;           // View depth each cascade ends at
+    glm::vec4 cascade_texel_sizes;      // World size of one shadow map texel per cascade
+    glm::vec4 light_ws;
+    glm::vec4 light_color;
+    glm::vec4 ambient_color;
+    glm::vec4 camera_pos_ws;
+    float time;
+    float delta_time;
+    GLint cascade_count;
+    float padding;
+};
+static_assert(sizeof(FrameConstants) == 8 * 64 + 6 * 16 + 16, "FrameConstants must match std140 layout");
+
+// Uniform buffer streamed through a StreamBuffer ring, one FrameConstants block per frame
+// Each frame writes the next region and binds it with glBindBufferRange,
+// so the CPU never overwrites constants the GPU is still reading.
+class FrameConstantsBuffer {
+public:
+    static const GLuint BINDING = 0;  // layout(binding = 0) uniform FrameConstants
+
+    int Init();
+
+    // Writes the constants into the current region and binds it to BINDING
+    void Update(const FrameConstants& constants);
+
+    // Fences the current region once all draws using it are submitted
+    void EndFrame();
+
+private:
+    StreamBuffer stream_;
+    GLint alignment_{ 256 };  // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+};
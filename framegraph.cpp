@@ -0,0 +1,343 @@
+#include "framegraph.h"
+#include <iostream>
+#include <algorithm>
+#include <climits>
+
+bool FrameGraph::TextureDesc::operator==(const TextureDesc& other) const {
+    return width == other.width && height == other.height && layers == other.layers && internal_format == other.internal_format &&
+        filter == other.filter && wrap == other.wrap && border_color == other.border_color;
+}
+
+void FrameGraph::PassBuilder::Read(const Resource resource) {
+    graph_.passes_[pass_].reads.push_back(resource);
+}
+
+void FrameGraph::PassBuilder::Write(const Resource resource) {
+    PassNode& pass = graph_.passes_[pass_];
+    pass.writes.push_back(resource);
+    const ResourceNode& node = graph_.resources_[resource];
+    if (pass.render_target == -1 && (node.is_texture || node.backbuffer)) {
+        pass.render_target = resource;
+    }
+}
+
+void FrameGraph::PassBuilder::SideEffect() {
+    graph_.passes_[pass_].side_effect = true;
+}
+
+FrameGraph::~FrameGraph() {
+    Reset();
+}
+
+void FrameGraph::Reset() {
+    for (PhysicalTexture& physical : physical_) {
+        glDeleteFramebuffers(1, &physical.fbo);
+        glDeleteTextures(1, &physical.texture);
+    }
+    for (PassNode& pass : passes_) {
+        if (pass.queries[0][0] != 0) {
+            glDeleteQueries(TIMER_FRAMES * 2, &pass.queries[0][0]);
+        }
+    }
+    physical_.clear();
+    passes_.clear();
+    resources_.clear();
+    order_.clear();
+    frame_ = 0;
+}
+
+FrameGraph::Resource FrameGraph::AddResource(ResourceNode node) {
+    resources_.push_back(std::move(node));
+    return Resource(resources_.size() - 1);
+}
+
+FrameGraph::Resource FrameGraph::ImportTexture(const std::string& name, GLuint texture, GLuint fbo, GLsizei width, GLsizei height) {
+    ResourceNode node;
+    node.name = name;
+    node.imported = true;
+    node.is_texture = true;
+    node.texture = texture;
+    node.fbo = fbo;
+    node.desc.width = width;
+    node.desc.height = height;
+    return AddResource(std::move(node));
+}
+
+FrameGraph::Resource FrameGraph::ImportBuffer(const std::string& name) {
+    ResourceNode node;
+    node.name = name;
+    node.imported = true;
+    return AddResource(std::move(node));
+}
+
+FrameGraph::Resource FrameGraph::CreateTexture(const std::string& name, const TextureDesc& desc) {
+    ResourceNode node;
+    node.name = name;
+    node.is_texture = true;
+    node.desc = desc;
+    return AddResource(std::move(node));
+}
+
+FrameGraph::Resource FrameGraph::Backbuffer() {
+    for (size_t i = 0; i < resources_.size(); ++i) {
+        if (resources_[i].backbuffer) {
+            return Resource(i);
+        }
+    }
+    ResourceNode node;
+    node.name = "Backbuffer";
+    node.imported = true;
+    node.backbuffer = true;
+    return AddResource(std::move(node));
+}
+
+void FrameGraph::SetBackbufferSize(const GLsizei width, const GLsizei height) {
+    backbuffer_width_ = width;
+    backbuffer_height_ = height;
+}
+
+void FrameGraph::AddPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute, Condition run_if) {
+    PassNode pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    pass.run_if = std::move(run_if);
+    passes_.push_back(std::move(pass));
+
+    PassBuilder builder(*this, int(passes_.size() - 1));
+    setup(builder);
+}
+
+int FrameGraph::Compile() {
+    // Single writer per resource, so every read has exactly one producer edge
+    for (ResourceNode& resource : resources_) {
+        resource.writer = -1;
+    }
+    for (size_t p = 0; p < passes_.size(); ++p) {
+        for (const Resource resource : passes_[p].writes) {
+            if (resources_[resource].writer != -1) {
+                printf("Frame graph error: '%s' written by both '%s' and '%s'.\n", resources_[resource].name.c_str(),
+                    passes_[resources_[resource].writer].name.c_str(), passes_[p].name.c_str());
+                return S_FALSE;
+            }
+            resources_[resource].writer = int(p);
+        }
+    }
+
+    // Cull - walk back from the backbuffer writers and side-effect passes through the producers of their inputs
+    std::vector<int> stack;
+    for (size_t p = 0; p < passes_.size(); ++p) {
+        PassNode& pass = passes_[p];
+        pass.culled = true;
+        const bool writes_backbuffer = std::any_of(pass.writes.begin(), pass.writes.end(),
+            [this](const Resource resource) { return resources_[resource].backbuffer; });
+        if (pass.side_effect || writes_backbuffer) {
+            stack.push_back(int(p));
+        }
+    }
+    while (!stack.empty()) {
+        PassNode& pass = passes_[stack.back()];
+        stack.pop_back();
+        if (!pass.culled) continue;
+        pass.culled = false;
+        for (const Resource resource : pass.reads) {
+            if (resources_[resource].writer != -1) {
+                stack.push_back(resources_[resource].writer);
+            }
+        }
+    }
+
+    // Topological order of the survivors, the earliest declared ready pass goes first
+    std::vector<int> pending(passes_.size(), 0);
+    for (size_t p = 0; p < passes_.size(); ++p) {
+        for (const Resource resource : passes_[p].reads) {
+            const int writer = resources_[resource].writer;
+            if (writer != -1 && writer != int(p) && !passes_[p].culled) {
+                ++pending[p];
+            }
+        }
+    }
+    order_.clear();
+    std::vector<bool> done(passes_.size(), false);
+    size_t survivors = std::count_if(passes_.begin(), passes_.end(), [](const PassNode& pass) { return !pass.culled; });
+    while (order_.size() < survivors) {
+        int next = -1;
+        for (size_t p = 0; p < passes_.size() && next == -1; ++p) {
+            if (!passes_[p].culled && !done[p] && pending[p] == 0) {
+                next = int(p);
+            }
+        }
+        if (next == -1) {
+            printf("Frame graph error: Cycle between passes.\n");
+            return S_FALSE;
+        }
+        done[next] = true;
+        order_.push_back(next);
+        for (size_t p = 0; p < passes_.size(); ++p) {
+            if (passes_[p].culled || int(p) == next) continue;
+            for (const Resource resource : passes_[p].reads) {
+                if (resources_[resource].writer == next) {
+                    --pending[p];
+                }
+            }
+        }
+    }
+
+    // Transient lifetimes in execution order
+    std::vector<int> first_use(resources_.size(), INT_MAX);
+    std::vector<int> last_use(resources_.size(), -1);
+    for (int i = 0; i < int(order_.size()); ++i) {
+        const PassNode& pass = passes_[order_[i]];
+        for (const auto* list : { &pass.reads, &pass.writes }) {
+            for (const Resource resource : *list) {
+                first_use[resource] = std::min(first_use[resource], i);
+                last_use[resource] = std::max(last_use[resource], i);
+            }
+        }
+    }
+
+    // Alias - a transient takes over the texture of one whose lifetime already ended
+    std::vector<int> free_until(physical_.size(), -1);  // Physical texture busy up to this order index
+    int transient_count = 0;
+    for (int i = 0; i < int(order_.size()); ++i) {
+        for (size_t r = 0; r < resources_.size(); ++r) {
+            ResourceNode& resource = resources_[r];
+            if (resource.imported || !resource.is_texture || first_use[r] != i) continue;
+            ++transient_count;
+
+            resource.physical = -1;
+            for (size_t t = 0; t < physical_.size(); ++t) {
+                if (free_until[t] < i && physical_[t].desc == resource.desc) {
+                    resource.physical = int(t);
+                    break;
+                }
+            }
+            if (resource.physical == -1) {
+                PhysicalTexture physical;
+                physical.desc = resource.desc;
+                if (resource.desc.layers > 0) {
+                    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &physical.texture);
+                    glTextureStorage3D(physical.texture, 1, resource.desc.internal_format, resource.desc.width, resource.desc.height,
+                        resource.desc.layers);
+                }
+                else {
+                    glCreateTextures(GL_TEXTURE_2D, 1, &physical.texture);
+                    glTextureStorage2D(physical.texture, 1, resource.desc.internal_format, resource.desc.width, resource.desc.height);
+                }
+                glTextureParameteri(physical.texture, GL_TEXTURE_MIN_FILTER, resource.desc.filter);
+                glTextureParameteri(physical.texture, GL_TEXTURE_MAG_FILTER, resource.desc.filter);
+                glTextureParameteri(physical.texture, GL_TEXTURE_WRAP_S, resource.desc.wrap);
+                glTextureParameteri(physical.texture, GL_TEXTURE_WRAP_T, resource.desc.wrap);
+                glTextureParameterfv(physical.texture, GL_TEXTURE_BORDER_COLOR, glm::value_ptr(resource.desc.border_color));
+
+                const bool depth = resource.desc.internal_format == GL_DEPTH_COMPONENT16 || resource.desc.internal_format == GL_DEPTH_COMPONENT24 ||
+                    resource.desc.internal_format == GL_DEPTH_COMPONENT32F;
+                glCreateFramebuffers(1, &physical.fbo);
+                glNamedFramebufferTexture(physical.fbo, depth ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0, physical.texture, 0);
+                if (depth) {
+                    glNamedFramebufferDrawBuffer(physical.fbo, GL_NONE);
+                    glNamedFramebufferReadBuffer(physical.fbo, GL_NONE);
+                }
+                if (glCheckNamedFramebufferStatus(physical.fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                    printf("Frame graph error: Render target '%s' is incomplete.\n", resource.name.c_str());
+                }
+
+                physical_.push_back(physical);
+                free_until.push_back(-1);
+                resource.physical = int(physical_.size() - 1);
+            }
+            free_until[resource.physical] = last_use[r];
+            resource.texture = physical_[resource.physical].texture;
+            resource.fbo = physical_[resource.physical].fbo;
+        }
+    }
+
+    for (PassNode& pass : passes_) {
+        if (!pass.culled && pass.queries[0][0] == 0) {
+            glGenQueries(TIMER_FRAMES * 2, &pass.queries[0][0]);
+        }
+    }
+
+    std::cout << "Frame graph: " << order_.size() << " of " << passes_.size() << " passes, "
+        << transient_count << " transient targets in " << physical_.size() << " textures" << std::endl;
+    for (const int p : order_) {
+        std::cout << "  " << passes_[p].name << std::endl;
+    }
+    return S_OK;
+}
+
+void FrameGraph::ReadTimers(PassNode& pass, const int slot) {
+    if (!pass.query_pending[slot]) {
+        return;
+    }
+    GLint available = 0;
+    glGetQueryObjectiv(pass.queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;  // Keep the previous estimate rather than stall
+    }
+    GLuint64 begin = 0, end = 0;
+    glGetQueryObjectui64v(pass.queries[slot][0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(pass.queries[slot][1], GL_QUERY_RESULT, &end);
+    pass.gpu_ms = 0.9 * pass.gpu_ms + 0.1 * double(end - begin) * 1e-6;
+    pass.query_pending[slot] = false;
+}
+
+void FrameGraph::Execute() {
+    using clock = std::chrono::high_resolution_clock;
+    const int slot = frame_++ % TIMER_FRAMES;
+
+    for (const int p : order_) {
+        PassNode& pass = passes_[p];
+        ReadTimers(pass, slot);
+
+        pass.ran = !pass.run_if || pass.run_if();
+        if (!pass.ran) {
+            continue;
+        }
+
+        // A slot whose result hasn't arrived yet isn't reissued, that would overwrite it; this frame goes untimed
+        const bool timed = !pass.query_pending[slot];
+        const auto start = clock::now();
+        if (timed) {
+            glQueryCounter(pass.queries[slot][0], GL_TIMESTAMP);
+        }
+
+        if (pass.render_target != -1) {
+            const ResourceNode& target = resources_[pass.render_target];
+            if (target.backbuffer) {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, backbuffer_width_, backbuffer_height_);
+            }
+            else {
+                glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+                glViewport(0, 0, target.desc.width, target.desc.height);
+            }
+        }
+
+        pass.execute(*this);
+
+        if (timed) {
+            glQueryCounter(pass.queries[slot][1], GL_TIMESTAMP);
+            pass.query_pending[slot] = true;
+        }
+        pass.cpu_ms = 0.9 * pass.cpu_ms + 0.1 * std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, backbuffer_width_, backbuffer_height_);
+}
+
+GLuint FrameGraph::texture(const Resource resource) const {
+    return resources_[resource].texture;
+}
+
+GLuint FrameGraph::framebuffer(const Resource resource) const {
+    return resources_[resource].fbo;
+}
+
+void FrameGraph::PrintTimings() const {
+    std::cout << "Frame graph timings (CPU / GPU ms):" << std::endl;
+    for (const int p : order_) {
+        const PassNode& pass = passes_[p];
+        printf("  %-20s %7.3f / %7.3f%s\n", pass.name.c_str(), pass.cpu_ms, pass.gpu_ms, pass.ran ? "" : "  (skipped)");
+    }
+}
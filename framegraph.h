@@ -0,0 +1,124 @@
+#pragma once
+#include "glutils.h"
+#include <functional>
+#include <chrono>
+
+// Declarative description of a frame as passes over resources
+// Passes declare what they read and write; Compile() then
+//  - orders them topologically (declaration order breaks ties),
+//  - culls passes whose results never reach the backbuffer or a side-effect pass,
+//  - allocates transient render targets and lets targets with disjoint lifetimes share one texture.
+// Execute() runs the surviving passes, skipping those whose run_if condition is false this frame
+// (their outputs keep last frame's contents), binds each pass's render target and viewport, and
+// measures CPU and GPU (timestamp query) time per pass.
+class FrameGraph {
+public:
+    using Resource = int;
+
+    // Transient render target, created and aliased by the graph
+    struct TextureDesc {
+        GLsizei width{ 0 };
+        GLsizei height{ 0 };
+        GLsizei layers{ 0 };  // 0 - 2D texture, otherwise a 2D array attached layered to the pass's FBO
+        GLenum internal_format{ GL_RGBA8 };
+        GLenum filter{ GL_LINEAR };
+        GLenum wrap{ GL_CLAMP_TO_EDGE };
+        glm::vec4 border_color{ 0.0f };
+
+        bool operator==(const TextureDesc& other) const;
+    };
+
+    class PassBuilder {
+    public:
+        void Read(const Resource resource);
+        // The first written texture is the pass's render target
+        void Write(const Resource resource);
+        // Kept even if nothing reads its outputs
+        void SideEffect();
+
+    private:
+        friend class FrameGraph;
+        PassBuilder(FrameGraph& graph, const int pass) : graph_(graph), pass_(pass) {}
+        FrameGraph& graph_;
+        int pass_;
+    };
+
+    using SetupFunction = std::function<void(PassBuilder&)>;
+    using ExecuteFunction = std::function<void(const FrameGraph&)>;
+    using Condition = std::function<bool()>;
+
+    static const int TIMER_FRAMES = 3;  // GPU timestamps are read this many frames late, so they never stall
+
+    FrameGraph() = default;
+    ~FrameGraph();
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    // Texture owned elsewhere that persists across frames (e.g. a cached shadow map), fbo renders into it
+    Resource ImportTexture(const std::string& name, GLuint texture, GLuint fbo, GLsizei width, GLsizei height);
+    // GPU state owned elsewhere (e.g. simulation SSBOs), only tracked for ordering and culling
+    Resource ImportBuffer(const std::string& name);
+    Resource CreateTexture(const std::string& name, const TextureDesc& desc);
+    // Default framebuffer, passes writing it are never culled
+    Resource Backbuffer();
+    void SetBackbufferSize(const GLsizei width, const GLsizei height);
+
+    void AddPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute, Condition run_if = nullptr);
+    // Releases all passes, resources and transient textures so the graph can be built again
+    void Reset();
+
+    // Returns S_OK, or S_FALSE on a cycle or a resource written by more than one pass
+    int Compile();
+    void Execute();
+
+    // Valid while executing
+    GLuint texture(const Resource resource) const;
+    GLuint framebuffer(const Resource resource) const;
+
+    void PrintTimings() const;
+
+private:
+    struct ResourceNode {
+        std::string name;
+        bool imported{ false };
+        bool backbuffer{ false };
+        bool is_texture{ false };
+        TextureDesc desc;
+        GLuint texture{ 0 };
+        GLuint fbo{ 0 };
+        int writer{ -1 };
+        int physical{ -1 };  // Index into physical_, transient textures only
+    };
+    struct PassNode {
+        std::string name;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        bool side_effect{ false };
+        bool culled{ false };
+        ExecuteFunction execute;
+        Condition run_if;
+        Resource render_target{ -1 };
+
+        GLuint queries[TIMER_FRAMES][2]{};
+        bool query_pending[TIMER_FRAMES]{};
+        double cpu_ms{ 0.0 };  // Smoothed
+        double gpu_ms{ 0.0 };
+        bool ran{ false };  // Last frame
+    };
+    struct PhysicalTexture {
+        TextureDesc desc;
+        GLuint texture{ 0 };
+        GLuint fbo{ 0 };
+    };
+
+    Resource AddResource(ResourceNode node);
+    void ReadTimers(PassNode& pass, const int slot);
+
+    std::vector<ResourceNode> resources_;
+    std::vector<PassNode> passes_;
+    std::vector<int> order_;  // Surviving passes in execution order
+    std::vector<PhysicalTexture> physical_;
+    GLsizei backbuffer_width_{ 0 };
+    GLsizei backbuffer_height_{ 0 };
+    int frame_{ 0 };
+};
@@ -0,0 +1,89 @@
+#include "frustum.h"
+#include <algorithm>
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_SSE
+#endif
+
+AABB AABB::Transform(const glm::mat4& M) const {
+    AABB result;
+    if (!valid()) {
+        return result;
+    }
+    // Start from the translation and add the extreme contribution of every matrix element
+    result.min = result.max = glm::vec3(M[3]);
+    for (int column = 0; column < 3; ++column) {
+        for (int row = 0; row < 3; ++row) {
+            const float a = M[column][row] * min[column];
+            const float b = M[column][row] * max[column];
+            result.min[row] += std::min(a, b);
+            result.max[row] += std::max(a, b);
+        }
+    }
+    return result;
+}
+
+Frustum::Frustum(const glm::mat4& VP) {
+    // Gribb-Hartmann: planes are sums/differences of the 4th row with rows 0..2
+    const glm::vec4 row0(VP[0][0], VP[1][0], VP[2][0], VP[3][0]);
+    const glm::vec4 row1(VP[0][1], VP[1][1], VP[2][1], VP[3][1]);
+    const glm::vec4 row2(VP[0][2], VP[1][2], VP[2][2], VP[3][2]);
+    const glm::vec4 row3(VP[0][3], VP[1][3], VP[2][3], VP[3][3]);
+    const glm::vec4 planes[6] = {
+        row3 + row0, row3 - row0,  // left, right
+        row3 + row1, row3 - row1,  // bottom, top
+        row3 + row2, row3 - row2   // near, far
+    };
+
+    for (int i = 0; i < 6; ++i) {
+        const float length = glm::length(glm::vec3(planes[i]));
+        const glm::vec4 plane = length > 0.0f ? planes[i] / length : planes[i];
+        nx_[i] = plane.x;
+        ny_[i] = plane.y;
+        nz_[i] = plane.z;
+        d_[i] = plane.w;
+    }
+    // Padding planes: zero normal, positive distance - every box is inside
+    d_[6] = d_[7] = 1.0f;
+}
+
+Frustum::Result Frustum::Test(const AABB& box) const {
+    const glm::vec3 c = box.center();
+    const glm::vec3 e = box.extents();
+
+#ifdef FRUSTUM_SSE
+    const __m128 cx = _mm_set1_ps(c.x), cy = _mm_set1_ps(c.y), cz = _mm_set1_ps(c.z);
+    const __m128 ex = _mm_set1_ps(e.x), ey = _mm_set1_ps(e.y), ez = _mm_set1_ps(e.z);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 zero = _mm_setzero_ps();
+
+    int intersecting = 0;
+    for (int i = 0; i < 8; i += 4) {
+        const __m128 nx = _mm_load_ps(nx_ + i);
+        const __m128 ny = _mm_load_ps(ny_ + i);
+        const __m128 nz = _mm_load_ps(nz_ + i);
+        // Signed distance of the box center and projected radius of the box, 4 planes at once
+        const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)),
+            _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(d_ + i)));
+        const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(nx, abs_mask), ex),
+            _mm_mul_ps(_mm_and_ps(ny, abs_mask), ey)), _mm_mul_ps(_mm_and_ps(nz, abs_mask), ez));
+
+        if (_mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero)) != 0) {
+            return OUTSIDE;
+        }
+        intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius), zero));
+    }
+    return intersecting ? INTERSECTS : INSIDE;
+#else
+    bool intersecting = false;
+    for (int i = 0; i < 6; ++i) {
+        const float distance = nx_[i] * c.x + ny_[i] * c.y + nz_[i] * c.z + d_[i];
+        const float radius = std::abs(nx_[i]) * e.x + std::abs(ny_[i]) * e.y + std::abs(nz_[i]) * e.z;
+        if (distance + radius < 0.0f) {
+            return OUTSIDE;
+        }
+        intersecting |= distance - radius < 0.0f;
+    }
+    return intersecting ? INTERSECTS : INSIDE;
+#endif
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "glutils.h"
+#include <cfloat>
+
+// Axis aligned bounding box
+struct AABB {
+    glm::vec3 min{ FLT_MAX };
+    glm::vec3 max{ -FLT_MAX };
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return 0.5f * (min + max); }
+    glm::vec3 extents() const { return 0.5f * (max - min); }
+    float surface_area() const {
+        const glm::vec3 d = max - min;
+        return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+    bool contains(const AABB& other) const {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+
+    void extend(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    void extend(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    static AABB Union(const AABB& a, const AABB& b) {
+        AABB result = a;
+        result.extend(b);
+        return result;
+    }
+
+    // Box enclosing this box after the transformation (Arvo)
+    AABB Transform(const glm::mat4& M) const;
+};
+
+// Six clip planes of a view-projection matrix, stored SoA for the SSE box test
+class Frustum {
+public:
+    enum Result { OUTSIDE, INTERSECTS, INSIDE };
+
+    Frustum() = default;
+    // Planes of -w <= x, y, z <= w (GL_NEGATIVE_ONE_TO_ONE clip space)
+    explicit Frustum(const glm::mat4& VP);
+
+    Result Test(const AABB& box) const;
+    bool Intersects(const AABB& box) const { return Test(box) != OUTSIDE; }
+
+private:
+    // Two groups of four planes, planes 6 and 7 are padding that never rejects
+    alignas(16) float nx_[8]{};
+    alignas(16) float ny_[8]{};
+    alignas(16) float nz_[8]{};
+    alignas(16) float d_[8]{};
+};
@@ -0,0 +1,251 @@
+#include "geometrypool.h"
+#include <iostream>
+#include <vector>
+#include <glm/gtc/packing.hpp>
+
+RangeAllocator::RangeAllocator(size_t capacity) {
+    Grow(capacity);
+}
+
+size_t RangeAllocator::Allocate(size_t count) {
+    for (auto it = free_.begin(); it != free_.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+        const size_t first = it->first;
+        const size_t remaining = it->second - count;
+        free_.erase(it);
+        if (remaining > 0) {
+            free_[first + count] = remaining;
+        }
+        used_ += count;
+        return first;
+    }
+    return INVALID;
+}
+
+void RangeAllocator::Free(size_t first, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    used_ -= count;
+
+    auto next = free_.lower_bound(first);
+    // Merge with the following block
+    if (next != free_.end() && first + count == next->first) {
+        count += next->second;
+        next = free_.erase(next);
+    }
+    // Merge with the preceding block
+    if (next != free_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == first) {
+            prev->second += count;
+            return;
+        }
+    }
+    free_[first] = count;
+}
+
+void RangeAllocator::Grow(size_t new_capacity) {
+    if (new_capacity <= capacity_) {
+        return;
+    }
+    const size_t old_capacity = capacity_;
+    capacity_ = new_capacity;
+    used_ += new_capacity - old_capacity;  // Free() below subtracts it again
+    Free(old_capacity, new_capacity - old_capacity);
+}
+
+GeometryPool::GeometryPool(size_t vertex_capacity, size_t index_capacity, VertexFormat format)
+    : vertices_(vertex_capacity), indices_(index_capacity), format_(format) {
+    vbo_ = CreateBuffer(vertex_capacity * vertex_size());
+    ebo_ = CreateBuffer(index_capacity * sizeof(GLuint));
+
+    // Same attribute layout as the former per-mesh VAOs, described once with DSA
+    glCreateVertexArrays(1, &vao_);
+    glVertexArrayVertexBuffer(vao_, 0, vbo_, 0, GLsizei(vertex_size()));
+    glVertexArrayElementBuffer(vao_, ebo_);
+
+    if (format_ == VertexFormat::COMPACT) {
+        // Same locations and shader inputs, the fetch unit expands the packed types
+        glVertexArrayAttribFormat(vao_, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, position));
+        glVertexArrayAttribFormat(vao_, 1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(CompactVertex, normal));
+        glVertexArrayAttribFormat(vao_, 2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(CompactVertex, tangent));
+        glVertexArrayAttribFormat(vao_, 3, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactVertex, tex_coord));
+        glVertexArrayAttribIFormat(vao_, 4, 1, GL_SHORT, offsetof(CompactVertex, mat_idx));
+    }
+    else {
+        // vertex position
+        glVertexArrayAttribFormat(vao_, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        // vertex normal
+        glVertexArrayAttribFormat(vao_, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+        // vector tangent
+        glVertexArrayAttribFormat(vao_, 2, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, tangent));
+        glVertexArrayAttribFormat(vao_, 3, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, tex_coord));
+        glVertexArrayAttribIFormat(vao_, 4, 1, GL_INT, offsetof(Vertex, mat_idx));
+    }
+    for (GLuint attribute = 0; attribute < 5; ++attribute) {
+        glVertexArrayAttribBinding(vao_, attribute, 0);
+        glEnableVertexArrayAttrib(vao_, attribute);
+    }
+}
+
+GeometryPool::~GeometryPool() {
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &vbo_);
+    glDeleteBuffers(1, &ebo_);
+}
+
+GLuint GeometryPool::CreateBuffer(size_t size) {
+    GLuint buffer = 0;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, std::max<size_t>(size, 1), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    return buffer;
+}
+
+GLuint GeometryPool::GrowBuffer(GLuint buffer, size_t old_size, size_t new_size) {
+    GLuint new_buffer = CreateBuffer(new_size);
+    glCopyNamedBufferSubData(buffer, new_buffer, 0, 0, old_size);
+    glDeleteBuffers(1, &buffer);
+    return new_buffer;
+}
+
+void GeometryPool::Reserve(RangeAllocator& allocator, size_t count) {
+    size_t new_capacity = std::max<size_t>(allocator.capacity(), 1024);
+    while (new_capacity < allocator.capacity() + count) {
+        new_capacity *= 2;
+    }
+
+    if (&allocator == &vertices_) {
+        vbo_ = GrowBuffer(vbo_, allocator.capacity() * vertex_size(), new_capacity * vertex_size());
+        glVertexArrayVertexBuffer(vao_, 0, vbo_, 0, GLsizei(vertex_size()));
+    }
+    else {
+        ebo_ = GrowBuffer(ebo_, allocator.capacity() * sizeof(GLuint), new_capacity * sizeof(GLuint));
+        glVertexArrayElementBuffer(vao_, ebo_);
+    }
+    allocator.Grow(new_capacity);
+}
+
+int GeometryPool::Allocate(const void* vertices, size_t vertex_count, const void* indices, size_t index_count, GLMesh& glmesh,
+    const glm::vec3& quantization_min, const glm::vec3& quantization_max) {
+    const bool compact = format_ == VertexFormat::COMPACT;
+    const bool short_indices = compact && vertex_count <= 65536;
+    const size_t slot_count = short_indices ? (index_count + 1) / 2 : index_count;
+
+    size_t first_vertex = vertices_.Allocate(vertex_count);
+    if (first_vertex == RangeAllocator::INVALID) {
+        Reserve(vertices_, vertex_count);
+        first_vertex = vertices_.Allocate(vertex_count);
+    }
+    size_t first_slot = indices_.Allocate(slot_count);
+    if (first_slot == RangeAllocator::INVALID) {
+        Reserve(indices_, slot_count);
+        first_slot = indices_.Allocate(slot_count);
+    }
+    if (first_vertex == RangeAllocator::INVALID || first_slot == RangeAllocator::INVALID) {
+        // Whichever range did succeed goes back
+        if (first_vertex != RangeAllocator::INVALID) {
+            vertices_.Free(first_vertex, vertex_count);
+        }
+        if (first_slot != RangeAllocator::INVALID) {
+            indices_.Free(first_slot, slot_count);
+        }
+        std::cout << "ERROR: Geometry pool allocation failed!" << std::endl;
+        return S_FALSE;
+    }
+
+    glmesh.position_offset = glm::vec3(0.0f);
+    glmesh.position_scale = glm::vec3(1.0f);
+    if (compact) {
+        // A flat axis still gets a non-zero step, UNORM16 then encodes 0 for it
+        glmesh.position_offset = quantization_min;
+        glmesh.position_scale = glm::max(quantization_max - quantization_min, glm::vec3(1e-6f));
+        const glm::vec3 to_unorm = 65535.0f / glmesh.position_scale;
+
+        const Vertex* source = static_cast<const Vertex*>(vertices);
+        glm::vec2 uv_shift(0.0f);
+        if (vertex_count > 0) {
+            glm::vec2 uv_min(reinterpret_cast<const float*>(&source[0].tex_coord)[0], reinterpret_cast<const float*>(&source[0].tex_coord)[1]);
+            for (size_t i = 1; i < vertex_count; ++i) {
+                const float* uv = reinterpret_cast<const float*>(&source[i].tex_coord);
+                uv_min = glm::min(uv_min, glm::vec2(uv[0], uv[1]));
+            }
+            uv_shift = glm::floor(uv_min);  // Invisible with repeating samplers, half floats are finest near 0
+        }
+
+        std::vector<CompactVertex> packed(vertex_count);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            const Vertex& v = source[i];
+            CompactVertex& c = packed[i];
+            const glm::vec3 position = v.position;
+            const glm::vec3 q = glm::clamp((position - quantization_min) * to_unorm + 0.5f, glm::vec3(0.0f), glm::vec3(65535.0f));
+            c.position[0] = uint16_t(q.x);
+            c.position[1] = uint16_t(q.y);
+            c.position[2] = uint16_t(q.z);
+            c.mat_idx = int16_t(v.mat_idx.x);
+            const float* normal = reinterpret_cast<const float*>(&v.normal);
+            const float* tangent = reinterpret_cast<const float*>(&v.tangent);
+            const float* uv = reinterpret_cast<const float*>(&v.tex_coord);
+            c.normal = glm::packSnorm3x10_1x2(glm::vec4(normal[0], normal[1], normal[2], 0.0f));
+            c.tangent = glm::packSnorm3x10_1x2(glm::vec4(tangent[0], tangent[1], tangent[2], 0.0f));
+            c.tex_coord[0] = glm::packHalf1x16(uv[0] - uv_shift.x);
+            c.tex_coord[1] = glm::packHalf1x16(uv[1] - uv_shift.y);
+        }
+        glNamedBufferSubData(vbo_, first_vertex * sizeof(CompactVertex), vertex_count * sizeof(CompactVertex), packed.data());
+    }
+    else {
+        glNamedBufferSubData(vbo_, first_vertex * sizeof(Vertex), vertex_count * sizeof(Vertex), vertices);
+    }
+
+    if (short_indices) {
+        // Indices are relative to base_vertex, so any sub-mesh below 64k vertices fits
+        const GLuint* source = static_cast<const GLuint*>(indices);
+        std::vector<uint16_t> packed(slot_count * 2, 0);
+        for (size_t i = 0; i < index_count; ++i) {
+            packed[i] = uint16_t(source[i]);
+        }
+        glNamedBufferSubData(ebo_, first_slot * sizeof(GLuint), slot_count * sizeof(GLuint), packed.data());
+        short_index_count_ += index_count;
+        short_slot_count_ += slot_count;
+    }
+    else {
+        glNamedBufferSubData(ebo_, first_slot * sizeof(GLuint), index_count * sizeof(GLuint), indices);
+    }
+
+    glmesh.vao = vao_;
+    glmesh.index_type = short_indices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    glmesh.first_index = GLuint(short_indices ? first_slot * 2 : first_slot);
+    glmesh.index_count = GLsizei(index_count);
+    glmesh.pool_index_count = GLsizei(index_count);
+    glmesh.lod_count = 1;
+    glmesh.lod_first_index[0] = glmesh.first_index;
+    glmesh.lod_index_count[0] = glmesh.index_count;
+    glmesh.base_vertex = GLint(first_vertex);
+    glmesh.vertex_count = GLsizei(vertex_count);
+    return S_OK;
+}
+
+void GeometryPool::Free(const GLMesh& glmesh) {
+    vertices_.Free(glmesh.base_vertex, glmesh.vertex_count);
+    if (glmesh.index_type == GL_UNSIGNED_SHORT) {
+        const size_t slot_count = (size_t(glmesh.pool_index_count) + 1) / 2;
+        indices_.Free(glmesh.first_index / 2, slot_count);
+        short_index_count_ -= glmesh.pool_index_count;
+        short_slot_count_ -= slot_count;
+    }
+    else {
+        indices_.Free(glmesh.first_index, glmesh.pool_index_count);
+    }
+}
+
+void GeometryPool::PrintStats() const {
+    const size_t vertex_bytes = vertices_.used() * vertex_size();
+    const size_t index_bytes = indices_.used() * sizeof(GLuint);
+    const size_t float_bytes = vertices_.used() * sizeof(Vertex) + (indices_.used() - short_slot_count_ + short_index_count_) * sizeof(GLuint);
+    std::cout << "Geometry pool: " << vertices_.used() << " vertices in " << vertex_bytes / 1024 << " KiB, "
+        << index_bytes / 1024 << " KiB of indices (" << short_index_count_ << " of them 16-bit), "
+        << float(float_bytes) / float(std::max<size_t>(vertex_bytes + index_bytes, 1)) << "x smaller than float vertices with 32-bit indices"
+        << std::endl;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "glutils.h"
+#include <map>
+#include <cstdint>
+
+// First-fit allocator of element ranges, free blocks are coalesced on release
+class RangeAllocator {
+public:
+    static const size_t INVALID = size_t(-1);
+
+    explicit RangeAllocator(size_t capacity = 0);
+
+    // Returns the first element of the block or INVALID if no free block is large enough
+    size_t Allocate(size_t count);
+    void Free(size_t first, size_t count);
+    // Appends [capacity, new_capacity) to the free list
+    void Grow(size_t new_capacity);
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_; }
+
+private:
+    std::map<size_t, size_t> free_;  // first -> count
+    size_t capacity_{ 0 };
+    size_t used_{ 0 };
+};
+
+// Shared vertex and index buffers for all static meshes with a single VAO
+// Sub-meshes are suballocated, GLMesh::first_index and base_vertex locate them,
+// so any number of meshes can be drawn with one glMultiDrawElementsIndirect.
+// Buffers grow by doubling (GPU side copy), the VAO is rebound to the new storage.
+//
+// The COMPACT format stores CompactVertex instead of Vertex and sub-meshes with at most 65536 vertices get
+// 16-bit indices. Those live in the same index buffer, two per 32-bit slot, so one VAO still serves all meshes;
+// GLMesh::index_type tells which type first_index and the draw counts are in.
+class GeometryPool {
+public:
+    enum class VertexFormat {
+        FLOAT,    // Vertex as MeshLoader emits it
+        COMPACT   // CompactVertex, decoded in the vertex shaders with GLMesh::position_offset/position_scale
+    };
+
+    // 20 bytes against 48 of Vertex
+    struct CompactVertex {
+        uint16_t position[3];  // UNORM16 inside the quantisation box passed to Allocate()
+        int16_t mat_idx;
+        uint32_t normal;       // SNORM 10-10-10-2 (GL_INT_2_10_10_10_REV)
+        uint32_t tangent;
+        uint16_t tex_coord[2]; // Half floats, shifted by a whole number per sub-mesh to keep precision
+    };
+
+    GeometryPool(size_t vertex_capacity, size_t index_capacity, VertexFormat format = VertexFormat::FLOAT);
+    ~GeometryPool();
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    // Copies Vertex/GLuint index data into the pool and fills the range of glmesh, returns S_OK or S_FALSE
+    // Compact positions are quantised to [quantization_min, quantization_max], which must be the same for all
+    // sub-meshes drawn with one model matrix (the whole asset's bounds).
+    int Allocate(const void* vertices, size_t vertex_count, const void* indices, size_t index_count, GLMesh& glmesh,
+        const glm::vec3& quantization_min = glm::vec3(0.0f), const glm::vec3& quantization_max = glm::vec3(0.0f));
+    void Free(const GLMesh& glmesh);
+
+    GLuint vao() const { return vao_; }
+    GLuint vbo() const { return vbo_; }
+    GLuint ebo() const { return ebo_; }
+
+    size_t vertex_count() const { return vertices_.used(); }
+    size_t index_count() const { return indices_.used(); }  // 32-bit slots
+    VertexFormat format() const { return format_; }
+    size_t vertex_size() const { return format_ == VertexFormat::COMPACT ? sizeof(CompactVertex) : sizeof(Vertex); }
+
+    // Bytes in use against what the same meshes take as Vertex and 32-bit indices
+    void PrintStats() const;
+
+private:
+    static GLuint CreateBuffer(size_t size);
+    static GLuint GrowBuffer(GLuint buffer, size_t old_size, size_t new_size);
+    void Reserve(RangeAllocator& allocator, size_t count);
+
+    GLuint vao_{ 0 };
+    GLuint vbo_{ 0 };
+    GLuint ebo_{ 0 };
+    RangeAllocator vertices_;
+    RangeAllocator indices_;
+    VertexFormat format_;
+    size_t short_index_count_{ 0 };  // Live 16-bit indices
+    size_t short_slot_count_{ 0 };   // 32-bit slots they take
+};
@@ -28,12 +28,29 @@
 struct GLMesh
 {
 public:
-    GLuint vao{ 0 };
+    GLuint vao{ 0 }; // shared VAO of the GeometryPool the mesh lives in
 
+    // range inside the pool's vertex and index buffers
+    GLuint first_index{ 0 };
+    GLint base_vertex{ 0 };
+    GLsizei vertex_count{ 0 };
+    GLenum index_type{ GL_UNSIGNED_INT }; // GL_UNSIGNED_SHORT in a compact pool, first_index and counts are in this type
+    // Object space position = position_offset + fetched position * position_scale, identity for float vertices
+    glm::vec3 position_offset{ 0.0f };
+    glm::vec3 position_scale{ 1.0f };
+    GLint material_offset{ 0 }; // index of the asset's first material, added to the vertices' asset relative indices
+    GLsizei index_count{ 0 }; // element count passed to glDrawElements
+    glm::vec3 bounds_min{ 0.0f }; // local space AABB
+    glm::vec3 bounds_max{ 0.0f };
 
-    GLuint vbo{ 0 };
-    GLuint ebo{ 0 }; // optional buffer of indices
-    std::shared_ptr<TriangularMesh> mesh;
+    // Levels of detail (meshsimplify), index ranges over the same vertices following level 0 in the pool
+    // Level 0 is first_index/index_count, lod_error the simplification error in local units
+    static const int MAX_LODS = 4;
+    int lod_count{ 1 };
+    GLuint lod_first_index[MAX_LODS]{};
+    GLsizei lod_index_count[MAX_LODS]{};
+    float lod_error[MAX_LODS]{};
+    GLsizei pool_index_count{ 0 }; // indices allocated in the pool, all levels
 };
 
 bool check_gl( const GLenum error = glGetError() );
@@ -0,0 +1,325 @@
+#include "gpuparticles.h"
+#include <iostream>
+#include <numeric>
+#include <algorithm>
+#include <cstring>
+
+GPUParticleSystem::GPUParticleSystem() {
+    emitters_.resize(MAX_EMITTERS, Emitter{});
+    free_slots_.reserve(MAX_EMITTERS);
+    released_slots_.reserve(MAX_EMITTERS);
+    for (int slot = MAX_EMITTERS - 1; slot >= 0; --slot) {
+        free_slots_.push_back(slot);
+    }
+}
+
+GPUParticleSystem::~GPUParticleSystem() {
+    if (vao_ != 0) {
+        const GLuint buffers[] = { particles_ssbo_, dead_list_ssbo_, alive_list_ssbo_, counters_buffer_ };
+        glDeleteBuffers(4, buffers);
+        glDeleteVertexArrays(1, &vao_);
+    }
+}
+
+int GPUParticleSystem::Init(const size_t capacity) {
+    if (begin_program_.LoadCompute("particles_begin.comp") != S_OK ||
+        emit_program_.LoadCompute("particles_emit.comp") != S_OK ||
+        simulate_program_.LoadCompute("particles_simulate.comp") != S_OK) {
+        return S_FALSE;
+    }
+    if (emitter_stream_.Init(sizeof(Emitter) * MAX_EMITTERS, "particle emitters") != S_OK) {
+        return S_FALSE;
+    }
+
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &ssbo_alignment_);
+    spawn_total_ = begin_program_.uniform<GLuint>("spawn_total");
+    emitter_count_ = emit_program_.uniform<GLuint>("emitter_count");
+    simulate_uniforms_.particle_count = simulate_program_.uniform<GLuint>("particle_count");
+    simulate_uniforms_.delta_time = simulate_program_.uniform<GLfloat>("delta_time");
+
+    capacity_ = capacity;
+    budget_ = capacity;
+
+    // Everything starts dead: zero life, every index on the dead list
+    std::vector<GLuint> dead_indices(capacity_);
+    std::iota(dead_indices.begin(), dead_indices.end(), 0u);
+    Counters counters{};
+    counters.draw_instance_count = 1;
+    counters.dead_count = GLuint(capacity_);
+
+    glCreateBuffers(1, &particles_ssbo_);
+    glNamedBufferStorage(particles_ssbo_, capacity_ * 2 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    const GLfloat zero = 0.0f;
+    glClearNamedBufferData(particles_ssbo_, GL_R32F, GL_RED, GL_FLOAT, &zero);
+
+    glCreateBuffers(1, &dead_list_ssbo_);
+    glNamedBufferStorage(dead_list_ssbo_, capacity_ * sizeof(GLuint), dead_indices.data(), 0);
+    glCreateBuffers(1, &alive_list_ssbo_);
+    glNamedBufferStorage(alive_list_ssbo_, capacity_ * sizeof(GLuint), nullptr, 0);
+    glCreateBuffers(1, &counters_buffer_);
+    glNamedBufferStorage(counters_buffer_, sizeof(Counters), &counters, 0);
+
+    glCreateVertexArrays(1, &vao_);
+
+    std::cout << "GPU particle system: " << capacity_ << " particles, "
+        << (capacity_ * (2 * sizeof(glm::vec4) + 2 * sizeof(GLuint))) / 1024 << " KB, "
+        << MAX_EMITTERS << " emitters" << std::endl;
+    return S_OK;
+}
+
+void GPUParticleSystem::OnEmitterConstructed(entt::registry& registry, entt::entity entity) {
+    auto& emitter = registry.get<component::ParticleEmitter>(entity);
+    if (free_slots_.empty()) {
+        std::cout << "WARNING: More than " << MAX_EMITTERS << " particle emitters, emitter ignored" << std::endl;
+        emitter.slot = -1;
+        return;
+    }
+    emitter.slot = free_slots_.back();
+    free_slots_.pop_back();
+    slot_count_ = std::max(slot_count_, emitter.slot + 1);
+}
+
+void GPUParticleSystem::OnEmitterDestroyed(entt::registry& registry, entt::entity entity) {
+    const int slot = registry.get<component::ParticleEmitter>(entity).slot;
+    if (slot < 0) {
+        return;
+    }
+    // Row stays inactive until the simulation has killed the emitter's particles
+    emitters_[slot].origin.w = 0.0f;
+    emitters_[slot].spawn[1] = 0;
+    released_slots_.push_back(slot);
+}
+
+void GPUParticleSystem::BindBuffers() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PARTICLES_BINDING, particles_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DEAD_LIST_BINDING, dead_list_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ALIVE_LIST_BINDING, alive_list_ssbo_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTERS_BINDING, counters_buffer_);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, EMITTERS_BINDING, emitter_stream_.buffer(), emitters_offset_, emitters_size_);
+}
+
+void GPUParticleSystem::Update(entt::registry& registry, const glm::vec3& camera_pos, const float delta_time) {
+    if (!valid() || slot_count_ == 0) {
+        free_slots_.insert(free_slots_.end(), released_slots_.begin(), released_slots_.end());
+        released_slots_.clear();
+        return;
+    }
+
+    // Refresh the rows of live emitters and add up the steady-state population of those near the camera
+    auto view = registry.view<component::ParticleEmitter>();
+    float demand = 0.0f;
+    for (auto entity : view) {
+        const auto& emitter = view.get<component::ParticleEmitter>(entity);
+        if (emitter.slot < 0) continue;
+
+        glm::vec3 origin = camera_pos;
+        if (!emitter.follow_camera) {
+            const auto* transform = registry.try_get<component::Transform>(entity);
+            origin = transform ? glm::vec3(transform->world_model_matrix[3]) : glm::vec3(0.0f);
+        }
+
+        Emitter& row = emitters_[emitter.slot];
+        row.origin = glm::vec4(origin, 1.0f);
+        row.spawn_min = glm::vec4(emitter.spawn_min, emitter.life_decay);
+        row.spawn_max = glm::vec4(emitter.spawn_max, emitter.kill_z);
+        row.velocity_min = glm::vec4(emitter.velocity_min, emitter.point_size);
+        row.velocity_max = glm::vec4(emitter.velocity_max, emitter.sprite_falloff.x);
+        row.acceleration = glm::vec4(emitter.acceleration, emitter.sprite_falloff.y);
+        row.color = emitter.color;
+
+        const glm::vec3 to_camera = origin - camera_pos;
+        row.spawn[2] = emitter.follow_camera || glm::dot(to_camera, to_camera) <= emitter.cull_distance * emitter.cull_distance;
+        if (row.spawn[2]) {
+            demand += emitter.emit_rate / std::max(emitter.life_decay, 1e-3f);
+        }
+    }
+
+    // Global budget - every visible emitter is slowed down by the same factor
+    const float rate_scale = demand > float(budget_) ? float(budget_) / demand : 1.0f;
+    for (auto entity : view) {
+        auto& emitter = view.get<component::ParticleEmitter>(entity);
+        if (emitter.slot < 0) continue;
+
+        Emitter& row = emitters_[emitter.slot];
+        if (row.spawn[2]) {
+            const float wanted = emitter.emit_rate * rate_scale * delta_time + emitter.emit_carry;
+            row.spawn[1] = GLuint(wanted);
+            emitter.emit_carry = wanted - float(row.spawn[1]);
+        }
+        else {
+            row.spawn[1] = 0;
+            emitter.emit_carry = 0.0f;
+        }
+    }
+
+    // Spawn ranges in slot order, particles_emit.comp binary searches them
+    GLuint spawn_total = 0;
+    for (int slot = 0; slot < slot_count_; ++slot) {
+        emitters_[slot].spawn[0] = spawn_total;
+        spawn_total += emitters_[slot].spawn[1];
+    }
+
+    emitter_stream_.BeginFrame();
+    emitters_size_ = sizeof(Emitter) * slot_count_;
+    const StreamBuffer::Allocation allocation = emitter_stream_.Allocate(emitters_size_, ssbo_alignment_);
+    if (!allocation.data) {
+        return;
+    }
+    memcpy(allocation.data, emitters_.data(), emitters_size_);
+    emitters_offset_ = allocation.offset;
+    BindBuffers();
+
+    spawn_total_.Set(spawn_total);
+    glUseProgram(begin_program_.id());
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    emitter_count_.Set(GLuint(slot_count_));
+    glUseProgram(emit_program_.id());
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counters_buffer_);
+    glDispatchComputeIndirect(offsetof(Counters, emit_groups));
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    simulate_uniforms_.particle_count.Set(GLuint(capacity_));
+    simulate_uniforms_.delta_time.Set(delta_time);
+    glUseProgram(simulate_program_.id());
+    glDispatchCompute(GLuint((capacity_ + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+
+    // Draw() reads the alive list in the vertex shader and the count as indirect arguments
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+    // Particles of emitters destroyed before this frame are dead now, their slots can be reused
+    free_slots_.insert(free_slots_.end(), released_slots_.begin(), released_slots_.end());
+    released_slots_.clear();
+}
+
+void GPUParticleSystem::Draw() const {
+    if (!valid() || emitters_size_ == 0) {
+        return;
+    }
+    BindBuffers();
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counters_buffer_);
+    glDrawArraysIndirect(GL_POINTS, nullptr);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GPUParticleSystem::EndFrame() {
+    if (valid()) {
+        emitter_stream_.EndFrame();
+    }
+}
+
+GPUParticleSystem::Stats GPUParticleSystem::ReadStats() const {
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    Counters counters{};
+    glGetNamedBufferSubData(counters_buffer_, 0, sizeof(Counters), &counters);
+    return { counters.draw_count, counters.dead_count, counters.emit_count };
+}
+
+int GPUParticleSystem::RunSelfTest(const size_t capacity, const int frames) {
+    if (!glfwInit()) {
+        return EXIT_FAILURE;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);  // llvmpipe tops out at 4.5
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "GPU particle test", nullptr, nullptr);
+    if (!window) {
+        printf("GPU particle test: no OpenGL 4.5 context\n");
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    printf("GPU particle test on %s\n", glGetString(GL_RENDERER));
+
+    bool passed = true;
+    {
+        GPUParticleSystem system;
+        entt::registry registry;
+        registry.on_construct<component::ParticleEmitter>().connect<&GPUParticleSystem::OnEmitterConstructed>(system);
+        registry.on_destroy<component::ParticleEmitter>().connect<&GPUParticleSystem::OnEmitterDestroyed>(system);
+
+        // Rain asking for more than the pool holds, so the budget and the dead list clamp both kick in
+        auto rain = registry.create();
+        auto& rain_emitter = registry.emplace<component::ParticleEmitter>(rain);
+        rain_emitter.spawn_min = glm::vec3(-30.0f, -30.0f, 20.0f);
+        rain_emitter.spawn_max = glm::vec3(30.0f, 30.0f, 50.0f);
+        rain_emitter.velocity_min = glm::vec3(-0.1f, -0.1f, -22.0f);
+        rain_emitter.velocity_max = glm::vec3(0.1f, 0.1f, -14.0f);
+        rain_emitter.life_decay = 0.5f;
+        rain_emitter.emit_rate = float(capacity);
+        rain_emitter.kill_z = -2.0f;
+        rain_emitter.follow_camera = true;
+        const component::ParticleEmitter rain_settings = rain_emitter;  // Reference dies with the next emplace
+
+        // Smoke rising from the origin, destroyed half way through
+        auto smoke = registry.create();
+        auto& smoke_emitter = registry.emplace<component::ParticleEmitter>(smoke);
+        smoke_emitter.velocity_min = glm::vec3(-0.2f, -0.2f, 0.5f);
+        smoke_emitter.velocity_max = glm::vec3(0.2f, 0.2f, 1.0f);
+        smoke_emitter.acceleration = glm::vec3(0.0f, 0.0f, 0.3f);
+        smoke_emitter.life_decay = 0.25f;
+        smoke_emitter.emit_rate = float(capacity) * 0.1f;
+
+        if (system.Init(capacity) != S_OK) {
+            passed = false;
+        }
+        else {
+            const float delta_time = 1.0f / 60.0f;
+            for (int frame = 0; frame < frames && passed; ++frame) {
+                if (frame == frames / 2) {
+                    registry.destroy(smoke);
+                }
+                system.Update(registry, glm::vec3(0.0f), delta_time);
+                system.EndFrame();
+                const Stats stats = system.ReadStats();
+                // Every particle is either alive or on the dead list, never both or neither
+                if (stats.alive + stats.dead != capacity) {
+                    printf("  frame %d: alive %u + dead %u != %zu\n", frame, stats.alive, stats.dead, capacity);
+                    passed = false;
+                }
+            }
+
+            // Survivors are distinct, alive, belong to the remaining emitter and stay in its reachable volume
+            const Stats stats = system.ReadStats();
+            std::vector<GLuint> alive(stats.alive);
+            std::vector<glm::vec4> particles(capacity * 2);
+            glGetNamedBufferSubData(system.alive_list_ssbo_, 0, alive.size() * sizeof(GLuint), alive.data());
+            glGetNamedBufferSubData(system.particles_ssbo_, 0, particles.size() * sizeof(glm::vec4), particles.data());
+            std::sort(alive.begin(), alive.end());
+            if (std::adjacent_find(alive.begin(), alive.end()) != alive.end()) {
+                printf("  duplicate alive index\n");
+                passed = false;
+            }
+            for (const GLuint index : alive) {
+                const glm::vec4& position_life = particles[size_t(index) * 2];
+                GLuint slot = 0;
+                memcpy(&slot, &particles[size_t(index) * 2 + 1].w, sizeof(slot));
+                if (index >= capacity || position_life.w <= 0.0f || int(slot) != rain_settings.slot ||
+                    position_life.z < rain_settings.kill_z || position_life.z > rain_settings.spawn_max.z) {
+                    printf("  particle %u out of range or of a destroyed emitter\n", index);
+                    passed = false;
+                    break;
+                }
+            }
+            if (stats.alive == 0) {
+                printf("  no particles alive\n");
+                passed = false;
+            }
+            printf("  %d frames, %u alive, %u dead\n", frames, stats.alive, stats.dead);
+        }
+        registry.clear();
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    printf("GPU particle test %s\n", passed ? "PASSED" : "FAILED");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "glutils.h"
+#include "shaderprogram.h"
+#include "streambuffer.h"
+#include "component.h"
+
+// Shared particle pool for every component::ParticleEmitter, simulated entirely in compute shaders
+// State lives in SSBOs (see particles.glsl); the dead list doubles as the pool's free list. Each frame:
+//   CPU                     - emitter table with per-emitter spawn counts (culled by distance, scaled to
+//                             the global budget) is written into a StreamBuffer
+//   particles_begin.comp    - one invocation clamps the spawns to the free particles, resets the draw count
+//   particles_emit.comp     - indirect dispatch, pops dead indices and respawns them for their emitter
+//   particles_simulate.comp - integrates, pushes the dying onto the dead list, lists the survivors
+// Draw() is a glDrawArraysIndirect of the survivors, so the CPU never sees particle data.
+// Needs GL 4.3 (compute, SSBO, indirect), runs on Mesa llvmpipe.
+class GPUParticleSystem {
+public:
+    static const GLuint PARTICLES_BINDING = 3;  // Bindings as declared in particles.glsl
+    static const GLuint DEAD_LIST_BINDING = 4;
+    static const GLuint ALIVE_LIST_BINDING = 5;
+    static const GLuint COUNTERS_BINDING = 6;
+    static const GLuint EMITTERS_BINDING = 7;
+    static const GLuint GROUP_SIZE = 64;  // PARTICLE_GROUP_SIZE
+    static const int MAX_EMITTERS = 256;
+
+    GPUParticleSystem();
+    ~GPUParticleSystem();
+    GPUParticleSystem(const GPUParticleSystem&) = delete;
+    GPUParticleSystem& operator=(const GPUParticleSystem&) = delete;
+
+    // Loads the compute passes and allocates capacity dead particles, returns S_OK or S_FALSE
+    int Init(const size_t capacity);
+
+    // Spawns for and simulates all emitters in the registry
+    void Update(entt::registry& registry, const glm::vec3& camera_pos, const float delta_time);
+
+    // Draws the alive particles as GL_POINTS with the current program (vertex shader reads particles.glsl)
+    void Draw() const;
+
+    // Fences this frame's emitter table once Draw() is submitted
+    void EndFrame();
+
+    // Steady-state particle count all emitters together may ask for, spawn rates are scaled down beyond it
+    void set_budget(const size_t budget) { budget_ = budget; }
+    size_t capacity() const { return capacity_; }
+    bool valid() const { return vao_ != 0; }
+
+    // Slot bookkeeping, connect to the registry's ParticleEmitter construct/destroy signals
+    void OnEmitterConstructed(entt::registry& registry, entt::entity entity);
+    void OnEmitterDestroyed(entt::registry& registry, entt::entity entity);
+
+    struct Stats {
+        GLuint alive{ 0 };
+        GLuint dead{ 0 };
+        GLuint emitted{ 0 };  // Last frame
+    };
+    // Reads the counters back - stalls the pipeline, for tests and debugging only
+    Stats ReadStats() const;
+
+    // Simulates rain and smoke emitters in a hidden window and checks the pool invariants, returns EXIT_SUCCESS on pass
+    // Run with LIBGL_ALWAYS_SOFTWARE=1 to test on Mesa llvmpipe
+    static int RunSelfTest(const size_t capacity, const int frames);
+
+private:
+    struct Emitter {  // Emitter in particles.glsl (std430)
+        glm::vec4 origin;
+        glm::vec4 spawn_min;
+        glm::vec4 spawn_max;
+        glm::vec4 velocity_min;
+        glm::vec4 velocity_max;
+        glm::vec4 acceleration;
+        glm::vec4 color;
+        GLuint spawn[4];  // x first spawn invocation, y spawn count, z near enough to spawn (CPU only)
+    };
+    struct Counters {  // ParticleCounters in particles.glsl
+        GLuint draw_count;
+        GLuint draw_instance_count;
+        GLuint draw_first;
+        GLuint draw_base_instance;
+        GLuint emit_groups[3];
+        GLuint dead_count;
+        GLuint emit_count;
+        GLuint frame;
+        GLuint padding[2];
+    };
+
+    void BindBuffers() const;
+
+    size_t capacity_{ 0 };
+    size_t budget_{ 0 };
+    std::vector<Emitter> emitters_;  // MAX_EMITTERS rows, rewritten every frame
+    std::vector<int> free_slots_;
+    std::vector<int> released_slots_;  // Destroyed this frame, reusable once their particles were killed
+    int slot_count_{ 0 };  // Rows in use, highest allocated slot + 1
+    StreamBuffer emitter_stream_;
+    GLintptr emitters_offset_{ 0 };  // This frame's table in emitter_stream_
+    GLsizeiptr emitters_size_{ 0 };
+    GLint ssbo_alignment_{ 256 };
+
+    GLuint particles_ssbo_{ 0 };
+    GLuint dead_list_ssbo_{ 0 };
+    GLuint alive_list_ssbo_{ 0 };
+    GLuint counters_buffer_{ 0 };  // Also the draw and dispatch indirect buffer
+    GLuint vao_{ 0 };  // Empty, core profile needs one bound to draw
+
+    ShaderProgram begin_program_;
+    ShaderProgram emit_program_;
+    ShaderProgram simulate_program_;
+    Uniform<GLuint> spawn_total_;
+    Uniform<GLuint> emitter_count_;
+    struct {
+        Uniform<GLuint> particle_count;
+        Uniform<GLfloat> delta_time;
+    } simulate_uniforms_;
+};
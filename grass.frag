@@ -12,23 +12,9 @@ flat in int material_index;
 // Outputs
 layout (location = 0) out vec4 FragColor;
 
-struct Material {
-    vec3 diffuse;
-    uvec2 tex_diffuse;
-    vec3 rma;
-    uvec2 tex_rma;
-    vec3 normal;
-    uvec2 tex_normal;
-};
+#include "materials.glsl"
 
-// SSBO for materials
-layout(std430, binding = 0) readonly buffer Materials {
-    Material materials[];
-};
-
-// Uniform variables
-uniform vec3 light_ws;
-uniform vec3 camera_pos_ws;
+#include "frame_constants.glsl"
 
 void main(void)
 {
@@ -55,7 +41,7 @@ void main(void)
 
     // Simple lighting 
     vec3 N = normalize(normal_ws); 
-    vec3 L = normalize(light_ws - position_ws); 
+    vec3 L = normalize(frame.light_ws.xyz - position_ws); 
     float NdotL = max(dot(N, L), 0.0); 
 
     // Grass color with simple ambient + diffuse lighting 
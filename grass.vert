@@ -6,12 +6,24 @@ layout (location = 2) in vec3 in_tangent_ms;
 layout (location = 3) in vec2 in_tex_coord;
 layout (location = 4) in int in_mat_idx;
 
+#include "frame_constants.glsl"
+
 // Uniform variables
 uniform mat4 M;   // Model matrix
 uniform mat3 Mn;  // Normal matrix
-uniform mat4 V;   // View matrix
-uniform mat4 P;   // Projection matrix
-uniform float time;  // Time for animation
+uniform vec3 position_offset;  // Dequantisation of compact vertex positions, zero and one for float vertices
+uniform vec3 position_scale;
+uniform int material_offset;  // Index of the asset's first material, the vertices' indices are relative to it
+
+// Per-instance data (one entry per grass tuft)
+struct Instance {
+    mat4 M;   // Instance model matrix (relative to entity)
+    mat4 Mn;  // Instance normal matrix
+};
+
+layout(std430, binding = 1) readonly buffer Instances {
+    Instance instances[];
+};
 
 // Outputs to fragment shader
 out vec3 position_ws;
@@ -28,12 +40,18 @@ float rand(const vec2 co) {
 
 void main(void)
 {
+    // Combine entity and instance transforms
+    Instance instance = instances[gl_BaseInstance + gl_InstanceID];  // Instances are grouped by level of detail
+    mat4 M_i = M * instance.M;
+    mat3 Mn_i = Mn * mat3(instance.Mn);
+
     // Get world position first
-    vec4 pos_ws = M * in_position_ms;
+    vec4 position_ms = vec4(position_offset + in_position_ms.xyz * position_scale, 1.0);
+    vec4 pos_ws = M_i * position_ms;
 
     // Wind animation - apply more movement to top of grass (higher vertices)
     // Use vertex height (z or y depending on model orientation) to determine sway amount
-    float height_factor = in_position_ms.z;  // Higher = more sway
+    float height_factor = position_ms.z;  // Higher = more sway
     height_factor = max(0.0, height_factor);  // Only positive heights sway
 
     // Create wind effect using sin/cos with time and position-based variation
@@ -42,7 +60,7 @@ void main(void)
 
     // Add randomness based on world position for natural variation
     float random_offset = rand(pos_ws.xy) * 6.28318;  // Random phase offset
-    float wind_wave = sin(time * 2.0 + pos_ws.x * 0.5 + pos_ws.y * 0.3 + random_offset);
+    float wind_wave = sin(frame.time * 2.0 + pos_ws.x * 0.5 + pos_ws.y * 0.3 + random_offset);
 
     // Apply wind displacement (only to x and y, not z)
     pos_ws.x += wind_wave * wind_strength * height_factor * wind_dir.x;
@@ -51,14 +69,14 @@ void main(void)
     position_ws = pos_ws.xyz / pos_ws.w;
 
     // Transform to clip space for rasterization
-    gl_Position = P * V * pos_ws;
+    gl_Position = frame.VP * pos_ws;
 
     // Transform normal to world space
-    vec3 norm_ws = Mn * in_normal_ms;
+    vec3 norm_ws = Mn_i * in_normal_ms;
     normal_ws = normalize(norm_ws);
 
     // Transform tangent to world space
-    vec3 tan_ws = Mn * in_tangent_ms;
+    vec3 tan_ws = Mn_i * in_tangent_ms;
 
     // Gram-Schmidt orthogonalization: make tangent perpendicular to normal
     tangent_ws = normalize(tan_ws - dot(tan_ws, normal_ws) * normal_ws);
@@ -68,5 +86,5 @@ void main(void)
 
     // Pass through texture coordinates and material index
     tex_coord = vec2(in_tex_coord.x, 1.0f - in_tex_coord.y);
-    material_index = in_mat_idx;
+    material_index = in_mat_idx + material_offset;
 }
@@ -0,0 +1,22 @@
+// Bindless materials of all meshes, indexed by the per-vertex material index
+// Layout must match GLMaterial (std430)
+struct Material {
+    vec3 diffuse;
+    uvec2 tex_diffuse;
+    vec3 rma;
+    uvec2 tex_rma;
+    vec3 normal;
+    uvec2 tex_normal;
+};
+
+// SSBO for materials
+layout(std430, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+// Entities whose mesh is still streaming in draw a box with material index -1 (Rasteriser::PlaceholderMeshes)
+const Material PLACEHOLDER_MATERIAL = Material(vec3(0.5), uvec2(0), vec3(1.0, 0.0, 1.0), uvec2(0), vec3(0.5, 0.5, 1.0), uvec2(0));
+
+Material get_material(const int index) {
+    return index >= 0 ? materials[index] : PLACEHOLDER_MATERIAL;
+}
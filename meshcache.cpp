@@ -0,0 +1,64 @@
+#include "meshcache.h"
+#include <iostream>
+
+MeshAsset::~MeshAsset() {
+    if (geometry_pool) {
+        for (const auto& glmesh : gl_meshes) {
+            geometry_pool->Free(glmesh);
+        }
+    }
+    if (material_ranges) {
+        material_ranges->Free(first_material, material_count);
+    }
+    if (texture_registry) {
+        for (GLuint64 handle : textures) {
+            texture_registry->Release(handle);
+        }
+    }
+    std::cout << "Released mesh asset: " << path << std::endl;
+}
+
+MeshCache::MeshCache(Loader loader) : loader_(std::move(loader)) {
+}
+
+std::string MeshCache::MakeKey(const std::string& file_name) {
+    // Different relative spellings of the same file must share one asset
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(file_name, ec);
+    return ec ? file_name : canonical.generic_string();
+}
+
+std::shared_ptr<MeshAsset> MeshCache::Acquire(const std::string& file_name) {
+    const std::string key = MakeKey(file_name);
+
+    auto it = assets_.find(key);
+    if (it != assets_.end()) {
+        if (auto asset = it->second.lock()) {
+            return asset;
+        }
+    }
+
+    // Entries of released assets are dropped before a new one is added, so the map never outgrows the live set
+    for (auto entry = assets_.begin(); entry != assets_.end();) {
+        entry = entry->second.expired() ? assets_.erase(entry) : std::next(entry);
+    }
+
+    auto asset = std::make_shared<MeshAsset>();
+    asset->path = key;
+    loader_(file_name, asset);
+    assets_[key] = asset;
+
+    std::cout << "Mesh cache: " << (asset->resident ? "loaded '" : "requested '") << key << "' (" << asset->gl_meshes.size()
+        << " sub-meshes, " << size() << " unique assets)" << std::endl;
+    return asset;
+}
+
+size_t MeshCache::size() const {
+    size_t alive = 0;
+    for (const auto& [key, asset] : assets_) {
+        if (!asset.expired()) {
+            ++alive;
+        }
+    }
+    return alive;
+}
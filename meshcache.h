@@ -0,0 +1,50 @@
+#pragma once
+#include "glutils.h"
+#include "texturecache.h"
+#include "geometrypool.h"
+#include <unordered_map>
+#include <functional>
+#include <memory>
+
+// GPU copy of one mesh file (all sub-meshes), shared by every entity using it
+struct MeshAsset {
+    std::string path;
+    std::vector<GLMesh> gl_meshes;
+    std::vector<GLuint64> textures;  // One registry reference per material map
+    TextureRegistry* texture_registry{ nullptr };
+    GeometryPool* geometry_pool{ nullptr };  // Pool the sub-meshes were allocated from
+    RangeAllocator* material_ranges{ nullptr };  // Allocator of the material slots [first_material, + material_count)
+    size_t first_material{ 0 };
+    size_t material_count{ 0 };
+    bool resident{ false };  // gl_meshes and textures uploaded, entities draw a placeholder until then
+
+    MeshAsset() = default;
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+
+    // Returns pool ranges, material slots and texture references once the last entity lets go
+    ~MeshAsset();
+};
+
+// Path-keyed, ref-counted cache of GPU meshes
+// Entities hold shared_ptr<MeshAsset>, the cache only keeps weak references
+// so an asset is freed as soon as nothing uses it and reloaded on next request
+// The loader may fill the asset later (streaming), it sets resident once the asset is usable
+class MeshCache {
+public:
+    using Loader = std::function<int(const std::string& file_name, const std::shared_ptr<MeshAsset>& asset)>;
+
+    explicit MeshCache(Loader loader);
+
+    // Returns the shared asset for the file, requesting it from the loader on first use
+    std::shared_ptr<MeshAsset> Acquire(const std::string& file_name);
+
+    // Number of assets currently alive
+    size_t size() const;
+
+private:
+    static std::string MakeKey(const std::string& file_name);
+
+    Loader loader_;
+    std::unordered_map<std::string, std::weak_ptr<MeshAsset>> assets_;
+};
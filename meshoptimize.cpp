@@ -0,0 +1,304 @@
+#include "meshoptimize.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace meshoptimize {
+
+    namespace {
+        // Forsyth's scoring, tuned for a 32 entry LRU cache
+        const int kCacheSize = 32;
+        const float kCacheDecayPower = 1.5f;
+        const float kLastTriangleScore = 0.75f;
+        const float kValenceBoostScale = 2.0f;
+        const float kValenceBoostPower = 0.5f;
+
+        float VertexScore(const int cache_position, const unsigned remaining_triangles) {
+            if (remaining_triangles == 0) {
+                return -1.0f;  // No longer needed
+            }
+            float score = 0.0f;
+            if (cache_position >= 0) {
+                // The three vertices of the last triangle score the same, whichever order they went in
+                score = cache_position < 3 ? kLastTriangleScore
+                    : std::pow(1.0f - float(cache_position - 3) / float(kCacheSize - 3), kCacheDecayPower);
+            }
+            // Vertices with few triangles left are finished off first, so they never have to be reloaded
+            return score + kValenceBoostScale * std::pow(float(remaining_triangles), -kValenceBoostPower);
+        }
+
+        // Misses of a FIFO cache, cache must hold cache_size entries of ~0u
+        unsigned SimulateTriangle(const GLuint* triangle, std::vector<GLuint>& cache, unsigned& cache_head) {
+            unsigned misses = 0;
+            for (int k = 0; k < 3; ++k) {
+                if (std::find(cache.begin(), cache.end(), triangle[k]) == cache.end()) {
+                    cache[cache_head] = triangle[k];
+                    cache_head = (cache_head + 1) % unsigned(cache.size());
+                    ++misses;
+                }
+            }
+            return misses;
+        }
+    }
+
+    CacheStats AnalyzeVertexCache(const GLuint* indices, const size_t index_count, const size_t vertex_count, const unsigned cache_size) {
+        CacheStats stats;
+        if (index_count < 3 || vertex_count == 0) {
+            return stats;
+        }
+
+        std::vector<GLuint> cache(cache_size, ~0u);
+        unsigned cache_head = 0;
+        size_t misses = 0;
+        for (size_t i = 0; i + 2 < index_count; i += 3) {
+            misses += SimulateTriangle(&indices[i], cache, cache_head);
+        }
+
+        std::vector<bool> referenced(vertex_count, false);
+        size_t referenced_count = 0;
+        for (size_t i = 0; i < index_count; ++i) {
+            if (!referenced[indices[i]]) {
+                referenced[indices[i]] = true;
+                ++referenced_count;
+            }
+        }
+
+        stats.acmr = float(misses) / float(index_count / 3);
+        stats.atvr = float(misses) / float(std::max<size_t>(referenced_count, 1));
+        return stats;
+    }
+
+    void OptimizeVertexCache(GLuint* indices, const size_t index_count, const size_t vertex_count) {
+        const size_t triangle_count = index_count / 3;
+        if (triangle_count == 0) {
+            return;
+        }
+
+        // Triangles of every vertex, the first remaining[v] entries are the ones not emitted yet
+        std::vector<unsigned> remaining(vertex_count, 0);
+        for (size_t i = 0; i < triangle_count * 3; ++i) {
+            ++remaining[indices[i]];
+        }
+        std::vector<size_t> offsets(vertex_count + 1, 0);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            offsets[v + 1] = offsets[v] + remaining[v];
+        }
+        std::vector<uint32_t> vertex_triangles(triangle_count * 3);
+        {
+            std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t t = 0; t < triangle_count; ++t) {
+                for (int k = 0; k < 3; ++k) {
+                    vertex_triangles[fill[indices[t * 3 + k]]++] = uint32_t(t);
+                }
+            }
+        }
+
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> vertex_score(vertex_count);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            vertex_score[v] = VertexScore(-1, remaining[v]);
+        }
+        std::vector<float> triangle_score(triangle_count);
+        std::vector<bool> emitted(triangle_count, false);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+        }
+
+        std::vector<GLuint> result(triangle_count * 3);
+        std::vector<GLuint> cache;
+        std::vector<GLuint> new_cache;
+        cache.reserve(kCacheSize + 3);
+        new_cache.reserve(kCacheSize + 3);
+        size_t input_cursor = 0;  // Dead ends restart at the first triangle not emitted yet
+        size_t best = size_t(std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin());
+
+        for (size_t output = 0; output < triangle_count; ++output) {
+            const GLuint* triangle = &indices[best * 3];
+            std::copy(triangle, triangle + 3, &result[output * 3]);
+            emitted[best] = true;
+
+            // Take the triangle off its vertices' lists
+            for (int k = 0; k < 3; ++k) {
+                const GLuint v = triangle[k];
+                uint32_t* first = &vertex_triangles[offsets[v]];
+                uint32_t* last = first + remaining[v];
+                *std::find(first, last, uint32_t(best)) = *(last - 1);
+                --remaining[v];
+            }
+
+            // Its vertices move to the front of the LRU cache
+            new_cache.assign(triangle, triangle + 3);
+            for (GLuint v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    new_cache.push_back(v);
+                }
+            }
+            for (size_t i = kCacheSize; i < new_cache.size(); ++i) {
+                cache_position[new_cache[i]] = -1;  // Evicted
+            }
+
+            // Rescore everything that was or is cached
+            for (size_t i = 0; i < new_cache.size(); ++i) {
+                const GLuint v = new_cache[i];
+                if (i < size_t(kCacheSize)) {
+                    cache_position[v] = int(i);
+                }
+                const float score = VertexScore(cache_position[v], remaining[v]);
+                const float delta = score - vertex_score[v];
+                vertex_score[v] = score;
+                for (size_t j = offsets[v]; j < offsets[v] + remaining[v]; ++j) {
+                    triangle_score[vertex_triangles[j]] += delta;
+                }
+            }
+            new_cache.resize(std::min(new_cache.size(), size_t(kCacheSize)));
+            std::swap(cache, new_cache);
+
+            // The next triangle is the best one touching the cache
+            float best_score = -1.0f;
+            for (GLuint v : cache) {
+                for (size_t j = offsets[v]; j < offsets[v] + remaining[v]; ++j) {
+                    const uint32_t t = vertex_triangles[j];
+                    if (triangle_score[t] > best_score) {
+                        best_score = triangle_score[t];
+                        best = t;
+                    }
+                }
+            }
+
+            if (best_score < 0.0f) {
+                while (input_cursor < triangle_count && emitted[input_cursor]) {
+                    ++input_cursor;
+                }
+                best = input_cursor;
+            }
+        }
+
+        std::copy(result.begin(), result.end(), indices);
+    }
+
+    void OptimizeOverdraw(GLuint* indices, const size_t index_count, const Vertex* vertices, const size_t vertex_count,
+        const float threshold) {
+        const size_t triangle_count = index_count / 3;
+        if (triangle_count == 0 || vertex_count == 0) {
+            return;
+        }
+
+        // Hard boundaries - triangles that start from a cold cache anyway, reordering there costs nothing
+        // The same simulation counts each cluster's misses for its ACMR
+        std::vector<size_t> clusters;
+        std::vector<size_t> cluster_misses;
+        {
+            std::vector<GLuint> cache(STATS_CACHE_SIZE, ~0u);
+            unsigned cache_head = 0;
+            for (size_t t = 0; t < triangle_count; ++t) {
+                const unsigned misses = SimulateTriangle(&indices[t * 3], cache, cache_head);
+                if (clusters.empty() || misses == 3) {
+                    clusters.push_back(t);
+                    cluster_misses.push_back(0);
+                }
+                cluster_misses.back() += misses;
+            }
+        }
+
+        // Soft boundaries - split a cluster wherever the part before the split, started from a cold cache,
+        // is within threshold of the whole cluster's miss ratio
+        std::vector<size_t> split_clusters;
+        for (size_t c = 0; c < clusters.size(); ++c) {
+            const size_t begin = clusters[c];
+            const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangle_count;
+            const float cluster_acmr = float(cluster_misses[c]) / float(end - begin);
+
+            std::vector<GLuint> cache(STATS_CACHE_SIZE, ~0u);
+            unsigned cache_head = 0;
+            size_t start = begin;
+            size_t misses = 0;
+            split_clusters.push_back(begin);
+            for (size_t t = begin; t < end; ++t) {
+                misses += SimulateTriangle(&indices[t * 3], cache, cache_head);
+                const size_t count = t + 1 - start;
+                if (t + 1 < end && float(misses) / float(count) <= cluster_acmr * threshold) {
+                    split_clusters.push_back(t + 1);
+                    std::fill(cache.begin(), cache.end(), ~0u);
+                    start = t + 1;
+                    misses = 0;
+                }
+            }
+        }
+
+        // Area weighted centroid of the mesh
+        glm::vec3 mesh_center(0.0f);
+        float mesh_area = 0.0f;
+        for (size_t t = 0; t < triangle_count; ++t) {
+            const glm::vec3 p0 = vertices[indices[t * 3]].position;
+            const glm::vec3 p1 = vertices[indices[t * 3 + 1]].position;
+            const glm::vec3 p2 = vertices[indices[t * 3 + 2]].position;
+            const float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+            mesh_center += area * (p0 + p1 + p2);
+            mesh_area += area * 3.0f;
+        }
+        if (mesh_area > 0.0f) {
+            mesh_center = (1.0f / mesh_area) * mesh_center;
+        }
+
+        // Clusters far out along their own normal are likely in front of the rest - drawn first, they
+        // occlude more of what follows
+        struct Cluster {
+            size_t begin;
+            size_t end;
+            float key;
+        };
+        std::vector<Cluster> sorted(split_clusters.size());
+        for (size_t c = 0; c < split_clusters.size(); ++c) {
+            Cluster& cluster = sorted[c];
+            cluster.begin = split_clusters[c];
+            cluster.end = c + 1 < split_clusters.size() ? split_clusters[c + 1] : triangle_count;
+
+            glm::vec3 center(0.0f);
+            glm::vec3 normal(0.0f);
+            float area_sum = 0.0f;
+            for (size_t t = cluster.begin; t < cluster.end; ++t) {
+                const glm::vec3 p0 = vertices[indices[t * 3]].position;
+                const glm::vec3 p1 = vertices[indices[t * 3 + 1]].position;
+                const glm::vec3 p2 = vertices[indices[t * 3 + 2]].position;
+                const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+                const float area = glm::length(cross);
+                center += area * (p0 + p1 + p2);
+                normal += cross;
+                area_sum += area * 3.0f;
+            }
+            const float normal_length = glm::length(normal);
+            cluster.key = area_sum > 0.0f && normal_length > 0.0f
+                ? glm::dot((1.0f / area_sum) * center - mesh_center, (1.0f / normal_length) * normal) : 0.0f;
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+        std::vector<GLuint> result;
+        result.reserve(triangle_count * 3);
+        for (const Cluster& cluster : sorted) {
+            result.insert(result.end(), &indices[cluster.begin * 3], &indices[cluster.end * 3]);
+        }
+
+        // Keep the cache order if the clusters cost more than allowed after all
+        const CacheStats before = AnalyzeVertexCache(indices, triangle_count * 3, vertex_count);
+        const CacheStats after = AnalyzeVertexCache(result.data(), result.size(), vertex_count);
+        if (after.acmr <= before.acmr * threshold) {
+            std::copy(result.begin(), result.end(), indices);
+        }
+    }
+
+    size_t OptimizeVertexFetch(Vertex* vertices, const size_t vertex_count, GLuint* indices, const size_t index_count) {
+        std::vector<GLuint> remap(vertex_count, ~0u);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertex_count);
+        for (size_t i = 0; i < index_count; ++i) {
+            GLuint& new_index = remap[indices[i]];
+            if (new_index == ~0u) {
+                new_index = GLuint(reordered.size());
+                reordered.push_back(vertices[indices[i]]);
+            }
+            indices[i] = new_index;
+        }
+        std::copy(reordered.begin(), reordered.end(), vertices);
+        return reordered.size();
+    }
+}
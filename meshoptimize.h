@@ -0,0 +1,31 @@
+#pragma once
+#include "glutils.h"
+
+// Load-time reordering of indexed triangle lists for the GPU
+//   OptimizeVertexCache - Forsyth's linear-speed vertex cache optimisation, triangles reuse recently
+//                         transformed vertices
+//   OptimizeOverdraw    - splits the cache-ordered list into clusters and draws outward facing clusters first,
+//                         as long as the vertex cache efficiency stays within threshold (Sander et al.)
+//   OptimizeVertexFetch - vertices in first use order, so the vertex fetch streams through memory
+namespace meshoptimize {
+
+    static const unsigned STATS_CACHE_SIZE = 16;  // FIFO post-transform cache the statistics are measured with
+
+    struct CacheStats {
+        float acmr{ 0.0f };  // Average cache miss ratio - transformed vertices per triangle, 0.5 to 3
+        float atvr{ 0.0f };  // Average transform to vertex ratio - transformed vertices per referenced vertex, 1 at best
+    };
+
+    CacheStats AnalyzeVertexCache(const GLuint* indices, const size_t index_count, const size_t vertex_count,
+        const unsigned cache_size = STATS_CACHE_SIZE);
+
+    void OptimizeVertexCache(GLuint* indices, const size_t index_count, const size_t vertex_count);
+
+    // Expects a cache-optimised list, threshold is the ACMR increase accepted for less overdraw
+    void OptimizeOverdraw(GLuint* indices, const size_t index_count, const Vertex* vertices, const size_t vertex_count,
+        const float threshold = 1.05f);
+
+    // Reorders vertices by first use in indices and rewrites the indices, unreferenced vertices are dropped
+    // Returns the new vertex count
+    size_t OptimizeVertexFetch(Vertex* vertices, const size_t vertex_count, GLuint* indices, const size_t index_count);
+}
@@ -0,0 +1,448 @@
+#include "meshsimplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace meshsimplify {
+
+    namespace {
+        const size_t kMinTriangles = 64;      // Smaller meshes are cheap enough at full detail
+        const float kMinLevelReduction = 0.85f;  // A level must drop at least 15 % of the triangles of the one before
+        const float kBorderWeight = 2.0f;     // Border planes against plain area-weighted face planes
+        const float kFlipThreshold = 1e-2f;   // Minimal cos between a face's normal before and after a collapse
+
+        // Symmetric 4x4 error quadric sum(w * (n.p + d)^2) and the weights summed into it
+        struct Quadric {
+            double a00{ 0 }, a01{ 0 }, a02{ 0 }, a03{ 0 };
+            double a11{ 0 }, a12{ 0 }, a13{ 0 };
+            double a22{ 0 }, a23{ 0 };
+            double a33{ 0 };
+            double weight{ 0 };
+
+            void AddPlane(const glm::vec3& n, const float d, const float w) {
+                a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+                a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+                a22 += w * n.z * n.z; a23 += w * n.z * d;
+                a33 += w * double(d) * d;
+                weight += w;
+            }
+
+            void Add(const Quadric& q) {
+                a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+                a11 += q.a11; a12 += q.a12; a13 += q.a13;
+                a22 += q.a22; a23 += q.a23;
+                a33 += q.a33;
+                weight += q.weight;
+            }
+
+            double Evaluate(const glm::vec3& p) const {
+                const double x = p.x, y = p.y, z = p.z;
+                return a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                    + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                    + a22 * z * z + 2 * a23 * z
+                    + a33;
+            }
+        };
+
+        uint64_t EdgeKey(const uint32_t a, const uint32_t b) {
+            return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+        }
+
+        uint64_t HashBytes(const void* data, const size_t size) {
+            // FNV-1a
+            uint64_t hash = 14695981039346656037ull;
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i) {
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+            }
+            return hash;
+        }
+
+        // Index of the first vertex with the same bytes in [offset, offset + size) of each vertex
+        std::vector<GLuint> Deduplicate(const Vertex* vertices, const size_t vertex_count, const size_t offset, const size_t size) {
+            std::vector<GLuint> remap(vertex_count);
+            std::unordered_map<uint64_t, std::vector<GLuint>> buckets;
+            buckets.reserve(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&vertices[i]) + offset;
+                std::vector<GLuint>& bucket = buckets[HashBytes(bytes, size)];
+                remap[i] = GLuint(i);
+                for (GLuint other : bucket) {
+                    if (std::memcmp(reinterpret_cast<const uint8_t*>(&vertices[other]) + offset, bytes, size) == 0) {
+                        remap[i] = other;
+                        break;
+                    }
+                }
+                if (remap[i] == GLuint(i)) {
+                    bucket.push_back(GLuint(i));
+                }
+            }
+            return remap;
+        }
+
+        class Simplifier {
+        public:
+            Simplifier(const Vertex* vertices, const size_t vertex_count, const GLuint* indices, const size_t index_count);
+
+            std::vector<Lod> Run(const int max_levels, const float max_error);
+
+        private:
+            struct Candidate {
+                double cost;
+                uint32_t from;
+                uint32_t to;
+                uint32_t version;
+                bool operator<(const Candidate& other) const { return cost > other.cost; }  // Cheapest on top
+            };
+
+            bool Evaluate(const uint32_t from, const uint32_t to, double& cost);
+            void PushBest(const uint32_t group);
+            void Collapse(const uint32_t from, const uint32_t to);
+            void Emit(std::vector<Lod>& lods, const float error) const;
+
+            std::vector<glm::vec3> positions_;   // Per vertex
+            std::vector<GLuint> group_;          // Vertex -> first vertex at the same position
+            std::vector<GLuint> triangles_;      // Welded vertex indices, 3 per triangle
+            std::vector<bool> triangle_alive_;
+            size_t alive_triangles_{ 0 };
+
+            // Per position group, indexed by the group's first vertex
+            std::vector<std::vector<uint32_t>> group_triangles_;
+            std::vector<Quadric> quadrics_;
+            std::vector<bool> border_;
+            std::vector<bool> locked_;
+            std::vector<bool> removed_;
+            std::vector<uint32_t> version_;
+            std::unordered_set<uint64_t> border_edges_;
+
+            std::priority_queue<Candidate> queue_;
+            std::vector<std::pair<GLuint, GLuint>> partners_;  // Wedge moves of the last successful Evaluate()
+        };
+
+        Simplifier::Simplifier(const Vertex* vertices, const size_t vertex_count, const GLuint* indices, const size_t index_count) {
+            positions_.resize(vertex_count);
+            for (size_t i = 0; i < vertex_count; ++i) {
+                const glm::vec3 position = vertices[i].position;
+                positions_[i] = position;
+            }
+
+            // MeshLoader emits vertices per face corner - identical ones are welded, then grouped by position
+            const std::vector<GLuint> weld = Deduplicate(vertices, vertex_count, 0, sizeof(Vertex));
+            group_ = Deduplicate(vertices, vertex_count, offsetof(Vertex, position), sizeof(Vertex::position));
+
+            triangles_.reserve(index_count);
+            for (size_t i = 0; i + 2 < index_count; i += 3) {
+                const GLuint a = weld[indices[i]];
+                const GLuint b = weld[indices[i + 1]];
+                const GLuint c = weld[indices[i + 2]];
+                if (group_[a] == group_[b] || group_[b] == group_[c] || group_[c] == group_[a]) {
+                    continue;  // Degenerate in position
+                }
+                triangles_.insert(triangles_.end(), { a, b, c });
+            }
+            const size_t triangle_count = triangles_.size() / 3;
+            triangle_alive_.assign(triangle_count, true);
+            alive_triangles_ = triangle_count;
+
+            group_triangles_.resize(vertex_count);
+            quadrics_.resize(vertex_count);
+            border_.assign(vertex_count, false);
+            locked_.assign(vertex_count, false);
+            removed_.assign(vertex_count, false);
+            version_.assign(vertex_count, 0);
+
+            // Face planes weighted by area, edge use counts in position space
+            std::unordered_map<uint64_t, int> edge_use;
+            edge_use.reserve(triangles_.size());
+            for (size_t t = 0; t < triangle_count; ++t) {
+                const GLuint* tri = &triangles_[t * 3];
+                const glm::vec3& p0 = positions_[tri[0]];
+                const glm::vec3 cross = glm::cross(positions_[tri[1]] - p0, positions_[tri[2]] - p0);
+                const float length = glm::length(cross);
+                for (int k = 0; k < 3; ++k) {
+                    group_triangles_[group_[tri[k]]].push_back(uint32_t(t));
+                    ++edge_use[EdgeKey(group_[tri[k]], group_[tri[(k + 1) % 3]])];
+                }
+                if (length <= 0.0f) {
+                    continue;
+                }
+                const glm::vec3 normal = cross / length;
+                for (int k = 0; k < 3; ++k) {
+                    quadrics_[group_[tri[k]]].AddPlane(normal, -glm::dot(normal, p0), 0.5f * length);
+                }
+            }
+
+            // Open edges keep their vertices on the border, edges of three or more faces lock them
+            for (size_t t = 0; t < triangle_count; ++t) {
+                const GLuint* tri = &triangles_[t * 3];
+                const glm::vec3& p0 = positions_[tri[0]];
+                const glm::vec3 face_normal = glm::cross(positions_[tri[1]] - p0, positions_[tri[2]] - p0);
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t a = group_[tri[k]];
+                    const uint32_t b = group_[tri[(k + 1) % 3]];
+                    const int use = edge_use[EdgeKey(a, b)];
+                    if (use > 2) {
+                        locked_[a] = locked_[b] = true;
+                    }
+                    if (use != 1) {
+                        continue;
+                    }
+                    border_[a] = border_[b] = true;
+                    border_edges_.insert(EdgeKey(a, b));
+
+                    // Plane through the edge perpendicular to the face resists moving the border inwards
+                    const glm::vec3 edge = positions_[b] - positions_[a];
+                    const glm::vec3 side = glm::cross(edge, face_normal);
+                    const float side_length = glm::length(side);
+                    if (side_length > 0.0f) {
+                        const glm::vec3 normal = side / side_length;
+                        const float weight = kBorderWeight * glm::dot(edge, edge);
+                        quadrics_[a].AddPlane(normal, -glm::dot(normal, positions_[a]), weight);
+                        quadrics_[b].AddPlane(normal, -glm::dot(normal, positions_[a]), weight);
+                    }
+                }
+            }
+        }
+
+        bool Simplifier::Evaluate(const uint32_t from, const uint32_t to, double& cost) {
+            if (locked_[from] || removed_[to]) {
+                return false;
+            }
+            if (border_[from] && border_edges_.count(EdgeKey(from, to)) == 0) {
+                return false;
+            }
+
+            // Every wedge (attribute set) of from moves to the wedge of to it shares an edge with,
+            // a wedge without one would drag its attributes across a seam
+            partners_.clear();
+            const glm::vec3& target = positions_[to];
+            for (uint32_t t : group_triangles_[from]) {
+                if (!triangle_alive_[t]) {
+                    continue;
+                }
+                const GLuint* tri = &triangles_[size_t(t) * 3];
+                int from_corner = -1;
+                int to_corner = -1;
+                for (int k = 0; k < 3; ++k) {
+                    if (group_[tri[k]] == from) {
+                        from_corner = k;
+                    }
+                    else if (group_[tri[k]] == to) {
+                        to_corner = k;
+                    }
+                }
+                const GLuint wedge = tri[from_corner];
+                auto partner = std::find_if(partners_.begin(), partners_.end(),
+                    [wedge](const std::pair<GLuint, GLuint>& move) { return move.first == wedge; });
+                if (partner == partners_.end()) {
+                    partners_.push_back({ wedge, GLuint(-1) });
+                    partner = partners_.end() - 1;
+                }
+
+                if (to_corner >= 0) {
+                    if (partner->second != GLuint(-1) && partner->second != tri[to_corner]) {
+                        return false;  // Two wedges of to around one wedge of from
+                    }
+                    partner->second = tri[to_corner];
+                    continue;  // Collapses into an edge
+                }
+
+                // Remaining faces must not fold over
+                glm::vec3 corners[3] = { positions_[tri[0]], positions_[tri[1]], positions_[tri[2]] };
+                const glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                corners[from_corner] = target;
+                const glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                const float scale = glm::length(before) * glm::length(after);
+                if (scale <= 0.0f || glm::dot(before, after) <= kFlipThreshold * scale) {
+                    return false;
+                }
+            }
+            for (const auto& move : partners_) {
+                if (move.second == GLuint(-1)) {
+                    return false;
+                }
+            }
+
+            Quadric merged = quadrics_[from];
+            merged.Add(quadrics_[to]);
+            cost = merged.weight > 0.0 ? std::max(merged.Evaluate(target), 0.0) / merged.weight : 0.0;
+            return true;
+        }
+
+        void Simplifier::PushBest(const uint32_t group) {
+            if (removed_[group] || locked_[group]) {
+                return;
+            }
+            Candidate best{ 0.0, group, group, version_[group] };
+            bool found = false;
+            for (uint32_t t : group_triangles_[group]) {
+                if (!triangle_alive_[t]) {
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t other = group_[triangles_[size_t(t) * 3 + k]];
+                    double cost = 0.0;
+                    if (other != group && (!found || other != best.to) && Evaluate(group, other, cost) && (!found || cost < best.cost)) {
+                        best.cost = cost;
+                        best.to = other;
+                        found = true;
+                    }
+                }
+            }
+            if (found) {
+                queue_.push(best);
+            }
+        }
+
+        void Simplifier::Collapse(const uint32_t from, const uint32_t to) {
+            std::vector<uint32_t>& from_triangles = group_triangles_[from];
+            std::vector<uint32_t>& to_triangles = group_triangles_[to];
+            for (uint32_t t : from_triangles) {
+                if (!triangle_alive_[t]) {
+                    continue;
+                }
+                GLuint* tri = &triangles_[size_t(t) * 3];
+                bool touches_to = false;
+                for (int k = 0; k < 3; ++k) {
+                    touches_to |= group_[tri[k]] == to;
+                }
+                if (touches_to) {
+                    triangle_alive_[t] = false;
+                    --alive_triangles_;
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    if (group_[tri[k]] != from) {
+                        continue;
+                    }
+                    for (const auto& move : partners_) {
+                        if (move.first == tri[k]) {
+                            tri[k] = move.second;
+                            break;
+                        }
+                    }
+                }
+                to_triangles.push_back(t);
+            }
+
+            // Border edges of from now end in to
+            if (border_[from]) {
+                for (uint32_t t : to_triangles) {
+                    for (int k = 0; k < 3; ++k) {
+                        const uint32_t other = group_[triangles_[size_t(t) * 3 + k]];
+                        if (other != to && border_edges_.count(EdgeKey(from, other)) != 0) {
+                            border_edges_.insert(EdgeKey(to, other));
+                        }
+                    }
+                }
+            }
+
+            quadrics_[to].Add(quadrics_[from]);
+            removed_[from] = true;
+            from_triangles.clear();
+            from_triangles.shrink_to_fit();
+            to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(),
+                [this](uint32_t t) { return !triangle_alive_[t]; }), to_triangles.end());
+
+            // Costs and fold tests of to and its ring changed
+            ++version_[to];
+            PushBest(to);
+            std::vector<uint32_t> ring;
+            for (uint32_t t : to_triangles) {
+                for (int k = 0; k < 3; ++k) {
+                    const uint32_t other = group_[triangles_[size_t(t) * 3 + k]];
+                    if (other != to && std::find(ring.begin(), ring.end(), other) == ring.end()) {
+                        ring.push_back(other);
+                    }
+                }
+            }
+            for (uint32_t other : ring) {
+                ++version_[other];
+                PushBest(other);
+            }
+        }
+
+        void Simplifier::Emit(std::vector<Lod>& lods, const float error) const {
+            Lod lod;
+            lod.indices.reserve(alive_triangles_ * 3);
+            for (size_t t = 0; t < triangle_alive_.size(); ++t) {
+                if (triangle_alive_[t]) {
+                    lod.indices.insert(lod.indices.end(), &triangles_[t * 3], &triangles_[t * 3] + 3);
+                }
+            }
+            lod.error = error;
+            lods.push_back(std::move(lod));
+        }
+
+        std::vector<Lod> Simplifier::Run(const int max_levels, const float max_error) {
+            std::vector<Lod> lods;
+            for (size_t group = 0; group < group_.size(); ++group) {
+                if (group_[group] == group && !group_triangles_[group].empty()) {
+                    PushBest(uint32_t(group));
+                }
+            }
+
+            const double max_cost = double(max_error) * max_error;
+            size_t level_triangles = alive_triangles_;  // Triangles of the last level
+            size_t target = level_triangles / 2;
+            float error = 0.0f;
+            while (int(lods.size()) < max_levels && !queue_.empty()) {
+                const Candidate candidate = queue_.top();
+                queue_.pop();
+                if (removed_[candidate.from] || candidate.version != version_[candidate.from]) {
+                    continue;  // Superseded
+                }
+                double cost = 0.0;
+                if (!Evaluate(candidate.from, candidate.to, cost)) {
+                    PushBest(candidate.from);  // to went away or the ring changed since
+                    continue;
+                }
+                if (cost > candidate.cost) {
+                    // The neighbourhood changed since it was queued - requeue at its real cost, cheaper ones may be next
+                    queue_.push({ cost, candidate.from, candidate.to, candidate.version });
+                    continue;
+                }
+                if (cost > max_cost) {
+                    break;  // Cheapest up to date collapse is over the budget
+                }
+
+                Collapse(candidate.from, candidate.to);
+                error = std::max(error, float(std::sqrt(cost)));
+                if (alive_triangles_ <= target) {
+                    Emit(lods, error);
+                    level_triangles = alive_triangles_;
+                    target = level_triangles / 2;
+                }
+            }
+
+            // Out of cheap collapses between two levels - keep the partial one if it saves enough
+            if (int(lods.size()) < max_levels && alive_triangles_ < size_t(float(level_triangles) * kMinLevelReduction)) {
+                Emit(lods, error);
+            }
+            return lods;
+        }
+    }
+
+    std::vector<Lod> BuildLods(const Vertex* vertices, const size_t vertex_count, const GLuint* indices, const size_t index_count,
+        const int max_levels, const float max_relative_error) {
+        if (max_levels <= 0 || vertex_count == 0 || index_count < kMinTriangles * 3) {
+            return {};
+        }
+
+        glm::vec3 bounds_min(FLT_MAX);
+        glm::vec3 bounds_max(-FLT_MAX);
+        for (size_t i = 0; i < vertex_count; ++i) {
+            const glm::vec3 position = vertices[i].position;
+            bounds_min = glm::min(bounds_min, position);
+            bounds_max = glm::max(bounds_max, position);
+        }
+        const float radius = 0.5f * glm::length(bounds_max - bounds_min);
+
+        Simplifier simplifier(vertices, vertex_count, indices, index_count);
+        return simplifier.Run(max_levels, max_relative_error * radius);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "glutils.h"
+#include <vector>
+
+// Level of detail generation by quadric error edge collapses
+// Collapses move a vertex onto a neighbouring one (half-edge collapse), so every level is just another
+// index list over the source vertices and all levels of a sub-mesh share one vertex range in the GeometryPool.
+// Vertices with several attribute sets at one position (UV or normal seams) only collapse along the seam,
+// open borders (e.g. foliage cards) only along the border, so the outline and texturing survive.
+namespace meshsimplify {
+
+    struct Lod {
+        std::vector<GLuint> indices;
+        float error{ 0.0f };  // Distance estimate between this level and the source surface, in object units
+    };
+
+    // Coarser levels of an indexed triangle list, each with about half the triangles of the one before
+    // Stops early once a collapse would cost more than max_relative_error of the mesh radius or a level
+    // would not remove enough triangles to be worth it. Meshes below a few dozen triangles get no levels.
+    std::vector<Lod> BuildLods(const Vertex* vertices, const size_t vertex_count, const GLuint* indices, const size_t index_count,
+        const int max_levels, const float max_relative_error = 0.1f);
+}
@@ -0,0 +1,177 @@
+#include "occlusionculler.h"
+#include <iostream>
+#include <algorithm>
+
+static const GLuint PYRAMID_UNIT = 4;  // Texture unit of the sampled depth, unit 3 is the shadow map
+
+OcclusionCuller::~OcclusionCuller() {
+    ReleasePyramid();
+    if (counters_[0] != 0) {
+        glDeleteBuffers(STATS_FRAMES, counters_);
+    }
+}
+
+int OcclusionCuller::Init() {
+    if (resolve_program_.LoadCompute("hiz_resolve.comp") != S_OK ||
+        downsample_program_.LoadCompute("hiz_downsample.comp") != S_OK ||
+        cull_program_.LoadCompute("hiz_cull.comp") != S_OK) {
+        printf("Occlusion culling error: Compute programs failed to load.\n");
+        return S_FALSE;
+    }
+
+    downsample_uniforms_.source = downsample_program_.uniform<GLint>("source");
+    downsample_uniforms_.source_level = downsample_program_.uniform<GLint>("source_level");
+    downsample_uniforms_.source.Set(GLint(PYRAMID_UNIT));
+    resolve_program_.uniform<GLint>("source").Set(GLint(PYRAMID_UNIT));
+    cull_uniforms_.depth_pyramid = cull_program_.uniform<GLint>("depth_pyramid");
+    cull_uniforms_.pyramid_VP = cull_program_.uniform<glm::mat4>("pyramid_VP");
+    cull_uniforms_.first_command = cull_program_.uniform<GLuint>("first_command");
+    cull_uniforms_.command_count = cull_program_.uniform<GLuint>("command_count");
+    cull_uniforms_.depth_pyramid.Set(GLint(PYRAMID_UNIT));
+
+    glCreateBuffers(STATS_FRAMES, counters_);
+    for (GLuint buffer : counters_) {
+        glNamedBufferStorage(buffer, sizeof(Stats), nullptr, 0);
+    }
+    return S_OK;
+}
+
+void OcclusionCuller::ReleasePyramid() {
+    if (pyramid_ != 0) {
+        glDeleteFramebuffers(1, &depth_copy_fbo_);
+        glDeleteTextures(1, &depth_copy_);
+        glDeleteTextures(1, &pyramid_);
+        depth_copy_fbo_ = depth_copy_ = pyramid_ = 0;
+    }
+    captured_ = false;
+    pyramid_valid_ = false;
+}
+
+void OcclusionCuller::CaptureDepth(const GLsizei width, const GLsizei height, const glm::mat4& VP) {
+    if (!valid() || width <= 0 || height <= 0) {
+        captured_ = false;
+        return;
+    }
+
+    if (width != width_ || height != height_ || pyramid_ == 0) {
+        ReleasePyramid();
+        width_ = width;
+        height_ = height;
+        levels_ = 1;
+        while ((std::max(width, height) >> levels_) > 0) {
+            ++levels_;
+        }
+
+        // Blitting depth needs the default framebuffer's exact format and sample count. A resolving blit would
+        // keep one sample per pixel, not the farthest, so multisampled depth is copied as is and resolved later
+        samples_ = 0;
+        glGetNamedFramebufferParameteriv(0, GL_SAMPLES, &samples_);
+        GLint depth_bits = 0;
+        GLint stencil_bits = 0;
+        GLint component_type = GL_NONE;
+        glGetNamedFramebufferAttachmentParameteriv(0, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depth_bits);
+        glGetNamedFramebufferAttachmentParameteriv(0, GL_STENCIL, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencil_bits);
+        glGetNamedFramebufferAttachmentParameteriv(0, GL_DEPTH, GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &component_type);
+        GLenum depth_format = GL_DEPTH_COMPONENT24;
+        if (component_type == GL_FLOAT) {
+            depth_format = stencil_bits > 0 ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F;
+        }
+        else if (depth_bits <= 16) {
+            depth_format = GL_DEPTH_COMPONENT16;
+        }
+        else if (depth_bits <= 24) {
+            depth_format = stencil_bits > 0 ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24;
+        }
+        else {
+            depth_format = GL_DEPTH_COMPONENT32;
+        }
+
+        if (samples_ > 0) {
+            glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &depth_copy_);
+            glTextureStorage2DMultisample(depth_copy_, samples_, depth_format, width, height, GL_TRUE);
+        }
+        else {
+            glCreateTextures(GL_TEXTURE_2D, 1, &depth_copy_);
+            glTextureStorage2D(depth_copy_, 1, depth_format, width, height);
+            glTextureParameteri(depth_copy_, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTextureParameteri(depth_copy_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        glTextureParameteri(depth_copy_, GL_DEPTH_STENCIL_TEXTURE_MODE, GL_DEPTH_COMPONENT);
+        glCreateFramebuffers(1, &depth_copy_fbo_);
+        glNamedFramebufferTexture(depth_copy_fbo_, stencil_bits > 0 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, depth_copy_, 0);
+        glNamedFramebufferDrawBuffer(depth_copy_fbo_, GL_NONE);
+        glNamedFramebufferReadBuffer(depth_copy_fbo_, GL_NONE);
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &pyramid_);
+        glTextureStorage2D(pyramid_, levels_, GL_R32F, width, height);
+        glTextureParameteri(pyramid_, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTextureParameteri(pyramid_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        std::cout << "Depth pyramid: " << width << "x" << height << ", " << levels_ << " levels, "
+            << samples_ << " samples" << std::endl;
+    }
+
+    glBlitNamedFramebuffer(0, depth_copy_fbo_, 0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    captured_VP_ = VP;
+    captured_ = true;
+}
+
+void OcclusionCuller::BuildPyramid() {
+    if (!captured_) {
+        pyramid_valid_ = false;
+        return;
+    }
+
+    // Level 0 is the depth itself (farthest sample of each pixel), every further level the max over its
+    // footprint in the level above
+    GLsizei level_width = width_;
+    GLsizei level_height = height_;
+    for (int level = 0; level < levels_; ++level) {
+        const bool resolve = level == 0 && samples_ > 0;
+        glUseProgram(resolve ? resolve_program_.id() : downsample_program_.id());
+        glBindTextureUnit(PYRAMID_UNIT, level == 0 ? depth_copy_ : pyramid_);
+        downsample_uniforms_.source_level.Set(GLint(std::max(level - 1, 0)));
+        glBindImageTexture(0, pyramid_, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute(GLuint((level_width + 7) / 8), GLuint((level_height + 7) / 8), 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        level_width = std::max(level_width / 2, 1);
+        level_height = std::max(level_height / 2, 1);
+    }
+    glBindTextureUnit(PYRAMID_UNIT, 0);
+
+    pyramid_VP_ = captured_VP_;
+    pyramid_valid_ = true;
+    captured_ = false;
+}
+
+void OcclusionCuller::Cull(const GLuint indirect_buffer, const GLintptr indirect_offset, const GLuint bounds_ssbo, const GLintptr bounds_offset,
+    const GLuint first, const GLsizei count) {
+    if (!valid() || !pyramid_valid_ || count == 0) {
+        return;
+    }
+
+    // Counters of this slot were written STATS_FRAMES frames ago, the GPU is done with them by now
+    const int slot = frame_++ % STATS_FRAMES;
+    if (counters_pending_[slot]) {
+        glGetNamedBufferSubData(counters_[slot], 0, sizeof(Stats), &stats_);
+    }
+    const GLuint zero = 0;
+    glClearNamedBufferData(counters_[slot], GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    counters_pending_[slot] = true;
+
+    glUseProgram(cull_program_.id());
+    cull_uniforms_.pyramid_VP.Set(pyramid_VP_);
+    cull_uniforms_.first_command.Set(first);
+    cull_uniforms_.command_count.Set(GLuint(count));
+    glBindTextureUnit(PYRAMID_UNIT, pyramid_);
+    const GLsizeiptr command_count = GLsizeiptr(first) + count;
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, indirect_buffer, indirect_offset, command_count * 5 * sizeof(GLuint));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, bounds_ssbo, bounds_offset, command_count * sizeof(DrawBounds));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTERS_BINDING, counters_[slot]);
+    glDispatchCompute(GLuint((count + GROUP_SIZE - 1) / GROUP_SIZE), 1, 1);
+
+    // The commands are read by the following multi-draws
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    glBindTextureUnit(PYRAMID_UNIT, 0);
+}
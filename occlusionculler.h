@@ -0,0 +1,91 @@
+#pragma once
+#include "glutils.h"
+#include "shaderprogram.h"
+
+// Hierarchical-Z occlusion culling of multi-draw indirect commands
+// Once the opaque geometry is drawn CaptureDepth() copies the default framebuffer's depth, before blended
+// foliage writes to it, and after the main pass BuildPyramid() reduces the copy into a max-depth mip chain
+// (hiz_resolve.comp takes the farthest sample of a multisampled copy, hiz_downsample.comp the levels). Next frame Cull() projects each command's world box with the
+// matrix that depth was rendered with, picks the pyramid level where the box covers at most 2x2 texels and
+// zeroes the command's instance count when the box's nearest depth lies behind all four (hiz_cull.comp).
+// The test runs one frame late, so an object uncovered by a fast camera move may appear a frame late.
+class OcclusionCuller {
+public:
+    static const GLuint COMMANDS_BINDING = 8;  // Bindings as declared in hiz_cull.comp
+    static const GLuint BOUNDS_BINDING = 9;
+    static const GLuint COUNTERS_BINDING = 10;
+    static const GLuint GROUP_SIZE = 64;
+    static const int STATS_FRAMES = 3;  // Counters are read this many frames late, so they never stall
+
+    // World box of one indirect command (std430 DrawBounds in hiz_cull.comp)
+    struct DrawBounds {
+        glm::vec4 min;
+        glm::vec4 max;
+    };
+
+    struct Stats {
+        GLuint tested{ 0 };
+        GLuint occluded{ 0 };
+        GLuint occluded_triangles{ 0 };
+    };
+
+    OcclusionCuller() = default;
+    ~OcclusionCuller();
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+    // Loads the compute passes, returns S_OK or S_FALSE
+    int Init();
+    bool valid() const { return downsample_program_.valid() && cull_program_.valid(); }
+
+    // Copies the default framebuffer's depth as rendered with VP, (re)allocated when the size changes
+    void CaptureDepth(const GLsizei width, const GLsizei height, const glm::mat4& VP);
+    // Depth pyramid of the last capture
+    void BuildPyramid();
+    bool has_pyramid() const { return pyramid_valid_; }
+    // The next Cull() is skipped, e.g. after a camera cut
+    void InvalidatePyramid() { pyramid_valid_ = false; }
+
+    // Zeroes instance_count of the commands [first, first + count) in indirect_buffer hidden behind the pyramid
+    // bounds_ssbo holds one DrawBounds per command of indirect_buffer, both start at the given byte offsets
+    // (SSBO offset aligned)
+    void Cull(const GLuint indirect_buffer, const GLintptr indirect_offset, const GLuint bounds_ssbo, const GLintptr bounds_offset,
+        const GLuint first, const GLsizei count);
+
+    // Counters of the Cull() STATS_FRAMES frames ago
+    const Stats& stats() const { return stats_; }
+
+private:
+    void ReleasePyramid();
+
+    ShaderProgram resolve_program_;
+    ShaderProgram downsample_program_;
+    ShaderProgram cull_program_;
+    struct DownsampleUniforms {
+        Uniform<GLint> source;
+        Uniform<GLint> source_level;
+    } downsample_uniforms_;
+    struct CullUniforms {
+        Uniform<GLint> depth_pyramid;
+        Uniform<glm::mat4> pyramid_VP;
+        Uniform<GLuint> first_command;
+        Uniform<GLuint> command_count;
+    } cull_uniforms_;
+
+    GLuint depth_copy_{ 0 };  // Copy of the default framebuffer's depth, multisampled like it
+    GLuint depth_copy_fbo_{ 0 };
+    GLint samples_{ 0 };
+    GLuint pyramid_{ 0 };     // R32F, max depth of each texel's footprint
+    GLsizei width_{ 0 };
+    GLsizei height_{ 0 };
+    int levels_{ 0 };
+    glm::mat4 captured_VP_{ 1.0f };
+    glm::mat4 pyramid_VP_{ 1.0f };
+    bool captured_{ false };
+    bool pyramid_valid_{ false };
+
+    GLuint counters_[STATS_FRAMES]{};
+    bool counters_pending_[STATS_FRAMES]{};
+    int frame_{ 0 };
+    Stats stats_;
+};
@@ -0,0 +1,29 @@
+#version 460 core
+
+in float life;
+in vec4 color;
+flat in vec2 sprite_falloff;
+
+out vec4 FragColor;
+
+void main()
+{
+    // Discard dead particles
+    if (life <= 0.0) discard;
+
+    vec2 coord = gl_PointCoord * 2.0 - 1.0;
+
+    // Per-axis falloff, e.g. narrow horizontally and stretched vertically for rain streaks
+    float streak_x = abs(coord.x) * sprite_falloff.x;
+    float streak_y = abs(coord.y) * sprite_falloff.y;
+
+    // Combined distance for elongated shape
+    float dist = streak_x * streak_x + streak_y * streak_y;
+
+    // Soft falloff
+    float alpha = exp(-dist * 2.0) * life * color.a;
+
+    if (alpha < 0.1) discard;
+
+    FragColor = vec4(color.rgb, alpha);
+}
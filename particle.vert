@@ -0,0 +1,31 @@
+#version 460 core
+
+// No attributes - particle state comes from the compute simulation, one point per alive particle
+
+#include "frame_constants.glsl"
+#include "particles.glsl"
+
+// Output to fragment shader
+out float life;
+out vec4 color;
+flat out vec2 sprite_falloff;
+
+void main()
+{
+    Particle particle = particles[alive_indices[gl_VertexID]];
+    Emitter emitter = emitters[floatBitsToUint(particle.velocity_slot.w)];
+    vec3 pos = particle.position_life.xyz;
+
+    life = particle.position_life.w;
+    color = emitter.color;
+    sprite_falloff = vec2(emitter.velocity_max.w, emitter.acceleration.w);
+
+    // Transform to clip space
+    gl_Position = frame.VP * vec4(pos, 1.0);
+
+    // Point size based on distance with twinkle effect
+    float size = emitter.velocity_min.w;
+    float dist = max(length(pos - frame.camera_pos_ws.xyz), 1.0);
+    float twinkle = 0.85 + 0.25 * sin(frame.time * 12.0 + pos.x + pos.y);
+    gl_PointSize = clamp((size / dist) * twinkle, size * 0.025, size * 0.1);
+}
@@ -0,0 +1,66 @@
+// GPU particle state shared by the particles_*.comp passes and particle.vert (std430)
+
+struct Particle {
+    vec4 position_life;  // xyz world position, w life (1 at spawn, <= 0 dead)
+    vec4 velocity_slot;  // xyz velocity, w emitter slot (floatBitsToUint)
+};
+
+// Mirror of GPUParticleSystem::Emitter, one row per component::ParticleEmitter slot
+struct Emitter {
+    vec4 origin;        // xyz spawn origin, w 1 active, 0 destroyed (its particles die)
+    vec4 spawn_min;     // xyz, w life decay per second
+    vec4 spawn_max;     // xyz, w kill height
+    vec4 velocity_min;  // xyz, w point size at 1 m
+    vec4 velocity_max;  // xyz, w sprite falloff along x
+    vec4 acceleration;  // xyz, w sprite falloff along y
+    vec4 color;
+    uvec4 spawn;        // x first spawn invocation this frame, y spawn count, zw unused
+};
+
+layout(std430, binding = 3) buffer Particles {
+    Particle particles[];
+};
+
+// Indices of dead particles, a stack of dead_count entries
+layout(std430, binding = 4) buffer DeadList {
+    uint dead_indices[];
+};
+
+// Indices of particles alive after this frame's simulation, drawn by gl_VertexID
+layout(std430, binding = 5) buffer AliveList {
+    uint alive_indices[];
+};
+
+// Counters and indirect arguments, written and consumed on the GPU only
+layout(std430, binding = 6) buffer ParticleCounters {
+    uint draw_count;           // DrawArraysIndirectCommand
+    uint draw_instance_count;
+    uint draw_first;
+    uint draw_base_instance;
+    uint emit_groups_x;        // DispatchIndirectCommand of the emit pass
+    uint emit_groups_y;
+    uint emit_groups_z;
+    uint dead_count;
+    uint emit_count;           // Particles spawned this frame
+    uint frame;
+    uint padding[2];
+} counters;
+
+layout(std430, binding = 7) readonly buffer Emitters {
+    Emitter emitters[];
+};
+
+#define PARTICLE_GROUP_SIZE 64  // local_size_x of the per-particle passes, must match GPUParticleSystem::GROUP_SIZE
+
+// PCG hash, good enough to decorrelate neighbouring particles and frames
+uint hash(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Uniform in [0, 1), advances the seed
+float random(inout uint seed) {
+    seed = hash(seed);
+    return float(seed >> 8) * (1.0 / 16777216.0);
+}
@@ -9,71 +9,21 @@ in vec3 normal_ws;
 in vec3 tangent_ws;
 in vec3 bitangent_ws;
 in vec2 tex_coord;
-in vec4 position_lcs;  // Position in light clip space
 flat in int material_index;
 
 // Outputs
 layout (location = 0) out vec4 FragColor;
 
-struct Material {
-    vec3 diffuse;
-    uvec2 tex_diffuse;
-    vec3 rma;
-    uvec2 tex_rma;
-    vec3 normal;
-    uvec2 tex_normal;
-};
+#include "materials.glsl"
 
-// SSBO for materials
-layout(std430, binding = 0) readonly buffer Materials {
-    Material materials[];
-};
+#include "frame_constants.glsl"
 
-// Uniform variables
-uniform vec3 light_ws;
-uniform vec3 camera_pos_ws;
-uniform vec3 light_color;
-uniform vec3 ambient_color;
-uniform sampler2D shadow_map;  // Shadow depth map
-
-// Calculate shadow using PCF (Percentage Closer Filtering)
-float CalculateShadow(vec4 pos_lcs, vec3 normal, vec3 light_dir)
-{
-    // Perspective divide (convert from clip space to NDC)
-    vec3 proj_coords = pos_lcs.xyz / pos_lcs.w;
-
-    // Transform from NDC [-1,1] to texture coordinates [0,1]
-    proj_coords = proj_coords * 0.5 + 0.5;
-
-    // If outside light frustum, no shadow
-    if (proj_coords.z > 1.0)
-        return 1.0;
-
-    // Bias to prevent shadow acne (slope-scaled bias)
-    float bias = max(0.005 * (1.0 - dot(normal, light_dir)), 0.001);
-
-    // PCF: sample surrounding texels for softer shadows
-    float shadow = 0.0;
-    vec2 texel_size = 1.0 / textureSize(shadow_map, 0);
-    const int pcf_radius = 2;
-
-    for (int y = -pcf_radius; y <= pcf_radius; ++y) {
-        for (int x = -pcf_radius; x <= pcf_radius; ++x) {
-            float depth = texture(shadow_map, proj_coords.xy + vec2(x, y) * texel_size).r;
-            // 1.0 if lit, 0.0 if in shadow (more contrast)
-            shadow += (depth + bias >= proj_coords.z) ? 1.0 : 0.0;
-        }
-    }
-
-    // Average the samples
-    float samples = (2 * pcf_radius + 1) * (2 * pcf_radius + 1);
-    return shadow / samples;
-}
+#include "shadow_filter.glsl"
 
 void main(void)
 {
     // Get material from SSBO
-    Material mat = materials[material_index];
+    Material mat = get_material(material_index);
 
     // Get diffuse color with alpha
     vec4 diffuse_rgba = vec4(mat.diffuse, 1.0);
@@ -95,7 +45,9 @@ void main(void)
         vec3 B = normalize(bitangent_ws);
         mat3 TBN = mat3(T, B, N);
         
-        vec3 normal_ts = texture(sampler2D(mat.tex_normal), tex_coord).rgb * 2.0 - 1.0;
+        // BC5 normal maps store x and y only
+        vec2 normal_xy = texture(sampler2D(mat.tex_normal), tex_coord).rg * 2.0 - 1.0;
+        vec3 normal_ts = vec3(normal_xy, sqrt(max(1.0 - dot(normal_xy, normal_xy), 0.0)));
         N = normalize(TBN * normal_ts);
     }*/
     
@@ -112,12 +64,14 @@ void main(void)
     }
     
     // Lighting calculations
+    vec3 light_ws = frame.light_ws.xyz;
+    vec3 light_color = frame.light_color.rgb;
     vec3 L = normalize(light_ws - position_ws);
-    vec3 V = normalize(camera_pos_ws - position_ws);
+    vec3 V = normalize(frame.camera_pos_ws.xyz - position_ws);
     vec3 H = normalize(L + V);
     
     // Ambient with AO
-    vec3 ambient = ambient_color * diffuse_color * ao;
+    vec3 ambient = frame.ambient_color.rgb * diffuse_color * ao;
     
     // Diffuse
     float NdotL = max(dot(N, L), 0.0);
@@ -134,7 +88,7 @@ void main(void)
     float attenuation = 1.0 / (1.0 + 0.0001 * distance);  // Much gentler falloff
 
     // Calculate shadow
-    float shadow = CalculateShadow(position_lcs, N, L);
+    float shadow = CalculateShadow(position_ws, N, L);
 
     // Final color with shadow applied to direct lighting
     vec3 result = ambient + attenuation * shadow * (diffuse + specular);
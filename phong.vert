@@ -5,31 +5,28 @@ layout (location = 1) in vec3 in_normal_ms;
 layout (location = 2) in vec3 in_tangent_ms;
 layout (location = 3) in vec2 in_tex_coord;
 layout (location = 4) in int in_mat_idx;
-// Uniform variables
-uniform mat4 M;   // Model matrix
-uniform mat3 Mn;  // Normal matrix
-uniform mat4 V;   // View matrix
-uniform mat4 P;   // Projection matrix
-uniform mat4 light_space_matrix;  // Light's projection * view matrix
+#include "frame_constants.glsl"
+#include "draw_data.glsl"
 // Outputs to fragment shader
 out vec3 position_ws;
 out vec3 normal_ws;
 out vec3 tangent_ws;
 out vec3 bitangent_ws;
 out vec2 tex_coord;
-out vec4 position_lcs;  // Position in light clip space for shadow mapping
 flat out int material_index;
+// Bit-identical to depth_prepass.vert so the GL_EQUAL depth test after a pre-pass never rejects
+invariant gl_Position;
 void main(void)
 {
+    mat4 M = draws[gl_BaseInstance].M;
+    mat3 Mn = mat3(draws[gl_BaseInstance].Mn);
+
     // Transform position to world space
-    vec4 pos_ws = M * in_position_ms;
+    vec4 pos_ws = M * decode_position(in_position_ms, gl_BaseInstance);
     position_ws = pos_ws.xyz / pos_ws.w;
 
     // Transform to clip space for rasterization
-    gl_Position = P * V * pos_ws;
-
-    // Transform to light clip space for shadow mapping
-    position_lcs = light_space_matrix * pos_ws;
+    gl_Position = frame.VP * pos_ws;
 
     // Transform normal to world space
     vec3 norm_ws = Mn * in_normal_ms;
@@ -47,5 +44,5 @@ void main(void)
 
     // Pass through texture coordinates and material index
     tex_coord = vec2(in_tex_coord.x, 1.0f - in_tex_coord.y);
-    material_index = in_mat_idx;
+    material_index = in_mat_idx + draws[gl_BaseInstance].material_offset.x;
 }
\ No newline at end of file
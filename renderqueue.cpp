@@ -0,0 +1,198 @@
+#include "renderqueue.h"
+#include <algorithm>
+#include <cstring>
+
+static const GLuint UNKNOWN_BINDING = 0xFFFFFFFFu;
+static const size_t INDIRECT_COMMAND_SIZE = 5 * sizeof(GLuint);  // DrawElementsIndirectCommand
+
+uint64_t RenderQueue::MakeKey(const RenderPass pass, const GLuint program, const GLuint binding_set, const GLuint vao, const float depth) {
+    const uint64_t quantized_depth = uint64_t(std::clamp(depth, 0.0f, 1.0f) * float(0xFFFFFF));
+    const uint64_t state = (uint64_t(program & 0xFF) << 28) | (uint64_t(binding_set & 0xFFFF) << 12) | uint64_t(vao & 0xFFF);
+    const uint64_t key = uint64_t(pass) << 60;
+
+    if (pass == RenderPass::TRANSPARENT || pass == RenderPass::EFFECTS) {
+        return key | ((0xFFFFFF - quantized_depth) << 36) | state;
+    }
+    return key | (state << 24) | quantized_depth;
+}
+
+void RenderQueue::Clear() {
+    packets_.clear();
+    stats_ = {};
+
+    // Anything may have been bound since the last submission
+    bound_program_ = UNKNOWN_BINDING;
+    bound_vao_ = UNKNOWN_BINDING;
+    bound_indirect_buffer_ = UNKNOWN_BINDING;
+    std::fill(std::begin(bound_ssbos_), std::end(bound_ssbos_), UNKNOWN_BINDING);
+    bound_state_ = RenderState::UNKNOWN;
+}
+
+void RenderQueue::Sort() {
+    const size_t count = packets_.size();
+    keys_.resize(count);
+    order_.resize(count);
+    keys_swap_.resize(count);
+    order_swap_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys_[i] = packets_[i].key;
+        order_[i] = uint32_t(i);
+    }
+
+    // LSD radix sort, 8 bits per pass - stable, so equal keys keep their submission order
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[257] = {};
+        for (size_t i = 0; i < count; ++i) {
+            ++histogram[((keys_[i] >> shift) & 0xFF) + 1];
+        }
+        // All keys share this digit - nothing to move (typical for the pass and program bytes)
+        if (std::find(std::begin(histogram) + 1, std::end(histogram), count) != std::end(histogram)) {
+            continue;
+        }
+        for (int digit = 0; digit < 256; ++digit) {
+            histogram[digit + 1] += histogram[digit];
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const size_t destination = histogram[(keys_[i] >> shift) & 0xFF]++;
+            keys_swap_[destination] = keys_[i];
+            order_swap_[destination] = order_[i];
+        }
+        keys_.swap(keys_swap_);
+        order_.swap(order_swap_);
+    }
+}
+
+void RenderQueue::ApplyState(const RenderState state) {
+    if (state == bound_state_) {
+        ++stats_.state_changes_saved;
+        return;
+    }
+    ++stats_.state_changes;
+    bound_state_ = state;
+
+    const bool blend = state == RenderState::ALPHA_TWO_SIDED || state == RenderState::ALPHA_POINTS;
+    if (blend) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else {
+        glDisable(GL_BLEND);
+    }
+    const bool opaque = state == RenderState::OPAQUE || state == RenderState::DEPTH_ONLY || state == RenderState::OPAQUE_EQUAL;
+    if (opaque) {
+        glEnable(GL_CULL_FACE);
+    }
+    else {
+        glDisable(GL_CULL_FACE);
+    }
+    const GLboolean color_write = state == RenderState::DEPTH_ONLY ? GL_FALSE : GL_TRUE;
+    glColorMask(color_write, color_write, color_write, color_write);
+    const bool depth_write = state == RenderState::OPAQUE || state == RenderState::DEPTH_ONLY || state == RenderState::ALPHA_TWO_SIDED;
+    glDepthMask(depth_write ? GL_TRUE : GL_FALSE);
+    if (state == RenderState::SKY) {
+        glDepthFunc(GL_LEQUAL);
+    }
+    else if (state == RenderState::OPAQUE_EQUAL) {
+        glDepthFunc(GL_EQUAL);
+    }
+    else {
+        glDepthFunc(GL_LESS);
+    }
+    if (state == RenderState::ALPHA_POINTS) {
+        glEnable(GL_PROGRAM_POINT_SIZE);
+    }
+    else {
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+}
+
+void RenderQueue::Submit() {
+    stats_.packets = int(packets_.size());
+
+    for (const uint32_t index : order_) {
+        const DrawPacket& packet = packets_[index];
+
+        ApplyState(packet.state);
+
+        if (packet.program != bound_program_) {
+            glUseProgram(packet.program);
+            bound_program_ = packet.program;
+            ++stats_.program_binds;
+            ++stats_.state_changes;
+        }
+        else {
+            ++stats_.state_changes_saved;
+        }
+
+        if (packet.kind != DrawPacket::Kind::CALLBACK) {
+            if (packet.vao != bound_vao_) {
+                glBindVertexArray(packet.vao);
+                bound_vao_ = packet.vao;
+                ++stats_.vao_binds;
+                ++stats_.state_changes;
+            }
+            else {
+                ++stats_.state_changes_saved;
+            }
+        }
+
+        if (packet.ssbo != 0 && packet.ssbo_binding < 8) {
+            if (bound_ssbos_[packet.ssbo_binding] != packet.ssbo || bound_ssbo_offsets_[packet.ssbo_binding] != packet.ssbo_offset) {
+                if (packet.ssbo_size > 0) {
+                    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, packet.ssbo_binding, packet.ssbo, packet.ssbo_offset, packet.ssbo_size);
+                }
+                else {
+                    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, packet.ssbo_binding, packet.ssbo);
+                }
+                bound_ssbos_[packet.ssbo_binding] = packet.ssbo;
+                bound_ssbo_offsets_[packet.ssbo_binding] = packet.ssbo_offset;
+                ++stats_.state_changes;
+            }
+            else {
+                ++stats_.state_changes_saved;
+            }
+        }
+
+        if (packet.model) {
+            packet.model_uniform.Set(*packet.model);
+        }
+        if (packet.normal) {
+            packet.normal_uniform.Set(*packet.normal);
+        }
+        if (packet.position_offset) {
+            packet.position_offset_uniform.Set(*packet.position_offset);
+            packet.position_scale_uniform.Set(*packet.position_scale);
+        }
+        if (packet.material_offset) {
+            packet.material_offset_uniform.Set(*packet.material_offset);
+        }
+
+        switch (packet.kind) {
+        case DrawPacket::Kind::ARRAYS:
+            glDrawArrays(packet.mode, GLint(packet.first), packet.count);
+            break;
+        case DrawPacket::Kind::ELEMENTS_INSTANCED:
+            glDrawElementsInstancedBaseVertexBaseInstance(packet.mode, packet.count, packet.index_type,
+                (void*)(size_t(packet.first) * (packet.index_type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint))),
+                packet.instance_count, packet.base_vertex, packet.base_instance);
+            break;
+        case DrawPacket::Kind::MULTI_INDIRECT:
+            if (packet.indirect_buffer != bound_indirect_buffer_) {
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, packet.indirect_buffer);
+                bound_indirect_buffer_ = packet.indirect_buffer;
+            }
+            glMultiDrawElementsIndirect(packet.mode, packet.index_type,
+                (void*)(size_t(packet.indirect_offset) + size_t(packet.first) * INDIRECT_COMMAND_SIZE), packet.count, 0);
+            break;
+        case DrawPacket::Kind::CALLBACK:
+            packet.execute(packet.object);
+            bound_vao_ = UNKNOWN_BINDING;
+            bound_indirect_buffer_ = UNKNOWN_BINDING;
+            std::fill(std::begin(bound_ssbos_), std::end(bound_ssbos_), UNKNOWN_BINDING);
+            break;
+        }
+    }
+
+    ApplyState(RenderState::OPAQUE);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "glutils.h"
+#include "shaderprogram.h"
+#include <cstdint>
+
+// Order of the sections in a frame, the top 4 bits of a sort key
+enum class RenderPass : uint8_t {
+    DEPTH_PREPASS = 0,  // Depth of opaque geometry only, front to back
+    OPAQUE = 1,         // Front to back
+    SKY = 2,            // After opaque geometry so only uncovered pixels are shaded
+    TRANSPARENT = 3,    // Back to front
+    EFFECTS = 4         // Particles, back to front
+};
+
+// Fixed-function state a packet is drawn with, switched only when it differs from the previous packet
+enum class RenderState : uint8_t {
+    OPAQUE,           // Depth test and write, back-face culling, no blending
+    DEPTH_ONLY,       // As OPAQUE with color writes off (depth pre-pass)
+    OPAQUE_EQUAL,     // Depth EQUAL without writes after a depth pre-pass, each pixel is shaded once
+    SKY,              // Depth LEQUAL without writes, no culling
+    ALPHA_TWO_SIDED,  // Alpha blending, no culling (foliage)
+    ALPHA_POINTS,     // Alpha blending, no depth writes, point size from the shader
+    UNKNOWN
+};
+
+// One draw call and everything it needs bound
+struct DrawPacket {
+    enum class Kind : uint8_t {
+        ARRAYS,              // glDrawArrays(mode, first, count)
+        ELEMENTS_INSTANCED,  // glDrawElementsInstancedBaseVertexBaseInstance of count indices from first
+        MULTI_INDIRECT,      // glMultiDrawElementsIndirect of count commands from first in indirect_buffer
+        CALLBACK             // execute(object) issues its own draw, the VAO and buffer bindings are re-read afterwards
+    };
+
+    uint64_t key{ 0 };
+    Kind kind{ Kind::ARRAYS };
+    RenderState state{ RenderState::OPAQUE };
+    GLenum mode{ GL_TRIANGLES };
+    GLuint program{ 0 };
+    GLuint vao{ 0 };
+    GLuint first{ 0 };
+    GLsizei count{ 0 };
+    GLint base_vertex{ 0 };
+    GLenum index_type{ GL_UNSIGNED_INT };  // Of the element kinds
+    GLsizei instance_count{ 1 };
+    GLuint base_instance{ 0 };  // gl_BaseInstance, e.g. the first instance of a level of detail
+    GLuint indirect_buffer{ 0 };
+    GLintptr indirect_offset{ 0 };  // Byte offset of command 0 in indirect_buffer (a stream buffer region)
+    GLuint ssbo{ 0 };  // Bound to ssbo_binding when non zero (instances, draw data)
+    GLuint ssbo_binding{ 0 };
+    GLintptr ssbo_offset{ 0 };  // With ssbo_size, a range of ssbo instead of the whole buffer
+    GLsizeiptr ssbo_size{ 0 };
+
+    // Optional per-object uniforms
+    Uniform<glm::mat4> model_uniform;
+    Uniform<glm::mat3> normal_uniform;
+    const glm::mat4* model{ nullptr };
+    const glm::mat3* normal{ nullptr };
+    Uniform<glm::vec3> position_offset_uniform;  // Dequantisation of compact positions (GLMesh)
+    Uniform<glm::vec3> position_scale_uniform;
+    const glm::vec3* position_offset{ nullptr };
+    const glm::vec3* position_scale{ nullptr };
+    Uniform<GLint> material_offset_uniform;  // GLMesh::material_offset
+    const GLint* material_offset{ nullptr };
+
+    void (*execute)(const void* object) { nullptr };
+    const void* object{ nullptr };
+};
+
+// Draw packets of all passes collected into one flat array, radix sorted by key and submitted in order
+// Bound program, VAO, storage buffers and fixed-function state are tracked so only real changes reach GL.
+class RenderQueue {
+public:
+    // Key layout, most significant bits first:
+    //   DEPTH_PREPASS, OPAQUE, SKY: pass:4 | program:8 | binding set:16 | vao:12 | depth:24 (front to back)
+    //   TRANSPARENT, EFFECTS:       pass:4 | depth:24 (back to front) | program:8 | binding set:16 | vao:12
+    // Materials are bindless and live in one SSBO, so the binding set stands for the per-draw buffer (e.g. instances).
+    // depth is the view distance normalised to [0, 1].
+    static uint64_t MakeKey(const RenderPass pass, const GLuint program, const GLuint binding_set, const GLuint vao, const float depth);
+
+    struct Stats {
+        int packets{ 0 };
+        int state_changes{ 0 };        // Program, VAO, buffer and fixed-function switches issued
+        int state_changes_saved{ 0 };  // Redundant switches skipped - one per packet and kind of state without the tracking
+        int program_binds{ 0 };
+        int vao_binds{ 0 };
+    };
+
+    void Clear();
+    void Push(const DrawPacket& packet) { packets_.push_back(packet); }
+
+    void Sort();
+
+    // Issues all packets in the order of the last Sort(), leaves RenderState::OPAQUE state behind
+    void Submit();
+
+    const Stats& stats() const { return stats_; }
+    bool empty() const { return packets_.empty(); }
+
+private:
+    void ApplyState(const RenderState state);
+
+    std::vector<DrawPacket> packets_;
+    std::vector<uint64_t> keys_;        // Sort scratch, (key, index) pairs kept across frames
+    std::vector<uint32_t> order_;
+    std::vector<uint64_t> keys_swap_;
+    std::vector<uint32_t> order_swap_;
+
+    GLuint bound_program_{ 0 };
+    GLuint bound_vao_{ 0 };
+    GLuint bound_indirect_buffer_{ 0 };
+    GLuint bound_ssbos_[8]{};
+    GLintptr bound_ssbo_offsets_[8]{};
+    RenderState bound_state_{ RenderState::UNKNOWN };
+    Stats stats_;
+};
@@ -0,0 +1,188 @@
+#include "shaderprogram.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+
+template <> void Uniform<GLint>::Set(const GLint& value) const {
+    if (location_ != -1) glProgramUniform1i(program_, location_, value);
+}
+
+template <> void Uniform<GLuint>::Set(const GLuint& value) const {
+    if (location_ != -1) glProgramUniform1ui(program_, location_, value);
+}
+
+template <> void Uniform<GLfloat>::Set(const GLfloat& value) const {
+    if (location_ != -1) glProgramUniform1f(program_, location_, value);
+}
+
+template <> void Uniform<glm::vec3>::Set(const glm::vec3& value) const {
+    if (location_ != -1) glProgramUniform3fv(program_, location_, 1, glm::value_ptr(value));
+}
+
+template <> void Uniform<glm::mat3>::Set(const glm::mat3& value) const {
+    if (location_ != -1) glProgramUniformMatrix3fv(program_, location_, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+template <> void Uniform<glm::mat4>::Set(const glm::mat4& value) const {
+    if (location_ != -1) glProgramUniformMatrix4fv(program_, location_, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+template <> void Uniform<GLuint64>::Set(const GLuint64& value) const {
+    if (location_ != -1) {
+        glProgramUniform2ui(program_, location_,
+            static_cast<GLuint>(value & 0xFFFFFFFF),
+            static_cast<GLuint>(value >> 32));
+    }
+}
+
+ShaderProgram::~ShaderProgram() {
+    if (program_ != 0) {
+        glDeleteProgram(program_);
+    }
+}
+
+// Loads a shader source and expands #include "file" lines (relative to the including file).
+// A #line directive after each include keeps compiler error line numbers of the outer file right.
+static int LoadShaderSource(const std::string& file_name, std::string& source, const int depth = 0) {
+    if (depth > 8) {
+        printf("Shader error: Include depth exceeded in '%s'.\n", file_name.c_str());
+        return S_FALSE;
+    }
+
+    std::vector<char> shader_source;
+    if (LoadShader(file_name, shader_source) != S_OK) {
+        return S_FALSE;
+    }
+
+    const std::filesystem::path directory = std::filesystem::path(file_name).parent_path();
+    // Skip UTF-8 BOM, GLSL compilers reject it once the file is not at the start of the source
+    const char* text = shader_source.data();
+    if (strncmp(text, "\xEF\xBB\xBF", 3) == 0) {
+        text += 3;
+    }
+    std::istringstream lines(text);
+    std::string line;
+    int line_number = 0;
+    while (std::getline(lines, line)) {
+        ++line_number;
+        const size_t directive = line.find("#include");
+        if (directive != std::string::npos && line.find_first_not_of(" \t") == directive) {
+            const size_t open = line.find('"', directive);
+            const size_t close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos) {
+                printf("Shader error: Malformed #include in '%s' line %d.\n", file_name.c_str(), line_number);
+                return S_FALSE;
+            }
+            const std::string include_name = (directory / line.substr(open + 1, close - open - 1)).string();
+            if (LoadShaderSource(include_name, source, depth + 1) != S_OK) {
+                return S_FALSE;
+            }
+            source += "#line " + std::to_string(line_number + 1) + "\n";
+        }
+        else {
+            source += line;
+            source += '\n';
+        }
+    }
+    return S_OK;
+}
+
+static GLuint CompileShader(const GLenum type, const std::string& file_name) {
+    GLuint shader = glCreateShader(type);
+    std::string shader_source;
+    if (LoadShaderSource(file_name, shader_source) == S_OK)
+    {
+        const char* tmp = shader_source.c_str();
+        glShaderSource(shader, 1, &tmp, nullptr);
+        glCompileShader(shader);
+    }
+    CheckShader(shader);
+    return shader;
+}
+
+int ShaderProgram::Load(const std::string& vs_file_name, const std::string& fs_file_name) {
+    const GLuint shaders[] = {
+        CompileShader(GL_VERTEX_SHADER, vs_file_name),
+        CompileShader(GL_FRAGMENT_SHADER, fs_file_name)
+    };
+    return Link(shaders, 2, vs_file_name + "/" + fs_file_name);
+}
+
+int ShaderProgram::LoadCompute(const std::string& cs_file_name) {
+    const GLuint shader = CompileShader(GL_COMPUTE_SHADER, cs_file_name);
+    return Link(&shader, 1, cs_file_name);
+}
+
+int ShaderProgram::Link(const GLuint* shaders, const int shader_count, const std::string& name) {
+    GLuint shader_program = glCreateProgram();
+    for (int i = 0; i < shader_count; ++i) {
+        glAttachShader(shader_program, shaders[i]);
+    }
+    glLinkProgram(shader_program);
+
+    // Shader objects are no longer needed once linked
+    for (int i = 0; i < shader_count; ++i) {
+        glDetachShader(shader_program, shaders[i]);
+        glDeleteShader(shaders[i]);
+    }
+
+    GLint status = 0;
+    glGetProgramiv(shader_program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        int info_length = 0;
+        glGetProgramiv(shader_program, GL_INFO_LOG_LENGTH, &info_length);
+        std::vector<char> info_log(info_length + 1);
+        glGetProgramInfoLog(shader_program, info_length, &info_length, info_log.data());
+        printf("Program link FAILED (%s).\nError log: %s\n", name.c_str(), info_log.data());
+        glDeleteProgram(shader_program);
+        return S_FALSE;
+    }
+
+    if (program_ != 0) {
+        glDeleteProgram(program_);
+    }
+    program_ = shader_program;
+    name_ = name;
+    Reflect();
+
+    return S_OK;
+}
+
+void ShaderProgram::Reflect() {
+    uniforms_.clear();
+
+    GLint uniform_count = 0;
+    glGetProgramInterfaceiv(program_, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniform_count);
+
+    const GLenum properties[] = { GL_NAME_LENGTH, GL_LOCATION };
+    std::vector<char> name;
+    for (GLint i = 0; i < uniform_count; ++i) {
+        GLint values[2] = { 0, -1 };
+        glGetProgramResourceiv(program_, GL_UNIFORM, i, 2, properties, 2, nullptr, values);
+
+        // Members of uniform blocks have no location
+        if (values[1] == -1) continue;
+
+        name.resize(values[0]);
+        glGetProgramResourceName(program_, GL_UNIFORM, i, values[0], nullptr, name.data());
+        std::string uniform_name(name.data());
+        uniforms_[uniform_name] = values[1];
+
+        // Arrays are reported as "name[0]", make them reachable by the plain name too
+        const size_t bracket = uniform_name.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniform_name.size()) {
+            uniforms_[uniform_name.substr(0, bracket)] = values[1];
+        }
+    }
+
+    std::cout << "Program " << name_ << ": " << uniforms_.size() << " active uniforms" << std::endl;
+}
+
+GLint ShaderProgram::Location(const char* name) const {
+    auto it = uniforms_.find(name);
+    if (it == uniforms_.end()) {
+        printf("Uniform '%s' not active in program %s.\n", name, name_.c_str());
+        return -1;
+    }
+    return it->second;
+}
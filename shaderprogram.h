@@ -0,0 +1,62 @@
+#pragma once
+#include "glutils.h"
+#include <unordered_map>
+
+// Typed handle to a uniform, resolved once when the program is linked
+// Set() is a single glProgramUniform* call - no string lookup, no need to bind the program.
+// Handles to uniforms the compiler optimized out are invalid and Set() does nothing.
+template <typename T>
+class Uniform {
+public:
+    Uniform() = default;
+    Uniform(GLuint program, GLint location) : program_(program), location_(location) {}
+
+    bool valid() const { return location_ != -1; }
+    GLint location() const { return location_; }
+
+    void Set(const T& value) const;
+
+private:
+    GLuint program_{ 0 };
+    GLint location_{ -1 };
+};
+
+template <> void Uniform<GLint>::Set(const GLint& value) const;
+template <> void Uniform<GLuint>::Set(const GLuint& value) const;
+template <> void Uniform<GLfloat>::Set(const GLfloat& value) const;
+template <> void Uniform<glm::vec3>::Set(const glm::vec3& value) const;
+template <> void Uniform<glm::mat3>::Set(const glm::mat3& value) const;
+template <> void Uniform<glm::mat4>::Set(const glm::mat4& value) const;
+template <> void Uniform<GLuint64>::Set(const GLuint64& value) const;  // bindless handle stored in uvec2
+
+// Linked GLSL program with its active uniforms reflected at link time
+class ShaderProgram {
+public:
+    ShaderProgram() = default;
+    ~ShaderProgram();
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Compiles both stages, links and reflects, returns S_OK or S_FALSE
+    int Load(const std::string& vs_file_name, const std::string& fs_file_name);
+    // Single compute stage, returns S_OK or S_FALSE
+    int LoadCompute(const std::string& cs_file_name);
+
+    GLuint id() const { return program_; }
+    bool valid() const { return program_ != 0; }
+
+    // Cold path - looks the name up in the reflected table, warns once when missing
+    template <typename T>
+    Uniform<T> uniform(const char* name) const {
+        return Uniform<T>(program_, Location(name));
+    }
+
+private:
+    GLint Location(const char* name) const;
+    int Link(const GLuint* shaders, const int shader_count, const std::string& name);
+    void Reflect();
+
+    GLuint program_{ 0 };
+    std::string name_;
+    std::unordered_map<std::string, GLint> uniforms_;
+};
@@ -3,10 +3,12 @@
 // Vertex attributes
 layout (location = 0) in vec4 in_position_ms;
 
-// Uniform variables
-uniform mat4 mlp;  // Model-Light-Projection matrix
+#include "frame_constants.glsl"
+#include "draw_data.glsl"
+
+uniform int cascade;  // Layer of the shadow map array being rendered
 
 void main(void)
 {
-    gl_Position = mlp * in_position_ms;
+    gl_Position = frame.light_space_matrices[cascade] * draws[gl_BaseInstance].M * decode_position(in_position_ms, gl_BaseInstance);
 }
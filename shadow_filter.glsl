@@ -0,0 +1,111 @@
+// Shadow map filtering of the lit shaders
+// The cascade is picked by view depth (frame.cascade_splits), each cascade is one layer of the shadow map array.
+// Tiers, selected at runtime through shadow_filter (Rasteriser::ShadowQuality):
+//   LOW    - one hardware comparison tap, the bilinear filter gives a 2x2 PCF
+//   MEDIUM - 3x3 grid of hardware taps one texel apart (4x4 texel footprint)
+//   HIGH   - per-pixel rotated Poisson disk of shadow_taps hardware taps
+// MEDIUM and HIGH take four spread-out taps first and stop there when they agree -
+// the block is then fully lit or fully shadowed and the remaining taps would not change it.
+// Layers with dynamic casters (bits of shadow_dynamic_cascades) are read from shadow_map, the others from the
+// cached static_shadow_map. Depth comparison and filtering come from the sampler objects on units 3 and 5.
+// Needs frame_constants.glsl included first.
+
+#define SHADOW_FILTER_LOW 0
+#define SHADOW_FILTER_MEDIUM 1
+#define SHADOW_FILTER_HIGH 2
+#define SHADOW_MAX_TAPS 32
+
+uniform sampler2DArrayShadow shadow_map;         // Shadow depth map, one layer per cascade
+uniform sampler2DArrayShadow static_shadow_map;  // Static casters only
+uniform int shadow_dynamic_cascades = 0;
+uniform int shadow_filter = SHADOW_FILTER_MEDIUM;
+uniform int shadow_taps = 16;         // HIGH only, 4 to SHADOW_MAX_TAPS
+uniform float shadow_radius = 2.5;    // HIGH only, disk radius in texels
+
+// Best-candidate points in the unit disk - every prefix is evenly spread, the first four form the outer ring
+const vec2 poisson_disk[SHADOW_MAX_TAPS] = vec2[](
+    vec2(-0.8549, -0.5187), vec2(0.8082, 0.5833), vec2(0.5344, -0.8203), vec2(-0.5457, 0.8191),
+    vec2(-0.0140, -0.0175), vec2(0.9737, -0.2017), vec2(-0.2336, -0.9715), vec2(-0.9245, 0.1797),
+    vec2(0.1784, 0.9679), vec2(0.5055, 0.1211), vec2(-0.3089, -0.4478), vec2(-0.4243, 0.3145),
+    vec2(0.1083, 0.4682), vec2(0.3449, -0.3512), vec2(-0.5860, -0.1001), vec2(0.1023, -0.7016),
+    vec2(0.9054, 0.2023), vec2(0.8200, -0.5605), vec2(-0.1522, 0.7750), vec2(-0.5770, -0.7850),
+    vec2(0.4371, 0.6524), vec2(-0.7831, 0.5255), vec2(-0.9450, -0.1839), vec2(0.6413, -0.1979),
+    vec2(0.0063, -0.3471), vec2(0.2614, -0.9612), vec2(-0.2873, -0.1447), vec2(-0.1168, 0.2675),
+    vec2(0.2151, 0.1879), vec2(-0.6039, -0.3832), vec2(0.6140, 0.3815), vec2(-0.1846, -0.6976)
+);
+
+// 1.0 if lit, 0.0 if in shadow, bilinear weighted in between
+// coords are (u, v, layer, reference depth); zero gradients select LOD 0, the taps after an early-out
+// live in non-uniform control flow
+float ShadowTap(vec4 coords, vec2 offset, vec2 texel_size)
+{
+    vec4 tap = vec4(coords.xy + offset * texel_size, coords.zw);
+    if ((shadow_dynamic_cascades & (1 << int(coords.z))) != 0)
+        return textureGrad(shadow_map, tap, vec2(0.0), vec2(0.0));
+    return textureGrad(static_shadow_map, tap, vec2(0.0), vec2(0.0));
+}
+
+float CalculateShadow(vec3 position_ws, vec3 normal, vec3 light_dir)
+{
+    // First cascade whose slice contains the fragment, lit beyond the last one
+    float view_depth = -(frame.V * vec4(position_ws, 1.0)).z;
+    int cascade = 0;
+    while (cascade < frame.cascade_count && view_depth > frame.cascade_splits[cascade]) {
+        ++cascade;
+    }
+    if (cascade == frame.cascade_count)
+        return 1.0;
+
+    // Normal offset in texels of this cascade, so far cascades with big texels need no larger depth bias
+    float n_dot_l = clamp(dot(normal, light_dir), 0.0, 1.0);
+    vec3 offset_ws = normal * frame.cascade_texel_sizes[cascade] * (1.0 + 1.5 * (1.0 - n_dot_l));
+    vec4 pos_lcs = frame.light_space_matrices[cascade] * vec4(position_ws + offset_ws, 1.0);
+
+    // NDC [-1,1] to texture coordinates [0,1] (orthographic, w is 1)
+    vec3 proj_coords = pos_lcs.xyz * 0.5 + 0.5;
+
+    // If outside light frustum, no shadow
+    if (proj_coords.z > 1.0)
+        return 1.0;
+
+    // Small slope-scaled bias on the reference depth on top of the normal offset
+    vec4 coords = vec4(proj_coords.xy, float(cascade), proj_coords.z - max(0.001 * (1.0 - n_dot_l), 0.0002));
+
+    if (shadow_filter == SHADOW_FILTER_LOW) {
+        return ShadowTap(coords, vec2(0.0), vec2(0.0));
+    }
+
+    vec2 texel_size = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+
+    if (shadow_filter == SHADOW_FILTER_MEDIUM) {
+        float shadow = ShadowTap(coords, vec2(-1.0, -1.0), texel_size) + ShadowTap(coords, vec2(1.0, -1.0), texel_size) +
+                       ShadowTap(coords, vec2(-1.0, 1.0), texel_size) + ShadowTap(coords, vec2(1.0, 1.0), texel_size);
+        if (shadow == 0.0 || shadow == 4.0) {
+            return shadow * 0.25;
+        }
+        shadow += ShadowTap(coords, vec2(0.0, -1.0), texel_size) + ShadowTap(coords, vec2(-1.0, 0.0), texel_size) +
+                  ShadowTap(coords, vec2(0.0, 0.0), texel_size) + ShadowTap(coords, vec2(1.0, 0.0), texel_size) +
+                  ShadowTap(coords, vec2(0.0, 1.0), texel_size);
+        return shadow / 9.0;
+    }
+
+    // Rotate the disk per pixel (interleaved gradient noise), banding turns into fine noise
+    float angle = 6.2831853 * fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    float c = cos(angle);
+    float s = sin(angle);
+    mat2 rotation = mat2(c, s, -s, c) * shadow_radius;
+
+    float shadow = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        shadow += ShadowTap(coords, rotation * poisson_disk[i], texel_size);
+    }
+    if (shadow == 0.0 || shadow == 4.0) {
+        return shadow * 0.25;
+    }
+
+    int taps = clamp(shadow_taps, 4, SHADOW_MAX_TAPS);
+    for (int i = 4; i < taps; ++i) {
+        shadow += ShadowTap(coords, rotation * poisson_disk[i], texel_size);
+    }
+    return shadow / float(taps);
+}
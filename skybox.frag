@@ -7,8 +7,9 @@ in vec2 tex_coord;
 // Output
 layout (location = 0) out vec4 FragColor;
 
+#include "frame_constants.glsl"
+
 // Uniforms
-uniform mat4 inv_VP;  // Inverse of View-Projection matrix
 uniform uvec2 skybox_texture;  // Bindless texture handle
 
 // Constants
@@ -18,7 +19,7 @@ void main()
 {
     // Convert screen coordinates to world-space ray direction
     vec4 ndc = vec4(tex_coord * 2.0 - 1.0, 1.0, 1.0);
-    vec4 world_pos = inv_VP * ndc;
+    vec4 world_pos = frame.inv_VP * ndc;
     vec3 ray_dir = normalize(world_pos.xyz / world_pos.w);
 
     // Map ray direction to UV coordinates for panoramic image
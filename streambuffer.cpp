@@ -0,0 +1,94 @@
+#include "streambuffer.h"
+#include <iostream>
+#include <algorithm>
+
+StreamBuffer::~StreamBuffer() {
+    Release();
+}
+
+void StreamBuffer::Release() {
+    for (GLsync& fence : fences_) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (buffer_ != 0) {
+        glUnmapNamedBuffer(buffer_);
+        glDeleteBuffers(1, &buffer_);
+        buffer_ = 0;
+        mapped_ = nullptr;
+    }
+}
+
+int StreamBuffer::Init(const GLsizeiptr region_size, const char* name) {
+    name_ = name;
+    // Keep every region start aligned for any binding target (UBO offsets need up to 256)
+    region_size_ = (region_size + 255) / 256 * 256;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &buffer_);
+    glNamedBufferStorage(buffer_, region_size_ * REGIONS, nullptr, flags);
+    mapped_ = static_cast<uint8_t*>(glMapNamedBufferRange(buffer_, 0, region_size_ * REGIONS, flags));
+
+    if (!mapped_) {
+        std::cout << "ERROR: Failed to map stream buffer " << name_ << "!" << std::endl;
+        return S_FALSE;
+    }
+
+    std::cout << "Stream buffer " << name_ << ": " << REGIONS << " x " << region_size_ << " bytes" << std::endl;
+    return S_OK;
+}
+
+int StreamBuffer::Reserve(const GLsizeiptr region_size) {
+    if (region_size <= region_size_ && buffer_ != 0) {
+        return S_OK;
+    }
+
+    // Rare - draws of earlier frames may still read every region, so the old buffer goes once the GPU is idle
+    GLsizeiptr new_size = std::max<GLsizeiptr>(region_size_, 256);
+    while (new_size < region_size) {
+        new_size *= 2;
+    }
+    glFinish();
+    Release();
+    region_ = 0;
+    head_ = 0;
+    overflow_reported_ = false;
+    const std::string name = name_;
+    return Init(new_size, name.c_str());
+}
+
+void StreamBuffer::BeginFrame() {
+    // Wait until the GPU finished the frame that last used this region (normally already signalled)
+    GLsync& fence = fences_[region_];
+    if (fence) {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        while (result == GL_TIMEOUT_EXPIRED) {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    head_ = 0;
+}
+
+StreamBuffer::Allocation StreamBuffer::Allocate(const GLsizeiptr size, const GLsizeiptr alignment) {
+    const GLsizeiptr start = (head_ + alignment - 1) / alignment * alignment;
+    if (start + size > region_size_) {
+        if (!overflow_reported_) {
+            std::cout << "WARNING: Stream buffer " << name_ << " is out of space (" << start + size << " > " << region_size_ << " bytes)" << std::endl;
+            overflow_reported_ = true;
+        }
+        return {};
+    }
+    head_ = start + size;
+
+    const GLintptr offset = region_size_ * region_ + start;
+    return { mapped_ + offset, offset };
+}
+
+void StreamBuffer::EndFrame() {
+    fences_[region_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region_ = (region_ + 1) % REGIONS;
+}
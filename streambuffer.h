@@ -0,0 +1,48 @@
+#pragma once
+#include "glutils.h"
+#include <cstdint>
+
+// Persistently mapped buffer split into REGIONS ring slots for data rewritten every frame
+// The CPU writes straight into GPU-visible memory. BeginFrame() waits for the fence of the
+// region it is about to reuse, so draws still reading older frames are never overwritten.
+// Allocate() is a linear allocator inside the current region; EndFrame() fences it and
+// moves on to the next one.
+class StreamBuffer {
+public:
+    static const int REGIONS = 3;
+
+    struct Allocation {
+        void* data{ nullptr };  // Mapped pointer, null if the region is full
+        GLintptr offset{ 0 };   // Byte offset into buffer() for binding or drawing
+    };
+
+    StreamBuffer() = default;
+    ~StreamBuffer();
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // region_size is the byte budget per frame, returns S_OK or S_FALSE
+    int Init(const GLsizeiptr region_size, const char* name);
+    // Grows the regions to at least region_size between frames, waits for the GPU to finish with the old buffer.
+    // buffer() changes when it grows.
+    int Reserve(const GLsizeiptr region_size);
+
+    void BeginFrame();
+    Allocation Allocate(const GLsizeiptr size, const GLsizeiptr alignment = 16);
+    void EndFrame();
+
+    GLuint buffer() const { return buffer_; }
+    GLsizeiptr region_size() const { return region_size_; }
+    GLsizeiptr remaining() const { return region_size_ - head_; }  // Bytes left in the current region, before alignment
+
+private:
+    GLuint buffer_{ 0 };
+    uint8_t* mapped_{ nullptr };
+    GLsizeiptr region_size_{ 0 };
+    GLsizeiptr head_{ 0 };  // Bytes used in the current region
+    int region_{ 0 };
+    GLsync fences_[REGIONS]{};
+    void Release();
+    std::string name_;
+    bool overflow_reported_{ false };
+};
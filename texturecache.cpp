@@ -0,0 +1,100 @@
+#include "texturecache.h"
+#include <iostream>
+
+TextureRegistry::~TextureRegistry() {
+    for (auto& [handle, entry] : entries_) {
+        if (entry.resident) {
+            glMakeTextureHandleNonResidentARB(handle);
+        }
+        glDeleteTextures(1, &entry.texture);
+    }
+}
+
+GLuint64 TextureRegistry::Acquire(const std::string& key, const Creator& create, GLuint* texture) {
+    auto it = handles_.find(key);
+    if (it != handles_.end()) {
+        Entry& entry = entries_[it->second];
+        ++entry.references;
+        if (texture) {
+            *texture = entry.texture;
+        }
+        return entry.handle;
+    }
+
+    const GLuint new_texture = create();
+    if (new_texture == 0) {
+        return 0;
+    }
+
+    const GLuint64 handle = glGetTextureHandleARB(new_texture);
+    if (handle == 0) {
+        std::cout << "ERROR: Failed to create texture handle!" << std::endl;
+        glDeleteTextures(1, &new_texture);
+        return 0;
+    }
+    glMakeTextureHandleResidentARB(handle);
+
+    Entry entry;
+    entry.key = key;
+    entry.texture = new_texture;
+    entry.handle = handle;
+    entry.references = 1;
+    entry.resident = true;
+    entries_[handle] = entry;
+    handles_[key] = handle;
+
+    if (texture) {
+        *texture = new_texture;
+    }
+    return handle;
+}
+
+void TextureRegistry::Release(GLuint64 handle) {
+    auto it = entries_.find(handle);
+    if (it == entries_.end()) {
+        return;
+    }
+
+    Entry& entry = it->second;
+    if (--entry.references > 0) {
+        return;
+    }
+
+    // Handle must be non-resident before the texture can be deleted
+    if (entry.resident) {
+        glMakeTextureHandleNonResidentARB(handle);
+    }
+    glDeleteTextures(1, &entry.texture);
+
+    handles_.erase(entry.key);
+    entries_.erase(it);
+}
+
+std::string TextureRegistry::MakeKey(const int width, const int height, const GLvoid* data, int linear) {
+    // FNV-1a over the pixels - far cheaper than an upload plus mipmap generation
+    const size_t byte_count = size_t(width) * size_t(height) * 3;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < byte_count; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return "mem:" + std::to_string(width) + "x" + std::to_string(height) + ":" + std::to_string(linear) + ":" + std::to_string(hash);
+}
+
+std::string TextureRegistry::MakeFileKey(const std::string& file_name) {
+    std::error_code ec;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(file_name, ec);
+    return "file:" + (ec ? file_name : canonical.generic_string());
+}
+
+size_t TextureRegistry::resident_count() const {
+    size_t count = 0;
+    for (const auto& [handle, entry] : entries_) {
+        if (entry.resident) {
+            ++count;
+        }
+    }
+    return count;
+}
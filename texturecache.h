@@ -0,0 +1,40 @@
+#pragma once
+#include "glutils.h"
+#include <unordered_map>
+#include <functional>
+
+// Registry of bindless textures keyed by source image
+// The same image referenced by several materials (or meshes) is uploaded once,
+// every Acquire adds a reference and the texture is made non-resident and deleted
+// when the last Release drops it to zero.
+class TextureRegistry {
+public:
+    // Creates the GL texture on a miss, returns 0 if creation failed
+    using Creator = std::function<GLuint()>;
+
+    ~TextureRegistry();
+
+    GLuint64 Acquire(const std::string& key, const Creator& create, GLuint* texture = nullptr);
+    void Release(GLuint64 handle);
+
+    // Content key for images that only exist in memory (e.g. MeshLoader material maps)
+    static std::string MakeKey(const int width, const int height, const GLvoid* data, int linear);
+    // Key for images loaded from a file
+    static std::string MakeFileKey(const std::string& file_name);
+
+    size_t size() const { return entries_.size(); }
+    bool contains(const std::string& key) const { return handles_.count(key) != 0; }
+    size_t resident_count() const;
+
+private:
+    struct Entry {
+        std::string key;
+        GLuint texture{ 0 };
+        GLuint64 handle{ 0 };
+        int references{ 0 };
+        bool resident{ false };
+    };
+
+    std::unordered_map<std::string, GLuint64> handles_;  // key -> handle
+    std::unordered_map<GLuint64, Entry> entries_;        // handle -> entry
+};
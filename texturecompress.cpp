@@ -0,0 +1,600 @@
+#include "texturecompress.h"
+#include "threadpool.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <functional>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+namespace texturecompress {
+
+    namespace {
+        const uint8_t kIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+        const char kSourceKey[] = "ZPGsource";
+        const uint32_t kMaxLevels = 32;
+        const size_t kLevelAlignment = 16;  // Multiple of both block sizes and 4, as KTX2 asks
+
+        // VkFormat of each usage, the format field of a KTX2 header
+        const uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+        const uint32_t VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132;
+        const uint32_t VK_FORMAT_BC5_UNORM_BLOCK = 141;
+
+#pragma pack(push, 1)
+        struct Header {
+            uint8_t identifier[12];
+            uint32_t vk_format;
+            uint32_t type_size;
+            uint32_t pixel_width;
+            uint32_t pixel_height;
+            uint32_t pixel_depth;
+            uint32_t layer_count;
+            uint32_t face_count;
+            uint32_t level_count;
+            uint32_t supercompression_scheme;
+            uint32_t dfd_byte_offset;
+            uint32_t dfd_byte_length;
+            uint32_t kvd_byte_offset;
+            uint32_t kvd_byte_length;
+            uint64_t sgd_byte_offset;
+            uint64_t sgd_byte_length;
+        };
+
+        struct LevelIndex {
+            uint64_t byte_offset;
+            uint64_t byte_length;
+            uint64_t uncompressed_byte_length;
+        };
+
+        // Value of the ZPGsource key
+        struct SourceValue {
+            int64_t write_time;
+            uint64_t size;
+        };
+#pragma pack(pop)
+
+        uint32_t VkFormat(const Usage usage) {
+            switch (usage) {
+            case Usage::COLOR: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+            case Usage::DATA: return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            default: return VK_FORMAT_BC5_UNORM_BLOCK;
+            }
+        }
+
+        size_t BlockBytes(const Usage usage) {
+            return usage == Usage::NORMAL ? 16 : 8;
+        }
+
+        size_t LevelBytes(const Usage usage, const uint32_t width, const uint32_t height) {
+            return size_t((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(usage);
+        }
+
+        size_t Align(const size_t value) {
+            return (value + kLevelAlignment - 1) & ~(kLevelAlignment - 1);
+        }
+
+        // Key and value length, then the NUL terminated key, the value and padding to 4 bytes
+        size_t KeyValueBytes() {
+            return (sizeof(uint32_t) + sizeof(kSourceKey) + sizeof(SourceValue) + 3) & ~size_t(3);
+        }
+
+        void ForEach(ThreadPool* pool, const size_t count, const size_t min_chunk, const std::function<void(size_t, size_t)>& job) {
+            if (pool) {
+                pool->ParallelFor(count, min_chunk, [&job](size_t begin, size_t end, size_t) { job(begin, end); });
+            }
+            else {
+                job(0, count);
+            }
+        }
+
+        float SrgbToLinear(const float c) {
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float LinearToSrgb(const float c) {
+            return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        }
+
+        // ----- BC1 -----
+
+        uint16_t Quantize565(const glm::vec3& c) {
+            const glm::vec3 q = glm::clamp(c, glm::vec3(0.0f), glm::vec3(255.0f));
+            const uint16_t r = uint16_t(q.x * 31.0f / 255.0f + 0.5f);
+            const uint16_t g = uint16_t(q.y * 63.0f / 255.0f + 0.5f);
+            const uint16_t b = uint16_t(q.z * 31.0f / 255.0f + 0.5f);
+            return uint16_t((r << 11) | (g << 5) | b);
+        }
+
+        glm::vec3 Expand565(const uint16_t c) {
+            const int r = (c >> 11) & 31;
+            const int g = (c >> 5) & 63;
+            const int b = c & 31;
+            return glm::vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2)));
+        }
+
+        struct Bc1Block {
+            uint16_t color0{ 0 };
+            uint16_t color1{ 0 };
+            uint32_t indices{ 0 };
+            float error{ 0.0f };
+        };
+
+        // Four colour mode needs color0 > color1, equal endpoints fall back to index 0 everywhere
+        Bc1Block FitIndices(const glm::vec3* texels, const glm::vec3& end0, const glm::vec3& end1) {
+            Bc1Block block;
+            block.color0 = Quantize565(end0);
+            block.color1 = Quantize565(end1);
+            if (block.color0 < block.color1) {
+                std::swap(block.color0, block.color1);
+            }
+
+            const glm::vec3 a = Expand565(block.color0);
+            const glm::vec3 b = Expand565(block.color1);
+            const glm::vec3 palette[4] = { a, b, (2.0f * a + b) / 3.0f, (a + 2.0f * b) / 3.0f };
+            const int palette_size = block.color0 == block.color1 ? 1 : 4;
+            for (int k = 0; k < 16; ++k) {
+                int best = 0;
+                float best_distance = FLT_MAX;
+                for (int i = 0; i < palette_size; ++i) {
+                    const glm::vec3 d = texels[k] - palette[i];
+                    const float distance = glm::dot(d, d);
+                    if (distance < best_distance) {
+                        best_distance = distance;
+                        best = i;
+                    }
+                }
+                block.indices |= uint32_t(best) << (2 * k);
+                block.error += best_distance;
+            }
+            return block;
+        }
+
+        void EncodeBc1(const glm::vec3* texels, uint8_t* out) {
+            glm::vec3 mean(0.0f);
+            for (int k = 0; k < 16; ++k) {
+                mean += texels[k];
+            }
+            mean /= 16.0f;
+
+            // Principal axis of the colours by power iteration on their covariance
+            float cov[6] = {};
+            glm::vec3 lo(FLT_MAX);
+            glm::vec3 hi(-FLT_MAX);
+            for (int k = 0; k < 16; ++k) {
+                const glm::vec3 d = texels[k] - mean;
+                cov[0] += d.x * d.x; cov[1] += d.x * d.y; cov[2] += d.x * d.z;
+                cov[3] += d.y * d.y; cov[4] += d.y * d.z; cov[5] += d.z * d.z;
+                lo = glm::min(lo, texels[k]);
+                hi = glm::max(hi, texels[k]);
+            }
+            glm::vec3 axis = hi - lo;
+            for (int i = 0; i < 4; ++i) {
+                axis = glm::vec3(cov[0] * axis.x + cov[1] * axis.y + cov[2] * axis.z,
+                    cov[1] * axis.x + cov[3] * axis.y + cov[4] * axis.z,
+                    cov[2] * axis.x + cov[4] * axis.y + cov[5] * axis.z);
+                const float scale = std::max(std::abs(axis.x), std::max(std::abs(axis.y), std::abs(axis.z)));
+                if (scale <= 0.0f) {
+                    break;
+                }
+                axis /= scale;
+            }
+
+            Bc1Block best;
+            const float axis_length = glm::length(axis);
+            if (axis_length <= 1e-6f) {
+                best = FitIndices(texels, mean, mean);  // Solid block
+            }
+            else {
+                // Endpoints at the extremes along the axis
+                axis /= axis_length;
+                float t_min = FLT_MAX;
+                float t_max = -FLT_MAX;
+                for (int k = 0; k < 16; ++k) {
+                    const float t = glm::dot(texels[k] - mean, axis);
+                    t_min = std::min(t_min, t);
+                    t_max = std::max(t_max, t);
+                }
+                best = FitIndices(texels, mean + t_max * axis, mean + t_min * axis);
+
+                // One least squares refit of the endpoints to the chosen indices
+                static const float kWeight0[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+                float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+                glm::vec3 ax(0.0f), bx(0.0f);
+                for (int k = 0; k < 16; ++k) {
+                    const float alpha = kWeight0[(best.indices >> (2 * k)) & 3];
+                    const float beta = 1.0f - alpha;
+                    aa += alpha * alpha;
+                    bb += beta * beta;
+                    ab += alpha * beta;
+                    ax += alpha * texels[k];
+                    bx += beta * texels[k];
+                }
+                const float det = aa * bb - ab * ab;
+                if (std::abs(det) > 1e-6f) {
+                    const glm::vec3 end0 = (ax * bb - bx * ab) / det;
+                    const glm::vec3 end1 = (bx * aa - ax * ab) / det;
+                    const Bc1Block refit = FitIndices(texels, end0, end1);
+                    if (refit.error < best.error) {
+                        best = refit;
+                    }
+                }
+            }
+
+            std::memcpy(out, &best.color0, 2);
+            std::memcpy(out + 2, &best.color1, 2);
+            std::memcpy(out + 4, &best.indices, 4);
+        }
+
+        // ----- BC4 (one channel of BC5) -----
+
+        void EncodeBc4(const float* values, uint8_t* out) {
+            float lo = 255.0f;
+            float hi = 0.0f;
+            for (int k = 0; k < 16; ++k) {
+                lo = std::min(lo, values[k]);
+                hi = std::max(hi, values[k]);
+            }
+            // Eight value mode needs alpha0 > alpha1
+            const uint8_t alpha0 = uint8_t(std::clamp(hi, 0.0f, 255.0f) + 0.5f);
+            const uint8_t alpha1 = uint8_t(std::clamp(lo, 0.0f, 255.0f) + 0.5f);
+            out[0] = alpha0;
+            out[1] = alpha1;
+
+            uint64_t indices = 0;
+            if (alpha0 > alpha1) {
+                float palette[8] = { float(alpha0), float(alpha1) };
+                for (int i = 2; i < 8; ++i) {
+                    palette[i] = (float(8 - i) * alpha0 + float(i - 1) * alpha1) / 7.0f;
+                }
+                for (int k = 0; k < 16; ++k) {
+                    int best = 0;
+                    for (int i = 1; i < 8; ++i) {
+                        if (std::abs(values[k] - palette[i]) < std::abs(values[k] - palette[best])) {
+                            best = i;
+                        }
+                    }
+                    indices |= uint64_t(best) << (3 * k);
+                }
+            }
+            for (int i = 0; i < 6; ++i) {
+                out[2 + i] = uint8_t(indices >> (8 * i));
+            }
+        }
+
+        // Encodes one level from 8-bit texels (0..255 floats), edge blocks repeat the last row and column
+        void EncodeLevel(const std::vector<glm::vec3>& texels, const uint32_t width, const uint32_t height, const Usage usage,
+            ThreadPool* pool, uint8_t* out) {
+            const uint32_t blocks_x = (width + 3) / 4;
+            const uint32_t blocks_y = (height + 3) / 4;
+            const size_t block_bytes = BlockBytes(usage);
+            ForEach(pool, size_t(blocks_x) * blocks_y, 64, [&](size_t begin, size_t end) {
+                glm::vec3 block[16];
+                float red[16];
+                float green[16];
+                for (size_t b = begin; b < end; ++b) {
+                    const uint32_t bx = uint32_t(b % blocks_x);
+                    const uint32_t by = uint32_t(b / blocks_x);
+                    for (int k = 0; k < 16; ++k) {
+                        const uint32_t x = std::min(bx * 4 + uint32_t(k % 4), width - 1);
+                        const uint32_t y = std::min(by * 4 + uint32_t(k / 4), height - 1);
+                        block[k] = texels[size_t(y) * width + x];
+                        red[k] = block[k].x;
+                        green[k] = block[k].y;
+                    }
+                    uint8_t* dst = out + b * block_bytes;
+                    if (usage == Usage::NORMAL) {
+                        EncodeBc4(red, dst);
+                        EncodeBc4(green, dst + 8);
+                    }
+                    else {
+                        EncodeBc1(block, dst);
+                    }
+                }
+            });
+        }
+    }
+
+    GLenum InternalFormat(const Usage usage) {
+        switch (usage) {
+        case Usage::COLOR: return GL_COMPRESSED_SRGB_S3TC_DXT1_EXT;
+        case Usage::DATA: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        default: return GL_COMPRESSED_RG_RGTC2;
+        }
+    }
+
+    bool Compress(const uint8_t* rgb, const int width, const int height, const Usage usage, ThreadPool* pool,
+        std::vector<uint8_t>& storage, Image& image) {
+        if (!rgb || width <= 0 || height <= 0) {
+            return false;
+        }
+
+        image = Image();
+        image.usage = usage;
+        image.width = uint32_t(width);
+        image.height = uint32_t(height);
+        size_t total = 0;
+        for (uint32_t w = image.width, h = image.height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+            Level level;
+            level.width = w;
+            level.height = h;
+            level.offset = total;
+            level.size = LevelBytes(usage, w, h);
+            image.levels.push_back(level);
+            total += level.size;
+            if (w == 1 && h == 1) {
+                break;
+            }
+        }
+        storage.assign(total, 0);
+        image.data = storage.data();
+
+        // Mips are filtered in linear light for colour, renormalised for normals
+        float srgb_to_linear[256];
+        for (int i = 0; i < 256; ++i) {
+            srgb_to_linear[i] = SrgbToLinear(float(i) / 255.0f);
+        }
+        auto decode = [&](const uint8_t* texel) {
+            switch (usage) {
+            case Usage::COLOR: return glm::vec3(srgb_to_linear[texel[0]], srgb_to_linear[texel[1]], srgb_to_linear[texel[2]]);
+            case Usage::DATA: return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+            default: return glm::vec3(texel[0], texel[1], texel[2]) / 127.5f - 1.0f;
+            }
+        };
+        auto encode = [usage](const glm::vec3& value) {
+            switch (usage) {
+            case Usage::COLOR: return 255.0f * glm::vec3(LinearToSrgb(value.x), LinearToSrgb(value.y), LinearToSrgb(value.z));
+            case Usage::DATA: return 255.0f * value;
+            default: return 127.5f * (value + 1.0f);
+            }
+        };
+
+        std::vector<glm::vec3> filtered(size_t(width) * height);
+        std::vector<glm::vec3> texels(filtered.size());
+        ForEach(pool, filtered.size(), 4096, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                filtered[i] = decode(&rgb[i * 3]);
+                texels[i] = glm::vec3(rgb[i * 3], rgb[i * 3 + 1], rgb[i * 3 + 2]);  // Level 0 exactly as loaded
+            }
+        });
+
+        std::vector<glm::vec3> next;
+        for (size_t l = 0; l < image.levels.size(); ++l) {
+            const Level& level = image.levels[l];
+            if (l > 0) {
+                // 2x2 box filter, along an odd parent axis a 3-tap (1/4, 1/2, 1/4) footprint folds the last
+                // row or column in instead of dropping it
+                const Level& parent = image.levels[l - 1];
+                auto footprint = [](uint32_t parent_size, uint32_t i, uint32_t* taps, float* weights) {
+                    if (parent_size == 1) {
+                        taps[0] = 0;
+                        weights[0] = 1.0f;
+                        return 1;
+                    }
+                    if (parent_size % 2 == 0) {
+                        taps[0] = i * 2;
+                        taps[1] = i * 2 + 1;
+                        weights[0] = weights[1] = 0.5f;
+                        return 2;
+                    }
+                    taps[0] = i * 2;
+                    taps[1] = i * 2 + 1;
+                    taps[2] = i * 2 + 2;
+                    weights[0] = weights[2] = 0.25f;
+                    weights[1] = 0.5f;
+                    return 3;
+                };
+                next.resize(size_t(level.width) * level.height);
+                ForEach(pool, level.height, 16, [&](size_t begin, size_t end) {
+                    for (size_t y = begin; y < end; ++y) {
+                        uint32_t rows[3];
+                        float row_weights[3];
+                        const int row_count = footprint(parent.height, uint32_t(y), rows, row_weights);
+                        for (uint32_t x = 0; x < level.width; ++x) {
+                            uint32_t columns[3];
+                            float column_weights[3];
+                            const int column_count = footprint(parent.width, x, columns, column_weights);
+                            glm::vec3 sum(0.0f);
+                            for (int j = 0; j < row_count; ++j) {
+                                for (int i = 0; i < column_count; ++i) {
+                                    sum += row_weights[j] * column_weights[i] * filtered[size_t(rows[j]) * parent.width + columns[i]];
+                                }
+                            }
+                            if (usage == Usage::NORMAL) {
+                                const float length = glm::length(sum);
+                                sum = length > 0.0f ? sum / length : glm::vec3(0.0f, 0.0f, 1.0f);
+                            }
+                            next[y * level.width + x] = sum;
+                            texels[y * level.width + x] = glm::clamp(encode(sum) + 0.5f, glm::vec3(0.0f), glm::vec3(255.0f));
+                        }
+                    }
+                });
+                std::swap(filtered, next);
+            }
+            EncodeLevel(texels, level.width, level.height, usage, pool, storage.data() + level.offset);
+        }
+        return true;
+    }
+
+    bool TextureFile::Open(const std::string& cache_file_name, const std::string& source_file_name, const Usage usage) {
+        if (!file_.Open(cache_file_name)) {
+            return false;
+        }
+
+        const uint8_t* data = file_.data();
+        const size_t size = file_.size();
+        if (size < sizeof(Header)) {
+            return false;
+        }
+        const Header& header = *reinterpret_cast<const Header*>(data);
+        if (std::memcmp(header.identifier, kIdentifier, sizeof(kIdentifier)) != 0 || header.vk_format != VkFormat(usage)
+            || header.pixel_depth != 0 || header.layer_count != 0 || header.face_count != 1 || header.supercompression_scheme != 0
+            || header.level_count == 0 || header.level_count > kMaxLevels
+            || sizeof(Header) + header.level_count * sizeof(LevelIndex) > size
+            || size_t(header.kvd_byte_offset) + header.kvd_byte_length > size) {
+            std::cout << "Texture cache '" << cache_file_name << "' has old format or another encoding, rebuilding" << std::endl;
+            return false;
+        }
+
+        // Invalidate when the source image changed
+        SourceValue source{};
+        bool found = false;
+        for (size_t offset = header.kvd_byte_offset; offset + sizeof(uint32_t) <= size_t(header.kvd_byte_offset) + header.kvd_byte_length;) {
+            uint32_t length = 0;
+            std::memcpy(&length, data + offset, sizeof(length));
+            const char* key = reinterpret_cast<const char*>(data + offset + sizeof(length));
+            if (length == sizeof(kSourceKey) + sizeof(SourceValue) && std::memcmp(key, kSourceKey, sizeof(kSourceKey)) == 0) {
+                std::memcpy(&source, key + sizeof(kSourceKey), sizeof(source));
+                found = true;
+            }
+            offset += (sizeof(length) + length + 3) & ~size_t(3);
+        }
+        int64_t write_time = 0;
+        uint64_t file_size = 0;
+        if (!found || !binarymesh::StatFile(source_file_name, write_time, file_size)
+            || write_time != source.write_time || file_size != source.size) {
+            std::cout << "Texture cache '" << cache_file_name << "' is stale (" << source_file_name << " changed)" << std::endl;
+            return false;
+        }
+
+        image_ = Image();
+        image_.usage = usage;
+        image_.width = header.pixel_width;
+        image_.height = header.pixel_height;
+        image_.data = data;
+        const auto* level_index = reinterpret_cast<const LevelIndex*>(data + sizeof(Header));
+        uint32_t w = header.pixel_width;
+        uint32_t h = header.pixel_height;
+        for (uint32_t l = 0; l < header.level_count; ++l) {
+            Level level;
+            level.width = w;
+            level.height = h;
+            level.offset = size_t(level_index[l].byte_offset);
+            level.size = size_t(level_index[l].byte_length);
+            if (level.size != LevelBytes(usage, w, h) || level_index[l].byte_offset + level_index[l].byte_length > size) {
+                std::cout << "Texture cache '" << cache_file_name << "' is truncated" << std::endl;
+                return false;
+            }
+            image_.levels.push_back(level);
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+        return true;
+    }
+
+    std::string CachePath(const std::string& image_file_name) {
+        return image_file_name + ".ktx2";
+    }
+
+    bool Write(const std::string& cache_file_name, const std::string& source_file_name, const Image& image) {
+        SourceValue source{};
+        if (image.levels.empty() || !binarymesh::StatFile(source_file_name, source.write_time, source.size)) {
+            return false;
+        }
+
+        Header header{};
+        std::memcpy(header.identifier, kIdentifier, sizeof(kIdentifier));
+        header.vk_format = VkFormat(image.usage);
+        header.type_size = 1;
+        header.pixel_width = image.width;
+        header.pixel_height = image.height;
+        header.face_count = 1;
+        header.level_count = uint32_t(image.levels.size());
+        header.kvd_byte_offset = uint32_t(sizeof(Header) + image.levels.size() * sizeof(LevelIndex));
+        header.kvd_byte_length = uint32_t(KeyValueBytes());
+
+        // Smallest level first in the file, the index still lists level 0 first
+        std::vector<LevelIndex> level_index(image.levels.size());
+        size_t offset = size_t(header.kvd_byte_offset) + header.kvd_byte_length;
+        for (size_t l = image.levels.size(); l-- > 0;) {
+            offset = Align(offset);
+            level_index[l].byte_offset = offset;
+            level_index[l].byte_length = image.levels[l].size;
+            level_index[l].uncompressed_byte_length = image.levels[l].size;
+            offset += image.levels[l].size;
+        }
+
+        // Write to a temporary file first so a crash never leaves a half written cache
+        const std::string temp_file_name = cache_file_name + ".tmp";
+        {
+            std::ofstream file(temp_file_name, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cout << "Texture cache: cannot write " << temp_file_name << std::endl;
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(level_index.data()), level_index.size() * sizeof(LevelIndex));
+
+            const uint32_t key_value_length = uint32_t(sizeof(kSourceKey) + sizeof(SourceValue));
+            const char padding[kLevelAlignment] = {};
+            file.write(reinterpret_cast<const char*>(&key_value_length), sizeof(key_value_length));
+            file.write(kSourceKey, sizeof(kSourceKey));
+            file.write(reinterpret_cast<const char*>(&source), sizeof(source));
+            file.write(padding, KeyValueBytes() - sizeof(key_value_length) - key_value_length);
+
+            for (size_t l = image.levels.size(); l-- > 0;) {
+                file.write(padding, level_index[l].byte_offset - static_cast<uint64_t>(file.tellp()));
+                file.write(reinterpret_cast<const char*>(image.data + image.levels[l].offset), image.levels[l].size);
+            }
+
+            if (!file.good()) {
+                file.close();
+                std::filesystem::remove(temp_file_name);
+                std::cout << "Texture cache: write failed for " << cache_file_name << std::endl;
+                return false;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temp_file_name, cache_file_name, ec);
+        if (ec) {
+            std::filesystem::remove(temp_file_name, ec);
+            return false;
+        }
+        return true;
+    }
+
+    GLuint Upload(const Image& image) {
+        if (image.levels.empty() || !image.data) {
+            return 0;
+        }
+
+        const GLenum format = InternalFormat(image.usage);
+        GLuint texture = 0;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, GLsizei(image.levels.size()), format, GLsizei(image.width), GLsizei(image.height));
+        for (size_t l = 0; l < image.levels.size(); ++l) {
+            const Level& level = image.levels[l];
+            glCompressedTextureSubImage2D(texture, GLint(l), 0, 0, GLsizei(level.width), GLsizei(level.height), format,
+                GLsizei(level.size), image.data + level.offset);
+        }
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+
+    size_t CompressedSize(const Image& image) {
+        size_t size = 0;
+        for (const Level& level : image.levels) {
+            size += level.size;
+        }
+        return size;
+    }
+
+    size_t UncompressedSize(const Image& image) {
+        size_t size = 0;
+        for (const Level& level : image.levels) {
+            size += size_t(level.width) * level.height * 4;
+        }
+        return size;
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "glutils.h"
+#include "binarymesh.h"
+#include <cstdint>
+
+class ThreadPool;
+
+// Block compressed textures with the whole mip chain built at load time (<image>.ktx2 next to the source image)
+//   BC1 - colour (sRGB) and RMA maps, 8 bytes per 4x4 block
+//   BC5 - tangent space normal maps, x and y in two BC4 channels, z is rebuilt in the shader
+// Against the RGBA8 the driver keeps RGB8 images in, that is 8x and 4x less memory.
+// The cache file follows the KTX2 layout - identifier, header, level index, key/value data, levels smallest first -
+// with the source image's time stamp and size under the key "ZPGsource", but it carries no data format descriptor.
+namespace texturecompress {
+
+    enum class Usage {
+        COLOR,   // BC1 sRGB
+        DATA,    // BC1 linear
+        NORMAL   // BC5, RGB8 source with x and y in red and green
+    };
+
+    struct Level {
+        uint32_t width{ 0 };
+        uint32_t height{ 0 };
+        size_t offset{ 0 };  // Bytes from Image::data
+        size_t size{ 0 };
+    };
+
+    // Encoded texture, level 0 first
+    struct Image {
+        Usage usage{ Usage::COLOR };
+        uint32_t width{ 0 };
+        uint32_t height{ 0 };
+        std::vector<Level> levels;
+        const uint8_t* data{ nullptr };
+    };
+
+    GLenum InternalFormat(const Usage usage);
+
+    // Filters the mip chain of a tightly packed RGB8 image and encodes every level, blocks are split across pool
+    // (may be null). image points into storage.
+    bool Compress(const uint8_t* rgb, const int width, const int height, const Usage usage, ThreadPool* pool,
+        std::vector<uint8_t>& storage, Image& image);
+
+    // Validated view of a cache file
+    class TextureFile {
+    public:
+        // Fails if the file is missing, malformed, encoded for another usage or the source image changed since
+        bool Open(const std::string& cache_file_name, const std::string& source_file_name, const Usage usage);
+
+        const Image& image() const { return image_; }
+
+    private:
+        binarymesh::MappedFile file_;
+        Image image_;
+    };
+
+    std::string CachePath(const std::string& image_file_name);
+
+    // Writes the cache, returns false (and leaves no partial file) on IO error
+    bool Write(const std::string& cache_file_name, const std::string& source_file_name, const Image& image);
+
+    // Immutable texture with every level of image, repeat wrapping and trilinear filtering, 0 on failure
+    GLuint Upload(const Image& image);
+
+    // Bytes of all levels, and the same chain as RGBA8
+    size_t CompressedSize(const Image& image);
+    size_t UncompressedSize(const Image& image);
+}
@@ -0,0 +1,93 @@
+#include "threadpool.h"
+#include <atomic>
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned worker_count) {
+    workers_.reserve(worker_count);
+    for (unsigned i = 0; i < worker_count; ++i) {
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    condition_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+unsigned ThreadPool::DefaultWorkerCount() {
+    const unsigned hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::WorkerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t min_chunk, const std::function<void(size_t, size_t, size_t)>& job) {
+    if (count == 0) {
+        return;
+    }
+    const size_t chunk_count = std::min(max_chunks(), (count + min_chunk - 1) / std::max<size_t>(min_chunk, 1));
+    if (chunk_count <= 1) {
+        job(0, count, 0);
+        return;
+    }
+
+    // Shared state outlives this call, a helper that starts late finds no chunk left and exits
+    struct State {
+        std::atomic<size_t> next_chunk{ 0 };
+        std::atomic<size_t> done_chunks{ 0 };
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+    auto state = std::make_shared<State>();
+    const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+    const auto* job_ptr = &job;
+
+    // Helpers and the caller pull chunks until none are left
+    auto run = [state, job_ptr, chunk_count, chunk_size, count]() {
+        for (size_t chunk = state->next_chunk++; chunk < chunk_count; chunk = state->next_chunk++) {
+            const size_t begin = chunk * chunk_size;
+            (*job_ptr)(begin, std::min(begin + chunk_size, count), chunk);
+            if (++state->done_chunks == chunk_count) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->condition.notify_one();
+            }
+        }
+    };
+
+    for (size_t i = 1; i < chunk_count; ++i) {
+        Submit(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->condition.wait(lock, [&] { return state->done_chunks == chunk_count; });
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+// Fixed set of worker threads fed from a task queue
+class ThreadPool {
+public:
+    // Default leaves one hardware thread for the render thread
+    explicit ThreadPool(unsigned worker_count = DefaultWorkerCount());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static unsigned DefaultWorkerCount();
+
+    void Submit(std::function<void()> task);
+
+    // Splits [0, count) into at most worker_count() + 1 chunks of at least min_chunk items and calls
+    // job(begin, end, chunk) for each. The calling thread works too and returns when all chunks are done.
+    // chunk is unique per call and < max_chunks(), e.g. to pick per-chunk scratch state.
+    void ParallelFor(size_t count, size_t min_chunk, const std::function<void(size_t, size_t, size_t)>& job);
+
+    unsigned worker_count() const { return unsigned(workers_.size()); }
+    size_t max_chunks() const { return workers_.size() + 1; }
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_{ false };
+};
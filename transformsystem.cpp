@@ -0,0 +1,137 @@
+#include "transformsystem.h"
+#if defined(_M_X64) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define TRANSFORM_SSE
+#endif
+
+// out = a * b, column by column as linear combinations of a's columns
+static void MultiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef TRANSFORM_SSE
+    const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+    const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+    const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+    const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+    for (int column = 0; column < 4; ++column) {
+        const __m128 result = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[column][0])), _mm_mul_ps(a1, _mm_set1_ps(b[column][1]))),
+            _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[column][2])), _mm_mul_ps(a3, _mm_set1_ps(b[column][3]))));
+        _mm_storeu_ps(&out[column][0], result);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+// translate * eulerAngleZYX * scale written out, instead of three 4x4 products
+static glm::mat4 ComposeLocal(const glm::vec3& t, const glm::vec3& r, const glm::vec3& s) {
+    const glm::mat3 R = glm::mat3(glm::eulerAngleZYX(r.z, r.y, r.x));
+    glm::mat4 M(1.0f);
+    M[0] = glm::vec4(R[0] * s.x, 0.0f);
+    M[1] = glm::vec4(R[1] * s.y, 0.0f);
+    M[2] = glm::vec4(R[2] * s.z, 0.0f);
+    M[3] = glm::vec4(t, 1.0f);
+    return M;
+}
+
+// Inverse transpose of the upper 3x3 - its columns are cross products of M's columns over the determinant
+static glm::mat3 NormalMatrix(const glm::mat4& M) {
+    const glm::vec3 c0(M[0]), c1(M[1]), c2(M[2]);
+    const glm::vec3 r0 = glm::cross(c1, c2);
+    const glm::vec3 r1 = glm::cross(c2, c0);
+    const glm::vec3 r2 = glm::cross(c0, c1);
+    const float determinant = glm::dot(c0, r0);
+    const float inv_determinant = determinant != 0.0f ? 1.0f / determinant : 0.0f;
+    return glm::mat3(r0 * inv_determinant, r1 * inv_determinant, r2 * inv_determinant);
+}
+
+TransformSystem::TransformSystem(entt::registry& registry) : registry_(registry) {
+    registry_.on_construct<component::Transform>().connect<&TransformSystem::OnHierarchyChanged>(*this);
+    registry_.on_destroy<component::Transform>().connect<&TransformSystem::OnHierarchyChanged>(*this);
+    registry_.on_construct<component::Children>().connect<&TransformSystem::OnHierarchyChanged>(*this);
+    registry_.on_destroy<component::Children>().connect<&TransformSystem::OnHierarchyChanged>(*this);
+}
+
+TransformSystem::~TransformSystem() {
+    registry_.on_construct<component::Transform>().disconnect(this);
+    registry_.on_destroy<component::Transform>().disconnect(this);
+    registry_.on_construct<component::Children>().disconnect(this);
+    registry_.on_destroy<component::Children>().disconnect(this);
+}
+
+void TransformSystem::OnHierarchyChanged(entt::registry& registry, entt::entity entity) {
+    order_dirty_ = true;
+}
+
+void TransformSystem::RebuildOrder() {
+    order_.clear();
+
+    // Roots first, then breadth first through Parent::children
+    auto view = registry_.view<component::Transform>();
+    for (auto entity : view) {
+        const auto* children = registry_.try_get<component::Children>(entity);
+        if (!children || !children->has_parent() || !registry_.valid(children->parent)) {
+            order_.push_back({ entity, -1 });
+        }
+    }
+    for (size_t i = 0; i < order_.size(); ++i) {
+        const auto* parent = registry_.try_get<component::Parent>(order_[i].entity);
+        if (!parent) {
+            continue;
+        }
+        for (auto child : parent->children) {
+            if (registry_.valid(child) && registry_.all_of<component::Transform>(child)) {
+                order_.push_back({ child, int(i) });
+            }
+        }
+    }
+
+    // Everything has to be recomputed relative to the new parents
+    for (auto entity : view) {
+        view.get<component::Transform>(entity).local_valid = false;
+    }
+    changed_.assign(order_.size(), 0);
+    order_dirty_ = false;
+}
+
+size_t TransformSystem::Update() {
+    if (order_dirty_) {
+        RebuildOrder();
+    }
+
+    size_t changed_count = 0;
+    for (size_t i = 0; i < order_.size(); ++i) {
+        const Node& node = order_[i];
+        auto& transform = registry_.get<component::Transform>(node.entity);
+
+        const bool local_changed = !transform.local_valid
+            || transform.translation != transform.cached_translation
+            || transform.rotation != transform.cached_rotation
+            || transform.scale != transform.cached_scale;
+        const bool parent_changed = node.parent >= 0 && changed_[node.parent];
+
+        changed_[i] = local_changed || parent_changed;
+        transform.world_changed = changed_[i];
+        if (!changed_[i]) {
+            continue;
+        }
+
+        if (local_changed) {
+            transform.local_model_matrix = ComposeLocal(transform.translation, transform.rotation, transform.scale);
+            transform.cached_translation = transform.translation;
+            transform.cached_rotation = transform.rotation;
+            transform.cached_scale = transform.scale;
+            transform.local_valid = true;
+        }
+
+        if (node.parent >= 0) {
+            const auto& parent = registry_.get<component::Transform>(order_[node.parent].entity);
+            MultiplyMatrix(parent.world_model_matrix, transform.local_model_matrix, transform.world_model_matrix);
+        }
+        else {
+            transform.world_model_matrix = transform.local_model_matrix;
+        }
+        transform.normal_matrix = NormalMatrix(transform.world_model_matrix);
+        ++changed_count;
+    }
+    return changed_count;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "component.h"
+
+// Propagates Transform components down the entity hierarchy once per frame
+// Entities are kept in topological order (parents before children), so a single
+// forward pass computes every world matrix. A Transform is only recomputed when its
+// translation/rotation/scale differ from the values its local matrix was built from,
+// or when its parent's world matrix changed - static scenes cost one compare per entity.
+class TransformSystem {
+public:
+    explicit TransformSystem(entt::registry& registry);
+    ~TransformSystem();
+    TransformSystem(const TransformSystem&) = delete;
+    TransformSystem& operator=(const TransformSystem&) = delete;
+
+    // Refreshes local, world and normal matrices and Transform::world_changed
+    // Returns the number of entities whose world matrix changed
+    size_t Update();
+
+    // Call after re-parenting an existing entity (Children::parent changed)
+    void MarkHierarchyDirty() { order_dirty_ = true; }
+
+private:
+    struct Node {
+        entt::entity entity;
+        int parent;  // Index into order_, -1 for roots
+    };
+
+    void OnHierarchyChanged(entt::registry& registry, entt::entity entity);
+    void RebuildOrder();
+
+    entt::registry& registry_;
+    std::vector<Node> order_;
+    std::vector<uint8_t> changed_;  // Per node of order_, world matrix changed this update
+    bool order_dirty_{ true };
+};
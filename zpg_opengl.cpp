@@ -9,13 +9,21 @@
 #include <stdio.h>
 #include <cstdlib>
 #include <ctime>
+#include <cstring>
+#include <cctype>
 
 #include "tutorials.h"
 #include "Rasteriser.h"
 #include "Collider.h"
 
-int main()
+int main(int argc, char** argv)
 {
+    // --test-gpu-particles [count] checks the compute particle passes, also on Mesa llvmpipe (LIBGL_ALWAYS_SOFTWARE=1)
+    if (argc > 1 && strcmp(argv[1], "--test-gpu-particles") == 0) {
+        const size_t count = argc > 2 ? size_t(strtoull(argv[2], nullptr, 10)) : 100000;
+        return GPUParticleSystem::RunSelfTest(count, 120);
+    }
+
     // Seed random number generator for grass variation
     srand(static_cast<unsigned>(time(nullptr)));
 
@@ -28,15 +36,72 @@ int main()
         rasteriser.LoadGrassProgram("grass.vert", "grass.frag");
         rasteriser.LoadSkyboxProgram("skybox.vert", "skybox.frag");
         rasteriser.LoadShadowProgram("shadow.vert", "shadow.frag");
-        rasteriser.LoadRainProgram("rain.vert", "rain.frag");
+        rasteriser.LoadParticleProgram("particle.vert", "particle.frag");
+        rasteriser.LoadDepthPrepassProgram("depth_prepass.vert", "depth_prepass.frag");
+        // --depth-prepass starts with the depth pre-pass on (P toggles it at runtime)
+        // --shadow-quality low|medium|high [taps] and --shadow-resolution size pick the shadow tier (1/2/3 and 9/0 at runtime)
+        // --shadow-cascades count (1 to 4) splits the shadow distance between that many maps
+        // --no-lod draws every mesh at full detail (L toggles it), --lod-error pixels sets the allowed simplification error
+        // --compact-vertices stores meshes quantised with 16-bit indices where they fit
+        // --no-texture-compression uploads material maps as RGB8 with runtime mipmaps instead of cached BC1/BC5
+        // --sync-loading loads every mesh and texture before the first frame instead of streaming them in
+        int shadow_resolution = 1024;
+        int shadow_cascades = 3;
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--depth-prepass") == 0) {
+                rasteriser.SetDepthPrepass(true);
+            }
+            else if (strcmp(argv[i], "--shadow-quality") == 0 && i + 1 < argc) {
+                const char* tier = argv[++i];
+                const int taps = i + 1 < argc && isdigit(argv[i + 1][0]) ? atoi(argv[++i]) : 16;
+                if (strcmp(tier, "low") == 0) {
+                    rasteriser.SetShadowQuality(Rasteriser::ShadowQuality::LOW, taps);
+                }
+                else if (strcmp(tier, "high") == 0) {
+                    rasteriser.SetShadowQuality(Rasteriser::ShadowQuality::HIGH, taps);
+                }
+                else {
+                    rasteriser.SetShadowQuality(Rasteriser::ShadowQuality::MEDIUM, taps);
+                }
+            }
+            else if (strcmp(argv[i], "--shadow-resolution") == 0 && i + 1 < argc) {
+                shadow_resolution = atoi(argv[++i]);
+            }
+            else if (strcmp(argv[i], "--shadow-cascades") == 0 && i + 1 < argc) {
+                shadow_cascades = atoi(argv[++i]);
+            }
+            else if (strcmp(argv[i], "--no-lod") == 0) {
+                rasteriser.SetLevelOfDetail(false);
+            }
+            else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+                rasteriser.SetLevelOfDetail(true, float(atof(argv[++i])));
+            }
+            else if (strcmp(argv[i], "--compact-vertices") == 0) {
+                rasteriser.SetCompactVertices(true);
+            }
+            else if (strcmp(argv[i], "--no-texture-compression") == 0) {
+                rasteriser.SetTextureCompression(false);
+            }
+            else if (strcmp(argv[i], "--sync-loading") == 0) {
+                rasteriser.SetStreaming(false);
+            }
+        }
 
         // Initialize shadow mapping
-        rasteriser.InitShadowDepthbuffer();
+        rasteriser.InitShadowDepthbuffer(shadow_resolution, shadow_cascades);
 
-        // Initialize rain particle system
-        rasteriser.InitRainParticles();
+        // Initialize the particle pool shared by all emitters
+        rasteriser.InitParticles();
 
-        // Load skybox/environment texture
+        // Hierarchical-Z occlusion culling, --no-occlusion starts with it off (O toggles it at runtime)
+        rasteriser.InitOcclusionCulling();
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--no-occlusion") == 0) {
+                rasteriser.SetOcclusionCulling(false);
+            }
+        }
+
+        // Load skybox/environment texture, decoded in the background like the meshes below
         rasteriser.LoadSkyboxTexture("../../data/skybox/background.jpg");
 
         // Load collision meshes using PhysicsManager (relative paths)
@@ -76,10 +141,11 @@ int main()
             }
         }
 
+        // Build per-tuft transforms, the whole field is drawn with one instanced call per sub-mesh
+        std::vector<glm::mat4> grass_transforms;
+        grass_transforms.reserve(grass_positions.size());
         for (size_t i = 0; i < grass_positions.size(); i++) {
-            auto grass = rasteriser.CreateEntity("../../data/grass/grass.obj", "Grass" + std::to_string(i));
-            rasteriser.GetRegistry().emplace<component::Grass>(grass);
-            auto& grass_transform = rasteriser.GetRegistry().get<component::Transform>(grass);
+            component::Transform grass_transform;
             grass_transform.translation = grass_positions[i];
             // Vary scale for natural look (grass mesh is ~0.4 units)
             float scale_var = 2.5f + (rand() % 100) / 100.0f * 1.5f;
@@ -87,8 +153,29 @@ int main()
             // Random rotation around Z axis for variety
             grass_transform.rotation = glm::vec3(0, 0, (rand() % 360) * 3.14159f / 180.0f);
             grass_transform.update_model_matrix();
+            grass_transforms.push_back(grass_transform.local_model_matrix);
         }
 
+        auto grass = rasteriser.CreateInstancedEntity("../../data/grass/grass.obj", "Grass", grass_transforms);
+        rasteriser.GetRegistry().emplace<component::Grass>(grass);
+
+        // Rain - falls in a box around the camera wherever it goes, about 15k drops alive at a time
+        auto& registry = rasteriser.GetRegistry();
+        auto rain = registry.create();
+        registry.emplace<component::Name>(rain, "Rain");
+        auto& rain_emitter = registry.emplace<component::ParticleEmitter>(rain);
+        rain_emitter.spawn_min = glm::vec3(-30.0f, -30.0f, 20.0f);  // 20 to 50 above the camera
+        rain_emitter.spawn_max = glm::vec3(30.0f, 30.0f, 50.0f);
+        rain_emitter.velocity_min = glm::vec3(-0.1f, -0.1f, -22.0f);  // Slight drift, fall speed -14 to -22
+        rain_emitter.velocity_max = glm::vec3(0.1f, 0.1f, -14.0f);
+        rain_emitter.color = glm::vec4(1.0f, 1.0f, 1.0f, 0.9f);
+        rain_emitter.sprite_falloff = glm::vec2(3.0f, 0.3f);  // Narrow vertical streak
+        rain_emitter.point_size = 120.0f;
+        rain_emitter.life_decay = 0.5f;
+        rain_emitter.emit_rate = 15000.0f * rain_emitter.life_decay;
+        rain_emitter.kill_z = -2.0f;
+        rain_emitter.follow_camera = true;
+
         // Start the main loop
         return rasteriser.Show();
     }